@@ -25,14 +25,50 @@
  * SD16 definitions and header
  ******************************************************************************/
 #include "sd16_header.h"
+#include "sd16_frame.h"
 #define 		SLV_Addr		0x0B			// Address is 0x0B<<1 for R/W
 
 /* Select operation mode - uncomment desired mode - comment all others */
 
-//#define			I2C_ADC_START_CONVERSION		// start with current configuration
-//#define			I2C_ADC_STOP_CONVERSION
+//#define			I2C_ADC_START_CONVERSION		// start with current configuration - legacy command (ENABLE_LEGACY_COMMANDS on MSP430)
+//#define			I2C_ADC_STOP_CONVERSION			// legacy command (ENABLE_LEGACY_COMMANDS on MSP430)
 #define			I2C_ADC_START_SING_CONVERSION_CH1_GAIN1x_BIPOLAR_1024_2S
 //#define			I2C_ADC_START_CONT_CONVERSION_CH1_GAIN1x_BIPOLAR_1024_2S
+//#define			I2C_ADC_SCAN_SEQUENCER			// CH0, CH1, CH2, temperature, VCC (ENABLE_SCAN_SEQUENCER on MSP430)
+
+/* Start all MSP430s at once with a general call (single conversion mode, ENABLE_GENERAL_CALL on MSP430) */
+//#define			I2C_ADC_GENERAL_CALL
+
+/* Read queued samples from the FIFO instead of the last result (continuous mode) */
+//#define			I2C_ADC_READ_FIFO
+
+/* Read the FIFO delta coded - about 1 byte per sample on slow signals (continuous mode, ENABLE_FIFO_DELTA on MSP430) */
+//#define			I2C_ADC_READ_FIFO_DELTA
+
+/* One conversion every n VLO ticks (about 12 kHz), LPM3 and reference off between samples - use with I2C_ADC_READ_FIFO (ENABLE_PACED_SAMPLING on MSP430) */
+//#define			I2C_ADC_PACED			(1200)			// about 10 samples/s
+
+/* Average 2^n conversions on the MSP430 (continuous mode, ENABLE_SD16_FILTER on MSP430) - n = 1..8 */
+//#define			I2C_ADC_FILTER_AVG		(4)
+
+/* Read min/max/mean/rms of each window of n results (continuous mode, ENABLE_STATISTICS on MSP430) */
+//#define			I2C_ADC_STATISTICS		(1000)
+
+/* Read only when ALERT (MSP430 P2.7) goes low (continuous mode, ENABLE_COMPARATOR on MSP430) */
+//#define			I2C_ADC_COMPARATOR
+#define			ALERT_INPUT				2				// Arduino pin connected to ALERT
+#define			COMP_LOW_THRESHOLD		(-1000)
+#define			COMP_HIGH_THRESHOLD		(10000)
+
+/* Measure offsets, store gain coefficient (Q15) in MSP430 flash and enable correction (continuous mode, ENABLE_CALIBRATION on MSP430) */
+//#define			I2C_ADC_CALIBRATION		(0x8000)		// 0x8000 = gain 1.0
+
+/* Send samples as binary frames (sd16_frame.h) at 1 Mbaud instead of text - record with Host/capture/sd16_capture */
+//#define			I2C_ADC_BINARY_STREAM
+
+#if defined	(I2C_ADC_BINARY_STREAM) && (defined (I2C_ADC_STATISTICS) || defined (I2C_ADC_SCAN_SEQUENCER))
+#error Statistics and sequencer results are text only
+#endif
 
 
 /******************************************************************************
@@ -48,15 +84,255 @@ Adafruit_ADS1115 ads(0x48);
 
 
 
+/******************************************************************************
+ * decode FIFO_DELTA read - [count] [key L] [key H] [token] ...
+ * - returns number of samples, up to length - 2
+ * - an incomplete escaped sample at the end is sent again by the next read
+ ******************************************************************************/
+uint8_t SD16_DecodeDelta(const uint8_t *data, uint8_t length, int16_t *samples)
+{
+	uint8_t n = 0;
+	uint8_t i = 3;
+
+	if ( (length < 3) || !(data[0] & ~SD16_FIFO_OVERFLOW) )
+	{
+		return 0;										// FIFO was empty
+	}
+	samples[n++] = (int16_t)(data[1] | (data[2] << 8));	// key sample
+
+	while (i < length)
+	{
+		if (data[i] == SD16_DELTA_EMPTY)
+		{
+			break;
+		}
+		if (data[i] == SD16_DELTA_ESCAPE)				// full sample follows
+		{
+			if ( (i + 3) > length )
+			{
+				break;
+			}
+			samples[n] = (int16_t)(data[i + 1] | (data[i + 2] << 8));
+			i += 3;
+		}
+		else
+		{
+			samples[n] = (int16_t)((uint16_t)samples[n - 1] + (int8_t)data[i]);
+			i++;
+		}
+		n++;
+	}
+
+	return n;
+}
+
+
+/******************************************************************************
+ * configuration shadow - CHCTRL_L, CHCTRL_H, IN_CTRL last known on the MSP430
+ * - only registers that differ are written, [CONVERSION] [START] if none
+ * - invalid after a Nack or a MSP430 reset, or a write to PACE_CTRL,
+ *   SEQ_CTRL, CAL_CTRL or DRIFT_CTRL (they load their own SD16 settings) -
+ *   read back before the next write
+ ******************************************************************************/
+uint8_t sd16Shadow[3];
+bool sd16ShadowValid = false;
+
+bool SD16_ShadowSync()
+{
+	Wire.beginTransmission (SLV_Addr);
+	Wire.write(SD16_REG_CHCTRL_L);
+	if (Wire.endTransmission(false) != 0)				// repeated start - read follows
+	{
+		return false;
+	}
+	if (Wire.requestFrom(SLV_Addr, 3) != 3)
+	{
+		return false;
+	}
+	for (uint8_t i = 0; i < 3; i++)
+	{
+		sd16Shadow[i] = Wire.read();
+	}
+	sd16ShadowValid = true;
+	return true;
+}
+
+
+/*
+ * config: CHCTRL_L, CHCTRL_H, IN_CTRL - registers are consecutive, written
+ * from the first one that differs up to CONVERSION
+ */
+bool SD16_Configure(const uint8_t *config, uint8_t conversion)
+{
+	uint8_t first = 0;
+
+	if ( !sd16ShadowValid && !SD16_ShadowSync() )
+	{
+		return false;
+	}
+	while ( (first < 3) && (config[first] == sd16Shadow[first]) )
+	{
+		first++;
+	}
+
+	Wire.beginTransmission (SLV_Addr);
+	Wire.write(SD16_REG_CHCTRL_L + first);
+	for (uint8_t i = first; i < 3; i++)
+	{
+		Wire.write(config[i]);
+	}
+	Wire.write(conversion);
+	if (Wire.endTransmission() != 0)
+	{
+		sd16ShadowValid = false;
+		return false;
+	}
+
+	memcpy(sd16Shadow, config, 3);
+	return true;
+}
+
+
+/******************************************************************************
+ * sample output - text lines, or binary frames (sd16_frame.h)
+ * - SD16_FRAME_PAIRS: [ADS1115] [MSP430] per reading
+ * - a frame is sent when full, when configuration or flags change, or
+ *   FRAME_FLUSH_MS after its first sample
+ ******************************************************************************/
+#if defined	(I2C_ADC_BINARY_STREAM)
+#define			FRAME_FLUSH_MS			(100)
+
+uint8_t frame[SD16_FRAME_SIZE(SD16_FRAME_MAX_SAMPLES)];
+uint8_t frameCount = 0;
+uint16_t frameSequence = 0;
+uint8_t frameLost = 0;
+uint32_t frameStart = 0;
+
+void SD16_FrameFlush()
+{
+	uint16_t sum1 = 0;
+	uint16_t sum2 = 0;
+	uint8_t length = SD16_FRAME_HEADER + 2 * frameCount;
+
+	if (frameCount == 0)
+	{
+		return;
+	}
+	frame[7] = frameCount;
+	for (uint8_t i = 2; i < length; i++)				// Fletcher-16
+	{
+		sum1 = (sum1 + frame[i]) % 255;
+		sum2 = (sum2 + sum1) % 255;
+	}
+	frame[length] = sum1;
+	frame[length + 1] = sum2;
+
+	Serial.write(frame, length + SD16_FRAME_CHECK);
+	frameSequence++;
+	frameCount = 0;
+}
+
+void SD16_Output(const int16_t *samples, uint8_t n, uint8_t flags)
+{
+	uint8_t inCtrl = sd16Shadow[2];
+	uint8_t chctrlHigh = sd16Shadow[1];
+
+	if (sd16ShadowValid)
+	{
+		flags |= sd16Shadow[0] & SD16_FRAME_2S_COMP;
+	}
+	else
+	{
+		flags |= SD16_FRAME_CONFIG_UNKNOWN;
+	}
+	flags |= frameLost;
+
+	if ( frameCount && ((frame[4] != inCtrl) || (frame[5] != chctrlHigh) || (frame[6] != flags)
+						|| ((frameCount + n) > SD16_FRAME_MAX_SAMPLES)) )
+	{
+		SD16_FrameFlush();
+	}
+	if (frameCount == 0)
+	{
+		frame[0] = SD16_FRAME_SYNC_0;
+		frame[1] = SD16_FRAME_SYNC_1;
+		frame[2] = frameSequence & 0xFF;
+		frame[3] = frameSequence >> 8;
+		frame[4] = inCtrl;
+		frame[5] = chctrlHigh;
+		frame[6] = flags;
+		frameLost = 0;
+		frameStart = millis();
+	}
+
+	for (uint8_t i = 0; i < n; i++)
+	{
+		frame[SD16_FRAME_HEADER + 2 * frameCount] = samples[i] & 0xFF;
+		frame[SD16_FRAME_HEADER + 2 * frameCount + 1] = (samples[i] >> 8) & 0xFF;
+		frameCount++;
+	}
+	if (frameCount == SD16_FRAME_MAX_SAMPLES)
+	{
+		SD16_FrameFlush();
+	}
+}
+
+void SD16_OutputIdle()
+{
+	if ( frameCount && ((millis() - frameStart) >= FRAME_FLUSH_MS) )
+	{
+		SD16_FrameFlush();
+	}
+}
+
+void SD16_Lost(const char *text)
+{
+	frameLost = SD16_FRAME_LOST;
+}
+#else
+void SD16_Output(const int16_t *samples, uint8_t n, uint8_t flags)
+{
+	for (uint8_t i = 0; i < n; i++)
+	{
+		if ( (flags & SD16_FRAME_PAIRS) && !(i & 0x01) )
+		{
+			Serial.print(samples[i]); Serial.print(' ');
+		}
+		else
+		{
+			Serial.println(samples[i]);
+		}
+	}
+}
+
+void SD16_OutputIdle()
+{
+}
+
+void SD16_Lost(const char *text)
+{
+	Serial.println(text);
+}
+#endif
+
+
 /******************************************************************************
  * setup
  ******************************************************************************/
 void setup()
 {
+#if defined	(I2C_ADC_BINARY_STREAM)
+	Serial.begin (SD16_FRAME_BAUD);
+#else
 	Serial.begin (9600);
+#endif
 
 	while (!Serial);
 
+#if		defined (I2C_ADC_COMPARATOR)
+	pinMode(ALERT_INPUT, INPUT_PULLUP);		// open-drain output on MSP430
+#endif
+
 #if		defined (ENABLE_ADS1115)
 	ads.setGain(GAIN_FOUR);  // 4x gain   +/- 1.024V  1 bit = 0.03125mV
 	ads.begin();
@@ -96,57 +372,357 @@ void loop()
 #endif
 #if defined	(I2C_ADC_START_SING_CONVERSION_CH1_GAIN1x_BIPOLAR_1024_2S)
 		/*
-		 * set slave address - configuration register - register value - end transmission
+		 * configure and start in one transaction - registers auto-increment
+		 * - SD16CCTL0 low - SD16CCTL0 high - SD16INCTL0 - start
+		 * - unchanged registers skipped: only [CONVERSION] [START] per sample
 		 */
-		Wire.beginTransmission (SLV_Addr);
-		var = Wire.write(SD16_CHCTRL_LOW);
-		var = Wire.write(SD16_DF_2S_COMP);
-		var = Wire.endTransmission();
-
-		Wire.beginTransmission (SLV_Addr);
-		var = Wire.write(SD16_CHCTRL_HIGH);
-		var = Wire.write(SD16_OSR_1024x|SD16_SNG_CONV|SD16_BIPOLAR);
-		var = Wire.endTransmission();
+		const uint8_t config[3] = { SD16_DF_2S_COMP, SD16_OSR_1024x|SD16_SNG_CONV|SD16_BIPOLAR, SD16_CH1|SD16_GAIN1x };
+		SD16_Configure(config, SD16_START_CONVERSION);
 
+#if defined	(I2C_ADC_GENERAL_CALL)
+		/*
+		 * answer general call - then restart the conversion of every node
+		 * answering it on the same SCL edge
+		 */
 		Wire.beginTransmission (SLV_Addr);
-		var = Wire.write(SD16_IN_CTRL);
-		var = Wire.write(SD16_CH1|SD16_GAIN1x);
+		var = Wire.write(SD16_REG_I2C_CTRL);
+		var = Wire.write(SD16_I2C_GCALL);
 		var = Wire.endTransmission();
 
-		Wire.beginTransmission (SLV_Addr);
-		var = Wire.write(SD16_CONVERSION);
-		var = Wire.write(SD16_START_CONVERSION);
+		Wire.beginTransmission (0x00);
+		var = Wire.write(SD16_GCALL_START);
 		var = Wire.endTransmission();
 #endif
+#endif
 #if defined	(I2C_ADC_START_CONT_CONVERSION_CH1_GAIN1x_BIPOLAR_1024_2S)
 		if ( counter == 0 )
 		{
+#if defined	(I2C_ADC_CALIBRATION)
 			/*
-			 * set slave address - configuration register - register value - end transmission
+			 * gain coefficient - measure offsets and store - wait until done
+			 * - offsets measured with data format and OSR of current configuration
 			 */
 			Wire.beginTransmission (SLV_Addr);
-			var = Wire.write(SD16_CHCTRL_LOW);
-			var = Wire.write(SD16_DF_2S_COMP);
+			var = Wire.write(SD16_REG_CAL + SD16_CAL_GAIN);
+			var = Wire.write(I2C_ADC_CALIBRATION & 0xFF);
+			var = Wire.write((I2C_ADC_CALIBRATION >> 8) & 0xFF);
 			var = Wire.endTransmission();
 
 			Wire.beginTransmission (SLV_Addr);
-			var = Wire.write(SD16_CHCTRL_HIGH);
-			var = Wire.write(SD16_OSR_1024x|SD16_CONT_CONV|SD16_BIPOLAR);
+			var = Wire.write(SD16_REG_CAL_CTRL);
+			var = Wire.write(SD16_CAL_MEASURE|SD16_CAL_SAVE);
 			var = Wire.endTransmission();
+			sd16ShadowValid = false;					// CH7 while measuring
 
 			Wire.beginTransmission (SLV_Addr);
-			var = Wire.write(SD16_IN_CTRL);
-			var = Wire.write(SD16_CH1|SD16_GAIN1x);
+			var = Wire.write(SD16_REG_STATUS);
 			var = Wire.endTransmission();
+			do
+			{
+				delay(10);
+				Wire.requestFrom(SLV_Addr, 1);
+			} while (Wire.read() & SD16_STATUS_CAL);	// writes are Nacked until done
 
 			Wire.beginTransmission (SLV_Addr);
-			var = Wire.write(SD16_CONVERSION);
-			var = Wire.write(SD16_START_CONVERSION);
+			var = Wire.write(SD16_REG_CAL_CTRL);
+			var = Wire.write(SD16_CAL_ENABLE);
+			var = Wire.endTransmission();
+#endif
+#if defined	(I2C_ADC_FILTER_AVG)
+			Wire.beginTransmission (SLV_Addr);
+			var = Wire.write(SD16_REG_FILTER_CTRL);
+			var = Wire.write(SD16_FILTER_AVG(I2C_ADC_FILTER_AVG));
+			var = Wire.endTransmission();
+#endif
+#if defined	(I2C_ADC_COMPARATOR)
+			/*
+			 * thresholds + control - alert after 2 results above high threshold, latched
+			 */
+			Wire.beginTransmission (SLV_Addr);
+			var = Wire.write(SD16_REG_COMP_LOW);
+			var = Wire.write(COMP_LOW_THRESHOLD & 0xFF);
+			var = Wire.write((COMP_LOW_THRESHOLD >> 8) & 0xFF);
+			var = Wire.write(COMP_HIGH_THRESHOLD & 0xFF);
+			var = Wire.write((COMP_HIGH_THRESHOLD >> 8) & 0xFF);
+			var = Wire.write(SD16_COMP_ENABLE|SD16_COMP_TRADITIONAL|SD16_COMP_LATCH|SD16_COMP_QUEUE_2);
+			var = Wire.endTransmission();
+
+			Wire.beginTransmission (SLV_Addr);
+			var = Wire.write(SD16_REG_STATUS);
+			var = Wire.endTransmission();
+#endif
+#if defined	(I2C_ADC_STATISTICS)
+			/*
+			 * window size + control - restarted after each block read
+			 */
+			Wire.beginTransmission (SLV_Addr);
+			var = Wire.write(SD16_REG_STATS_WINDOW);
+			var = Wire.write(I2C_ADC_STATISTICS & 0xFF);
+			var = Wire.write((I2C_ADC_STATISTICS >> 8) & 0xFF);
+			var = Wire.write(SD16_STATS_ENABLE|SD16_STATS_CLEAR_ON_READ);
+			var = Wire.endTransmission();
+#endif
+
+			/*
+			 * configure and start in one transaction - registers auto-increment
+			 * - shadow kept, used to tag the samples
+			 */
+			const uint8_t config[3] = { SD16_DF_2S_COMP, SD16_OSR_1024x|SD16_CONT_CONV|SD16_BIPOLAR, SD16_CH1|SD16_GAIN1x };
+			SD16_Configure(config, SD16_START_CONVERSION);
+
+#if defined	(I2C_ADC_PACED)
+			/*
+			 * period + control - single conversions from now on, paced by Timer_A
+			 */
+			Wire.beginTransmission (SLV_Addr);
+			var = Wire.write(SD16_REG_PACE_PERIOD);
+			var = Wire.write(I2C_ADC_PACED & 0xFF);
+			var = Wire.write((I2C_ADC_PACED >> 8) & 0xFF);
+			var = Wire.write(SD16_PACE_ENABLE|SD16_PACE_POWER_DOWN);
+			var = Wire.endTransmission();
+			sd16ShadowValid = false;					// SNGL forced - read back, samples tagged single
+			SD16_ShadowSync();
+#endif
+
+			/*
+			 * point to the register read below - kept until next pointer write
+			 */
+			Wire.beginTransmission (SLV_Addr);
+#if defined	(I2C_ADC_READ_FIFO_DELTA)
+			var = Wire.write(SD16_REG_FIFO_DELTA);
+#elif defined	(I2C_ADC_READ_FIFO)
+			var = Wire.write(SD16_REG_FIFO_COUNT);
+#else
+			var = Wire.write(SD16_REG_RESULT_L);
+#endif
+			var = Wire.endTransmission();
+		}
+		counter++;
+#endif
+
+#if defined	(I2C_ADC_SCAN_SEQUENCER)
+		if ( counter == 0 )
+		{
+			/*
+			 * slot table - [SD16INCTL0] [SD16CCTL0 high] per slot
+			 */
+			Wire.beginTransmission (SLV_Addr);
+			var = Wire.write(SD16_REG_SEQ_CONFIG);
+			var = Wire.write(SD16_CH0|SD16_GAIN1x);				var = Wire.write(SD16_OSR_256x|SD16_BIPOLAR);
+			var = Wire.write(SD16_CH1|SD16_GAIN1x);				var = Wire.write(SD16_OSR_256x|SD16_BIPOLAR);
+			var = Wire.write(SD16_CH2|SD16_GAIN1x);				var = Wire.write(SD16_OSR_256x|SD16_BIPOLAR);
+			var = Wire.write(SD16_CH6_Temperature|SD16_GAIN1x);	var = Wire.write(SD16_OSR_1024x|SD16_BIPOLAR);
+			var = Wire.write(SD16_CH5_VCC_VSS|SD16_GAIN1x);		var = Wire.write(SD16_OSR_1024x|SD16_BIPOLAR);
+			var = Wire.endTransmission();
+
+			Wire.beginTransmission (SLV_Addr);
+			var = Wire.write(SD16_REG_SEQ_CTRL);
+			var = Wire.write(SD16_SEQ_ENABLE|SD16_SEQ_LOOP|SD16_SEQ_LENGTH(SD16_SEQ_SLOTS));
+			var = Wire.endTransmission();
+			sd16ShadowValid = false;					// slot settings loaded
+
+			Wire.beginTransmission (SLV_Addr);
+			var = Wire.write(SD16_REG_SEQ_RESULT);
 			var = Wire.endTransmission();
 		}
 		counter++;
 #endif
 
+#if defined	(I2C_ADC_READ_FIFO_DELTA)
+		/*
+		 * count + whole FIFO if all steps fit in a delta - samples that do not
+		 * fit in this read stay queued, unused bytes are SD16_DELTA_EMPTY
+		 */
+		uint8_t stream[SD16_FIFO_DEPTH + 2];
+		int16_t samples[SD16_FIFO_DEPTH];
+		uint8_t length = 0;
+
+		Wire.requestFrom(SLV_Addr, SD16_FIFO_DEPTH + 2);
+		while (Wire.available() && (length < sizeof(stream)))
+		{
+			stream[length++] = Wire.read();
+		}
+		if (stream[0] & SD16_FIFO_OVERFLOW)
+		{
+			SD16_Lost("FIFO overflow");
+		}
+
+		uint8_t decoded = SD16_DecodeDelta(stream, length, samples);
+		SD16_Output(samples, decoded, 0);
+#elif defined	(I2C_ADC_READ_FIFO)
+		/*
+		 * read number of queued samples - then read count again and drain samples
+		 * - FIFO_DATA follows FIFO_COUNT and does not increment
+		 */
+		uint8_t queued = 0;
+		Wire.requestFrom(SLV_Addr, 1);
+		if (Wire.available())
+		{
+			queued = Wire.read() & ~SD16_FIFO_OVERFLOW;
+		}
+
+		if (queued)
+		{
+			Wire.requestFrom(SLV_Addr, 1 + 2 * queued);	// count + 2 bytes per sample, LSB first
+			if (Wire.read() & SD16_FIFO_OVERFLOW)
+			{
+				SD16_Lost("FIFO overflow");
+			}
+
+			while (Wire.available() >= 2)
+			{
+				int16_t sample = 0;
+				sample |= Wire.read() & 0xFF;
+				sample |= (Wire.read() & 0xFF) << 8;
+
+				SD16_Output(&sample, 1, 0);
+			}
+		}
+#elif defined	(I2C_ADC_COMPARATOR)
+		/*
+		 * no bus traffic until alert - status read clears the latched alert
+		 */
+		if (digitalRead(ALERT_INPUT) == LOW)
+		{
+			Wire.requestFrom(SLV_Addr, 3);				// status + result
+			uint8_t status = Wire.read();
+			int16_t received = Wire.read() & 0xFF;
+			received |= (Wire.read() & 0xFF) << 8;
+
+			if (status & SD16_STATUS_ALERT)
+			{
+#if defined	(I2C_ADC_BINARY_STREAM)
+				SD16_Output(&received, 1, 0);
+#else
+				Serial.print("alert ");
+				Serial.println(received);
+#endif
+			}
+		}
+#elif defined	(I2C_ADC_STATISTICS)
+		/*
+		 * wait window complete - then read statistics block
+		 */
+		uint8_t status = 0;
+
+		Wire.beginTransmission (SLV_Addr);
+		var = Wire.write(SD16_REG_STATUS);
+		var = Wire.endTransmission();
+		do
+		{
+			Wire.requestFrom(SLV_Addr, 1);
+			status = Wire.read();
+		} while ( !(status & SD16_STATUS_STATS) );
+
+		Wire.beginTransmission (SLV_Addr);
+		var = Wire.write(SD16_REG_STATS);
+		var = Wire.endTransmission();
+
+		uint8_t block[SD16_STATS_SIZE];
+		Wire.requestFrom(SLV_Addr, SD16_STATS_SIZE);
+		for (uint8_t i = 0; i < SD16_STATS_SIZE; i++)
+		{
+			block[i] = Wire.read();
+		}
+
+		int32_t sum = (int32_t)((uint32_t)block[SD16_STATS_SUM] | ((uint32_t)block[SD16_STATS_SUM + 1] << 8) |
+						((uint32_t)block[SD16_STATS_SUM + 2] << 16) | ((uint32_t)block[SD16_STATS_SUM + 3] << 24));
+		double sumSquares = 0;
+		for (int8_t i = 5; i >= 0; i--)
+		{
+			sumSquares = (sumSquares * 256.0) + block[SD16_STATS_SUM_SQUARES + i];
+		}
+		uint16_t count = block[SD16_STATS_COUNT] | (block[SD16_STATS_COUNT + 1] << 8);
+		int16_t min = block[SD16_STATS_MIN] | (block[SD16_STATS_MIN + 1] << 8);
+		int16_t max = block[SD16_STATS_MAX] | (block[SD16_STATS_MAX + 1] << 8);
+
+		if (count)
+		{
+			Serial.print(min); Serial.print(' ');
+			Serial.print(max); Serial.print(' ');
+			Serial.print((double)sum / count); Serial.print(' ');
+			Serial.println(sqrt(sumSquares / count));
+		}
+#elif defined	(I2C_ADC_SCAN_SEQUENCER)
+		/*
+		 * latest result of all slots in one read
+		 */
+		Wire.requestFrom(SLV_Addr, 2 * SD16_SEQ_SLOTS);
+		while (Wire.available() >= 2)
+		{
+			int16_t sample = 0;
+			sample |= Wire.read() & 0xFF;
+			sample |= (Wire.read() & 0xFF) << 8;
+
+			Serial.print(sample); Serial.print(' ');
+		}
+		Serial.println();
+#elif defined	(I2C_ADC_START_SING_CONVERSION_CH1_GAIN1x_BIPOLAR_1024_2S)
+		/*
+		 * conversion runs in background - point to status and read with a
+		 * repeated start, read again until data ready (pointer kept)
+		 */
+		static uint8_t lastCounter = 0;
+		uint8_t status = 0;
+		int16_t received = 0;
+		uint8_t sampleCounter = 0;
+
+		Wire.beginTransmission (SLV_Addr);
+		var = Wire.write(SD16_REG_STATUS);
+		var = Wire.endTransmission(false);
+		do
+		{
+			Wire.requestFrom(SLV_Addr, 4);				// status + result + sample counter
+			status = Wire.read();
+			received = Wire.read() & 0xFF;
+			received |= (Wire.read() & 0xFF) << 8;
+			sampleCounter = Wire.read();
+		} while ( !(status & SD16_STATUS_DRDY) );
+
+		/*
+		 * one result per start - any other counter means the MSP430 was reset
+		 */
+#if defined	(I2C_ADC_GENERAL_CALL)
+		lastCounter = 0;								// counter restarted by the general call
+#endif
+		if (sampleCounter != (uint8_t)(lastCounter + 1))
+		{
+			sd16ShadowValid = false;
+		}
+		lastCounter = sampleCounter;
+
+#if		defined (ENABLE_ADS1115)
+		int16_t pair[2];
+		pair[0] = ads.readADC_Differential_0_1();
+		pair[1] = received;
+
+		SD16_Output(pair, 2, SD16_FRAME_PAIRS);
+#else
+		SD16_Output(&received, 1, 0);
+#endif
+#elif defined	(I2C_ADC_START_CONT_CONVERSION_CH1_GAIN1x_BIPOLAR_1024_2S)
+		/*
+		 * result + sample counter from the same snapshot - skip repeated samples
+		 */
+		static uint8_t lastCounter = 0;
+
+		Wire.requestFrom(SLV_Addr, 3);
+		int16_t received = 0;
+		received |= Wire.read() & 0xFF;
+		received |= (Wire.read() & 0xFF) << 8;
+		uint8_t sampleCounter = Wire.read();
+
+		if (sampleCounter != lastCounter)
+		{
+			if ( (uint8_t)(sampleCounter - lastCounter) > 1 )
+			{
+				SD16_Lost("sample lost");
+			}
+			lastCounter = sampleCounter;
+
+			SD16_Output(&received, 1, 0);
+		}
+#else
 		volatile int c = 0;
 		int counter = 0;
 		int16_t bufferReceived[2] = {0};
@@ -169,12 +745,16 @@ void loop()
 
 
 #if		defined (ENABLE_ADS1115)
-		int16_t adc0 = 0;
-		adc0 = ads.readADC_Differential_0_1();
+		int16_t pair[2];
+		pair[0] = ads.readADC_Differential_0_1();
+		pair[1] = received;
 
-		Serial.print((int16_t)(adc0 & 0xFFFF)); Serial.print(' ');
+		SD16_Output(pair, 2, SD16_FRAME_PAIRS);
+#else
+		SD16_Output(&received, 1, 0);
+#endif
 #endif
-		Serial.println((int16_t)(received & 0xFFFF));
 
+		SD16_OutputIdle();								// send a partial frame after a while
 	}
 }
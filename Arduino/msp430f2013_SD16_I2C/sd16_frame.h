@@ -0,0 +1,44 @@
+/******************************************************************************
+ * sd16_frame.h - binary sample stream, Arduino serial port to host
+ * - used by the Arduino example (I2C_ADC_BINARY_STREAM) and by
+ *   Host/capture/sd16_capture
+ *
+ * Frame - multi-byte values LSB first
+ *   [0]      SD16_FRAME_SYNC_0
+ *   [1]      SD16_FRAME_SYNC_1
+ *   [2..3]   sequence number - +1 per frame, gaps are lost frames
+ *   [4]      IN_CTRL of the samples (channel, gain)
+ *   [5]      CHCTRL_H (OSR, single, unipolar)
+ *   [6]      flags
+ *   [7]      n - number of samples, 1 .. SD16_FRAME_MAX_SAMPLES
+ *   [8..]    n raw samples, 16 bits each
+ *   [8+2n]   Fletcher-16 of bytes 2 .. 7+2n - sum1, sum2
+ *
+ * All samples of a frame have the same configuration. The receiver looks
+ * for the sync bytes and checks the length and checksum, so it can start
+ * at any point of the stream.
+ *
+ * Haroldo Amaral
+ * https://github.com/agaelema/msp430f20x3_as_i2c_16bit_adc
+ ******************************************************************************/
+
+#ifndef SD16_FRAME_H_
+#define SD16_FRAME_H_
+
+#define     SD16_FRAME_SYNC_0           (0xA5)
+#define     SD16_FRAME_SYNC_1           (0x5A)
+#define     SD16_FRAME_HEADER           (8)             // bytes before the samples
+#define     SD16_FRAME_CHECK            (2)
+#define     SD16_FRAME_MAX_SAMPLES      (32)
+#define     SD16_FRAME_SIZE(n)          (SD16_FRAME_HEADER + 2 * (n) + SD16_FRAME_CHECK)
+
+/* flags */
+#define     SD16_FRAME_PAIRS            (0x01)          // [ADS1115] [MSP430] per reading
+#define     SD16_FRAME_LOST             (0x02)          // samples lost before this frame (counter gap, FIFO overflow)
+#define     SD16_FRAME_CONFIG_UNKNOWN   (0x04)          // IN_CTRL / CHCTRL_H not known to the master
+#define     SD16_FRAME_2S_COMP          (0x10)          // 2's complement - as SD16_DF_2S_COMP in CHCTRL_L
+
+#define     SD16_FRAME_BAUD             (1000000UL)     // exact with a 16 MHz AVR (U2X)
+
+
+#endif /* SD16_FRAME_H_ */
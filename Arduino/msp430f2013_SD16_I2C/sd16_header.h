@@ -18,8 +18,61 @@
 #define     ADC_VBIT            (float)(VFSR/ADC_BITS)          // voltage per bit
 
 /*
- * Configuration registers
+ * Register map - first byte of a write is the register pointer
+ * - write: [pointer] [data] [data] ... - auto-increment after each byte
+ * - read: starts at the last pointer written, auto-increment after each byte
+ * - multi-byte values are LSB first
+ * - pointer after reset: SD16_REG_RESULT_L
+ * - STATUS, RESULT and SAMPLE_CNT are captured when a read starts - never mixed
+ *   between two conversions. SAMPLE_CNT increments on each result (or sequencer
+ *   pass), use it to detect repeated or skipped samples
+ * - 16-bit sequencer results, diagnostic counters and drift block words
+ *   are latched when the low byte is read, or on the high byte when a read
+ *   starts there - a word read low then high is never mixed
  */
+#define     SD16_REG_STATUS             (0x00)          // R  - status flags
+#define     SD16_REG_RESULT_L           (0x01)          // R  - last conversion result (low byte)
+#define     SD16_REG_RESULT_H           (0x02)          // R  - last conversion result (high byte)
+#define     SD16_REG_SAMPLE_CNT         (0x03)          // R  - sample counter, same snapshot as result
+#define     SD16_REG_FIFO_COUNT         (0x04)          // R  - queued samples
+#define     SD16_REG_FIFO_DATA          (0x05)          // R  - drain FIFO, pointer does not increment
+#define     SD16_REG_RESULT_EXT         (0x06)          // R  - 24-bit result, 3 bytes, same snapshot as result
+#define     SD16_REG_FIFO_DELTA         (0x09)          // R  - drain FIFO delta coded, pointer does not increment
+#define     SD16_REG_PACE_PERIOD        (0x0A)          // RW - paced sampling period in timer ticks, 2 bytes
+#define     SD16_REG_PACE_CTRL          (0x0C)          // RW - paced sampling control
+#define     SD16_REG_I2C_ADDR           (0x0E)          // RW - own 7-bit slave address
+#define     SD16_REG_I2C_CTRL           (0x0F)          // RW - general call / PEC enable, store address
+#define     SD16_REG_CHCTRL_L           (0x10)          // RW - SD16CCTL0 (low byte)
+#define     SD16_REG_CHCTRL_H           (0x11)          // RW - SD16CCTL0 (high byte)
+#define     SD16_REG_IN_CTRL            (0x12)          // RW - SD16INCTL0
+#define     SD16_REG_CONVERSION         (0x13)          // RW - start/stop conversion
+#define     SD16_REG_FIFO_CTRL          (0x14)          // W  - sample FIFO control
+#define     SD16_REG_SEQ_CTRL           (0x15)          // RW - scan sequencer control
+#define     SD16_REG_FILTER_CTRL        (0x16)          // RW - averaging filter, log2 of decimation
+#define     SD16_REG_STATS_WINDOW       (0x17)          // RW - statistics window, 2 bytes
+#define     SD16_REG_STATS_CTRL         (0x19)          // RW - statistics control
+#define     SD16_REG_COMP_LOW           (0x1A)          // RW - comparator low threshold, 2 bytes
+#define     SD16_REG_COMP_HIGH          (0x1C)          // RW - comparator high threshold, 2 bytes
+#define     SD16_REG_COMP_CTRL          (0x1E)          // RW - comparator control
+#define     SD16_REG_CAL_CTRL           (0x1F)          // RW - calibration control
+#define     SD16_REG_SEQ_CONFIG         (0x20)          // RW - slot n: [IN_CTRL] [CHCTRL_H] at 0x20 + 2n
+#define     SD16_REG_PRELOAD            (0x2A)          // RW - SD16PRE0, first conversion delay
+#define     SD16_REG_DISCARD            (0x2B)          // RW - results dropped after start / configuration change
+#define     SD16_REG_LATENCY            (0x2C)          // R  - time to first result in fM cycles, 2 bytes
+#define     SD16_REG_DRIFT_CTRL         (0x2E)          // RW - drift compensation control
+#define     SD16_REG_DRIFT_INTERVAL     (0x2F)          // RW - log2 of results between aux conversions
+#define     SD16_REG_SEQ_RESULT         (0x30)          // R  - slot n result at 0x30 + 2n
+#define     SD16_REG_STATS              (0x40)          // R  - statistics block, 16 bytes
+#define     SD16_REG_CAL                (0x50)          // RW - calibration block, 14 bytes
+#define     SD16_REG_DIAG               (0x60)          // RW - diagnostic counters, 16 bytes - write clears
+#define     SD16_REG_DRIFT              (0x70)          // RW - drift compensation block, 12 bytes
+#define     SD16_REG_LAST               (0x7B)
+
+/*
+ * Legacy commands - firmware option, see main.c
+ * - [command] [value], read pointer returns to SD16_REG_RESULT_L
+ */
+#define     SD16_LEGACY_CMD             (0x80)          // pointer values with bit 7 set
 #define     SD16_CHCTRL_LOW             (0xA0)          // SD16CCTL0 (low byte)
 #define     SD16_CHCTRL_HIGH            (0xA1)          // SD16CCTL0 (high byte)
 #define     SD16_IN_CTRL                (0xB0)          // SD16INCTL0
@@ -55,9 +108,256 @@
 #define     SD16_GAIN8x                 (0x03 << 3)
 #define     SD16_GAIN16x                (0x04 << 3)
 #define     SD16_GAIN32x                (0x05 << 3)
+#define     SD16_INTDLY_4TH             (0x00 << 6)     // first interrupt on 4th sample (default)
+#define     SD16_INTDLY_3RD             (0x01 << 6)     // 3rd - first settled sinc3 output
+#define     SD16_INTDLY_2ND             (0x02 << 6)     // 2nd / 1st - filter not settled
+#define     SD16_INTDLY_1ST             (0x03 << 6)
 /* SD16_CONVERSION */
 #define     SD16_STOP_CONVERSION        (0x00)          // start bit in low level
 #define     SD16_START_CONVERSION       (0x01)          // start bit in high level
+/* SD16_REG_STATUS */
+#define     SD16_STATUS_DRDY            (0x01)          // new result - cleared when status is read
+#define     SD16_STATUS_BUSY            (0x02)          // conversion in progress (SD16SC set)
+#define     SD16_STATUS_SEQ             (0x04)          // scan sequencer enabled
+#define     SD16_STATUS_STATS           (0x08)          // statistics window complete
+#define     SD16_STATUS_ALERT           (0x10)          // comparator alert - latched alert cleared on read
+#define     SD16_STATUS_CAL             (0x20)          // offset measurement or flash write in progress
+/* SD16_REG_FIFO_CTRL */
+#define     SD16_FIFO_FLUSH             (0x01)          // discard queued samples and overflow flag
+
+/*
+ * Paced sampling - firmware option, see main.c
+ * - Timer_A starts one single conversion (or sequencer pass with
+ *   SD16_SEQ_LOOP) per period, results queued in the FIFO
+ * - tick: ACLK from VLO (about 12 kHz, not trimmed - LPM3 between samples)
+ *   or SMCLK / 8 (2 MHz)
+ * - write SD16_REG_PACE_PERIOD before SD16_REG_PACE_CTRL
+ * - with SD16_PACE_POWER_DOWN the reference and buffer are off between
+ *   samples if the period is at least 2x the 5 ms warm-up - stop pacing
+ *   before starting conversions or calibration from the master
+ * - pacing forces single conversion; continuous mode set before is
+ *   restored (conversion stopped) when SD16_PACE_ENABLE is cleared
+ */
+/* SD16_REG_PACE_CTRL */
+#define     SD16_PACE_ENABLE            (0x01)
+#define     SD16_PACE_SMCLK             (0x02)          // 2 MHz tick, LPM1 (default: VLO, LPM3)
+#define     SD16_PACE_POWER_DOWN        (0x04)          // reference + buffer off between samples
+
+/*
+ * Slave address and general call - firmware options, see main.c
+ * - address after reset: last one stored with SD16_I2C_SAVE, or 0x0B
+ * - a new address is used from the next start condition - change it with
+ *   only one node at 0x0B on the bus
+ * - general call (address 0x00): [SD16_GCALL_START] or [SD16_GCALL_STOP],
+ *   accepted by each node with SD16_I2C_GCALL set. Conversions start on the
+ *   same SCL edge, SAMPLE_CNT and FIFO restart - read each node afterwards
+ */
+/*
+ * Packet error check - SMBus PEC, firmware option (ENABLE_PEC), see main.c
+ * - CRC-8, polynomial x^8 + x^2 + x + 1 (0x07), initial value 0, over every
+ *   byte of the transaction: address bytes (with R/W bit), pointer, data
+ *   and PEC bytes. The CRC restarts after a stop, not on a repeated start
+ * - write: [pointer] [data] [PEC] [data] [PEC] ... - each data byte is
+ *   applied only when its PEC matches, else it is Nacked and the rest of
+ *   the transaction is ignored (counted in SD16_DIAG_PEC_ERROR)
+ * - read: a PEC after each data byte, or after each 2 bytes with
+ *   SD16_I2C_PEC_WORD (SMBus read byte / read word) - read whole groups
+ * - the pointer byte is checked by the PEC that follows it: write it in
+ *   the same transaction as the read (repeated start)
+ * - general call: [command] [PEC]. Legacy commands are not accepted
+ * - framing changes from the next transaction, and is stored with
+ *   SD16_I2C_SAVE (the node then needs PEC after reset)
+ */
+/* SD16_REG_I2C_CTRL */
+#define     SD16_I2C_GCALL              (0x01)          // answer general call
+#define     SD16_I2C_PEC                (0x02)          // packet error check on every transaction
+#define     SD16_I2C_PEC_WORD           (0x04)          // read PEC after each 2 bytes (default: each byte)
+#define     SD16_I2C_SAVE               (0x80)          // store address + control in flash - set until written
+/* SD16_REG_I2C_ADDR - 7-bit addresses not reserved by the I2C specification */
+#define     SD16_I2C_ADDR_MIN           (0x08)
+#define     SD16_I2C_ADDR_MAX           (0x77)
+/* general call commands - second byte, not the reset (0x06) or address (0x04) codes */
+#define     SD16_GCALL_START            (0x0A)          // restart conversion - all nodes aligned
+#define     SD16_GCALL_STOP             (0x0C)          // stop conversion
+
+/*
+ * Settling after start or configuration change (IN_CTRL, CHCTRL)
+ * - PRELOAD, DISCARD and LATENCY are a firmware option, see main.c
+ * - the sinc3 filter settles in 3 conversions: SD16_INTDLY_3RD gives the
+ *   first valid result one conversion earlier than the default
+ * - SD16_REG_DISCARD: results dropped on top of SD16INTDLY, for external
+ *   settling (source impedance, gain change) - single conversions restart
+ * - SD16_REG_PRELOAD: first conversion delayed by SD16PRE0 fM cycles
+ * - SD16_REG_LATENCY: (interrupt sample + discard) * OSR + preload, in fM
+ *   cycles (us with fM = 1 MHz) - read after configuring. Single mode
+ *   restarts the conversion for each discard: (1 + discard) *
+ *   (interrupt sample * OSR + preload), saturated at 0xFFFF
+ */
+#define     SD16_DISCARD_MAX            (15)
+
+/*
+ * Sample FIFO
+ * - filled on each conversion, drained reading SD16_REG_FIFO_DATA
+ * - SD16_REG_FIFO_COUNT returns queued samples (bits 0-6) and overflow flag
+ * - a sample is removed when its high byte is sent - a read stopped after
+ *   a low byte sends that sample again
+ */
+#define     SD16_FIFO_DEPTH             (8)             // samples - power of 2
+#define     SD16_FIFO_OVERFLOW          (0x80)          // set when a sample was dropped
+
+/*
+ * Delta coded FIFO read - firmware option, see main.c
+ * - [count] [key L] [key H] [token] [token] ...
+ * - count: as SD16_REG_FIFO_COUNT when the read starts - no samples if 0
+ * - key: first sample, 16 bits
+ * - token: int8 difference to the previous sample, or SD16_DELTA_ESCAPE
+ *   followed by the full sample (LSB first), or SD16_DELTA_EMPTY
+ * - a sample is removed when its last byte is sent - the read can stop at
+ *   any byte, an incomplete sample is sent again by the next read
+ */
+#define     SD16_DELTA_ESCAPE           (0x80)          // full sample follows
+#define     SD16_DELTA_EMPTY            (0x81)          // FIFO empty - no sample
+#define     SD16_DELTA_MIN              (-126)
+#define     SD16_DELTA_MAX              (127)
+
+/*
+ * Scan sequencer - firmware option, see main.c
+ * - converts slots 0 to length-1, one single conversion each
+ * - slot results are kept in SD16_REG_SEQ_RESULT, DRDY set after each pass
+ * - default slots: CH0, CH1, CH2, temperature, VCC - gain 1x, OSR 256x
+ */
+#define     SD16_SEQ_SLOTS              (5)
+/* SD16_REG_SEQ_CTRL */
+#define     SD16_SEQ_ENABLE             (0x01)          // start scan - cleared after single pass
+#define     SD16_SEQ_LOOP               (0x02)          // repeat passes until disabled
+#define     SD16_SEQ_LENGTH(n)          ((n) << 4)      // slots per pass - 0 = SD16_SEQ_SLOTS
+#define     SD16_SEQ_LENGTH_MASK        (0x70)
+
+/*
+ * Averaging filter - boxcar decimator (1st order CIC), firmware option, see main.c
+ * - mean of 2^n conversions published as one result - DRDY, counter and FIFO
+ *   run at the decimated rate, sequencer slots are not filtered
+ * - SD16_REG_RESULT_EXT: mean * 256 (16-bit result + 8 fraction bits)
+ */
+/* SD16_REG_FILTER_CTRL */
+#define     SD16_FILTER_OFF             (0)
+#define     SD16_FILTER_AVG(n)          (n)             // average 2^n conversions - n = 1..8
+
+/*
+ * Windowed statistics - firmware option, see main.c
+ * - updated on each published result, 2's complement
+ * - writing SD16_REG_STATS_CTRL restarts the window
+ * - block is frozen while read: sum, sum of squares, count, min, max
+ *   mean = sum / count, rms = sqrt(sum of squares / count)
+ */
+/* SD16_REG_STATS_CTRL */
+#define     SD16_STATS_ENABLE           (0x01)
+#define     SD16_STATS_CLEAR_ON_READ    (0x02)          // restart after last byte of block is read
+/* SD16_REG_STATS block offsets */
+#define     SD16_STATS_SUM              (0)             // int32_t
+#define     SD16_STATS_SUM_SQUARES      (4)             // uint48_t
+#define     SD16_STATS_COUNT            (10)            // uint16_t
+#define     SD16_STATS_MIN              (12)            // int16_t
+#define     SD16_STATS_MAX              (14)            // int16_t
+#define     SD16_STATS_SIZE             (16)
+
+/*
+ * Threshold comparator - firmware option, see main.c
+ * - thresholds in the same format as the result (SD16DF)
+ * - thresholds written as words, low byte first - a threshold is used from
+ *   its high byte on
+ * - ALERT pin on P2.7 is open-drain - write thresholds before control, any
+ *   write to SD16_REG_COMP_CTRL clears the alert
+ */
+/* SD16_REG_COMP_CTRL */
+#define     SD16_COMP_ENABLE            (0x01)
+#define     SD16_COMP_TRADITIONAL       (0x00)          // alert above high, release below low
+#define     SD16_COMP_WINDOW            (0x02)          // alert outside low..high
+#define     SD16_COMP_LATCH             (0x04)          // keep alert until STATUS is read
+#define     SD16_COMP_ACTIVE_HIGH       (0x08)          // ALERT released on alert (default: driven low)
+#define     SD16_COMP_QUEUE_1           (0x00)          // consecutive results to alert
+#define     SD16_COMP_QUEUE_2           (0x10)
+#define     SD16_COMP_QUEUE_4           (0x20)
+#define     SD16_COMP_QUEUE_8           (0x30)
+#define     SD16_COMP_QUEUE_MASK        (0x30)
+
+/*
+ * Offset / gain calibration - firmware option, see main.c
+ * - offset of each gain measured on CH7 (inputs shorted), 2's complement,
+ *   at the OSR in use - one set for all OSRs, so the correction is exact
+ *   only at the measured OSR (measure with the OSR of the results; slots
+ *   of the sequencer with another OSR get that offset too)
+ * - gain coefficient written by the master, Q15 (0x8000 = 1.0)
+ * - block written as words, low byte first - a word is used from its
+ *   high byte on
+ * - result = (conversion - offset[gain]) * gain / 32768, saturated - applied
+ *   to each conversion (sequencer slots included) before filter and FIFO
+ * - block loaded from information flash on reset, stored on request
+ * - measurement stops the conversion and the sequencer, configuration is
+ *   restored after it - writes are Nacked while SD16_STATUS_CAL is set
+ */
+/* SD16_REG_CAL_CTRL */
+#define     SD16_CAL_ENABLE             (0x01)          // apply correction
+#define     SD16_CAL_MEASURE            (0x02)          // measure offsets of all gains
+#define     SD16_CAL_SAVE               (0x04)          // store block in flash (after measure)
+#define     SD16_CAL_RESTORE            (0x08)          // reload block from flash - defaults if erased
+/* SD16_REG_CAL block offsets */
+#define     SD16_CAL_GAIN               (0)             // uint16_t - Q15
+#define     SD16_CAL_OFFSET             (2)             // int16_t per gain, 1x to 32x
+#define     SD16_CAL_SIZE               (14)
+#define     SD16_CAL_GAIN_UNITY         (0x8000)
+
+/*
+ * Diagnostic counters (ENABLE_DIAGNOSTICS)
+ * - 16-bit event counters, LSB first, wrap around - compare two reads
+ * - a counter is latched when its low byte is read (or its high byte, if
+ *   the read starts there)
+ * - any write to the block clears all counters
+ */
+#define     SD16_DIAG_USI_ISR           (0)             // USI ISR entries (bus activity)
+#define     SD16_DIAG_SD16_ISR          (2)             // SD16 ISR entries (conversions)
+#define     SD16_DIAG_ADDR_NACK         (4)             // address of another slave
+#define     SD16_DIAG_RX_NACK           (6)             // written bytes Nacked (pointer, register, locked)
+#define     SD16_DIAG_DUMMY             (8)             // dummy bytes sent (empty FIFO, unmapped register)
+#define     SD16_DIAG_OVERRUN           (10)            // results replaced before being read
+#define     SD16_DIAG_FIFO_OVERFLOW     (12)            // samples dropped, FIFO full
+#define     SD16_DIAG_PEC_ERROR         (14)            // written bytes rejected, PEC mismatch
+#define     SD16_DIAG_SIZE              (16)
+
+/*
+ * Drift compensation - firmware option, see main.c
+ * - continuous conversion only: every 2^n results one conversion of the
+ *   temperature sensor (or VCC / 11) is made by the SD16 ISR, then the
+ *   main channel restarts. The stream pauses for 3 + interrupt delay +
+ *   discard conversions, SAMPLE_CNT does not skip
+ * - aux: 2's complement, gain 1x, OSR and polarity of the main channel
+ * - on each aux result, with d = aux - reference:
+ *     gain   = 0x8000 + d * gain coefficient / 65536     (Q15)
+ *     offset = d * offset coefficient / 65536            (codes)
+ * - result = result * gain / 32768 + offset, saturated - after the
+ *   calibration, before filter and FIFO
+ * - reference and coefficients written as words, low byte first - a word
+ *   is used from its high byte on
+ * - SD16_DRIFT_CAPTURE: the next aux result becomes the reference
+ * - SD16_DRIFT_ENABLE is Nacked in single conversion mode; a result in
+ *   single mode (pacing, CHCTRL written) clears ENABLE, APPLY and CAPTURE,
+ *   so DRIFT_CTRL shows it stopped - enable again in continuous mode
+ */
+/* SD16_REG_DRIFT_CTRL */
+#define     SD16_DRIFT_ENABLE           (0x01)          // interleave aux conversions
+#define     SD16_DRIFT_SUPPLY           (0x02)          // aux: VCC / 11 (default: temperature)
+#define     SD16_DRIFT_APPLY            (0x04)          // correct results - else aux only measured
+#define     SD16_DRIFT_CAPTURE          (0x08)          // reference from next aux - cleared when done
+/* SD16_REG_DRIFT_INTERVAL */
+#define     SD16_DRIFT_INTERVAL_MAX     (15)
+/* SD16_REG_DRIFT block offsets */
+#define     SD16_DRIFT_AUX              (0)             // int16_t R  - last aux result
+#define     SD16_DRIFT_REFERENCE        (2)             // int16_t RW - aux without correction
+#define     SD16_DRIFT_GAIN_COEF        (4)             // int16_t RW - 2^-31 gain per aux code
+#define     SD16_DRIFT_OFFSET_COEF      (6)             // int16_t RW - 1/65536 code per aux code
+#define     SD16_DRIFT_GAIN             (8)             // uint16_t R - Q15, in use
+#define     SD16_DRIFT_OFFSET           (10)            // int16_t R  - codes, in use
+#define     SD16_DRIFT_SIZE             (12)
 
 
 
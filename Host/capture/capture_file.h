@@ -0,0 +1,114 @@
+/******************************************************************************
+ * capture_file.h - SD16 capture file, written by sd16_capture
+ * - fixed layout, little endian - open with mmap() and index directly
+ *
+ *   [CaptureHeader]                         offset 0, headerSize bytes
+ *   [ChunkHeader] [int16_t x chunkSamples]  chunk 0
+ *   [ChunkHeader] [int16_t x chunkSamples]  chunk 1 ...
+ *
+ * - every chunk has the same size, chunk i is at CaptureChunkOffset(), the
+ *   last one is padded - only ChunkHeader.samples are valid
+ * - all samples of a chunk have the configuration of its header, a new
+ *   chunk starts when the configuration or the flags change
+ * - samples of a chunk are contiguous in time: a sequence gap or a frame
+ *   with SD16_FRAME_LOST starts a new chunk with SD16_FRAME_LOST in its
+ *   flags and the missing frames in lostFrames - firstSample counts
+ *   received samples only
+ * - raw codes as sent by the MSP430 (format in flags), converted with VFSR:
+ *   2's complement: v = code * VFSR / 32768
+ *   offset binary:  v = (code - 32768) * VFSR / 32768 (unsigned code)
+ * - with SD16_FRAME_PAIRS samples alternate [ADS1115] [MSP430]
+ *
+ * Haroldo Amaral
+ * https://github.com/agaelema/msp430f20x3_as_i2c_16bit_adc
+ ******************************************************************************/
+
+#ifndef CAPTURE_FILE_H_
+#define CAPTURE_FILE_H_
+
+#include <stdint.h>
+#include <string.h>
+#include "sd16_header.h"
+#include "sd16_frame.h"
+
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define     CAPTURE_MAGIC           "SD16CAP1"
+#define     CAPTURE_CHUNK_MAGIC     "CHNK"
+#define     CAPTURE_VERSION         (1)
+#define     CAPTURE_CHUNK_SAMPLES   (65536)         // default - 128 KB of samples per chunk
+
+struct CaptureHeader
+{
+    char        magic[8];                       // CAPTURE_MAGIC
+    uint32_t    version;
+    uint32_t    headerSize;                     // offset of chunk 0
+    uint32_t    chunkSamples;                   // sample slots per chunk
+    uint32_t    chunkCount;
+    uint64_t    sampleCount;                    // valid samples, all chunks
+    uint64_t    frameCount;                     // frames received
+    uint64_t    lostFrames;                     // sequence gaps
+    uint64_t    badFrames;                      // wrong length or checksum
+    double      vref;                           // V
+};
+
+struct ChunkHeader
+{
+    char        magic[4];                       // CAPTURE_CHUNK_MAGIC
+    uint32_t    samples;                        // valid samples in this chunk
+    uint64_t    firstSample;                    // index in the capture
+    uint8_t     inCtrl;                         // SD16INCTL0 - channel, gain
+    uint8_t     chctrlHigh;                     // OSR, single, unipolar
+    uint8_t     flags;                          // SD16_FRAME_... - LOST: gap before this chunk
+    uint8_t     lostFrames;                     // sequence gap before this chunk, 255: 255 or more
+    uint16_t    osr;                            // 32 .. 1024
+    uint16_t    gain;                           // 1 .. 32
+    double      vfsr;                           // full scale range, V - VREF / 2 / gain
+};
+
+static_assert(sizeof(CaptureHeader) == 64, "capture header layout");
+static_assert(sizeof(ChunkHeader) == 32, "chunk header layout");
+
+
+/******************************************************************************
+ * Helpers
+ ******************************************************************************/
+static inline uint64_t CaptureChunkSize(const CaptureHeader *header)
+{
+    return sizeof(ChunkHeader) + 2ULL * header->chunkSamples;
+}
+
+static inline uint64_t CaptureChunkOffset(const CaptureHeader *header, uint32_t chunk)
+{
+    return header->headerSize + chunk * CaptureChunkSize(header);
+}
+
+static inline bool CaptureValid(const CaptureHeader *header, uint64_t fileSize)
+{
+    return (fileSize >= sizeof(CaptureHeader)) && !memcmp(header->magic, CAPTURE_MAGIC, 8)
+        && (header->version == CAPTURE_VERSION) && (header->chunkSamples > 0)
+        && (CaptureChunkOffset(header, header->chunkCount) <= fileSize);
+}
+
+static inline uint16_t CaptureOsr(uint8_t chctrlHigh)
+{
+    switch (chctrlHigh & (SD16_OSR_32x|SD16_OSR_1024x))
+    {
+    case SD16_OSR_32x:      return 32;
+    case SD16_OSR_64x:      return 64;
+    case SD16_OSR_128x:     return 128;
+    case SD16_OSR_512x:     return 512;
+    case SD16_OSR_1024x:    return 1024;
+    }
+    return 256;
+}
+
+static inline uint16_t CaptureGain(uint8_t inCtrl)
+{
+    return 1 << ((inCtrl >> 3) & 0x07);
+}
+
+
+#endif /* CAPTURE_FILE_H_ */
@@ -0,0 +1,539 @@
+/******************************************************************************
+ * sd16_capture.cpp - record the binary stream of the Arduino example
+ * - reads sd16_frame.h frames from a serial port (I2C_ADC_BINARY_STREAM),
+ *   checks sync, length, checksum and sequence number
+ * - writes a capture file (capture_file.h): fixed size chunks, one
+ *   configuration per chunk, readable with mmap()
+ * - -i prints the chunks of a capture file, read through mmap()
+ *
+ * Build (from this folder):
+ *   g++ -std=c++17 -Wall -O2 -I../../Arduino/msp430f2013_SD16_I2C -o sd16_capture sd16_capture.cpp
+ *
+ * Usage:
+ *   ./sd16_capture [-b baud] [-n samples] [-t seconds] [-c chunk samples] /dev/ttyUSB0 out.cap
+ *   ./sd16_capture -i out.cap
+ *   The input can also be a file with a recorded stream, "-" for stdin.
+ *
+ * Haroldo Amaral
+ * https://github.com/agaelema/msp430f20x3_as_i2c_16bit_adc
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vector>
+#include "capture_file.h"
+
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define     READ_SIZE           (4096)
+#define     FLUSH_SAMPLES       (4096)          // file header and chunk header updated
+
+
+static volatile sig_atomic_t stopRequest = 0;
+
+static void SignalStop(int signal)
+{
+    (void)signal;
+    stopRequest = 1;
+}
+
+
+/******************************************************************************
+ * Serial port - raw 8N1
+ ******************************************************************************/
+static speed_t BaudCode(unsigned long baud)
+{
+    switch (baud)
+    {
+    case 9600:      return B9600;
+    case 57600:     return B57600;
+    case 115200:    return B115200;
+    case 230400:    return B230400;
+    case 500000:    return B500000;
+    case 1000000:   return B1000000;
+    case 2000000:   return B2000000;
+    }
+    return B0;
+}
+
+
+static int SerialOpen(const char *device, unsigned long baud)
+{
+    struct termios tty;
+    int fd;
+
+    if ( !strcmp(device, "-") )
+    {
+        return STDIN_FILENO;
+    }
+    fd = open(device, O_RDONLY | O_NOCTTY);
+    if ( (fd < 0) || !isatty(fd) )
+    {
+        return fd;                                  // recorded stream
+    }
+
+    if (tcgetattr(fd, &tty) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    cfmakeraw(&tty);
+    cfsetispeed(&tty, BaudCode(baud));
+    cfsetospeed(&tty, BaudCode(baud));
+    tty.c_cflag |= CLOCAL | CREAD;
+    tty.c_cc[VMIN] = 1;
+    tty.c_cc[VTIME] = 0;
+    if (tcsetattr(fd, TCSANOW, &tty) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+    tcflush(fd, TCIFLUSH);                          // drop text sent before
+    return fd;
+}
+
+
+/******************************************************************************
+ * Capture file writer
+ ******************************************************************************/
+class CaptureWriter
+{
+public:
+    bool open(const char *path, uint32_t chunkSamples);
+    bool add(const uint8_t *frame, uint32_t lostFrames);   // checked frame, sequence gap before it
+    bool close();
+
+    CaptureHeader   header = CaptureHeader();
+
+private:
+    bool newChunk(const uint8_t *frame);
+    bool flush();
+    bool writeHeader();
+
+    int                     fd = -1;
+    ChunkHeader             chunk = ChunkHeader();
+    std::vector<int16_t>    pending;                // samples not written yet
+    uint32_t                written = 0;            // samples of the chunk in the file
+};
+
+
+bool CaptureWriter::open(const char *path, uint32_t chunkSamples)
+{
+    fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        return false;
+    }
+    memcpy(&header, CAPTURE_MAGIC, sizeof(header.magic));   // first member
+    header.version = CAPTURE_VERSION;
+    header.headerSize = sizeof(CaptureHeader);
+    header.chunkSamples = chunkSamples;
+    header.vref = VREF;
+    pending.reserve(FLUSH_SAMPLES + SD16_FRAME_MAX_SAMPLES);
+
+    return writeHeader();
+}
+
+
+bool CaptureWriter::writeHeader()
+{
+    return pwrite(fd, &header, sizeof(header), 0) == sizeof(header);
+}
+
+
+bool CaptureWriter::newChunk(const uint8_t *frame)
+{
+    if ( (header.chunkCount > 0) && !flush() )
+    {
+        return false;
+    }
+
+    chunk = ChunkHeader();
+    memcpy(&chunk, CAPTURE_CHUNK_MAGIC, sizeof(chunk.magic));
+    chunk.firstSample = header.sampleCount;
+    chunk.inCtrl = frame[4];
+    chunk.chctrlHigh = frame[5];
+    chunk.flags = frame[6] & ~SD16_FRAME_LOST;      // per frame - set by add() on a gap
+    chunk.osr = CaptureOsr(chunk.chctrlHigh);
+    chunk.gain = CaptureGain(chunk.inCtrl);
+    chunk.vfsr = (VREF / 2.0) / chunk.gain;
+    written = 0;
+
+    header.chunkCount++;
+    /* full size at once - fixed stride even if the capture stops here */
+    return ftruncate(fd, CaptureChunkOffset(&header, header.chunkCount)) == 0;
+}
+
+
+/*
+ * a gap (lost frames, or samples lost by the sender) ends the chunk, so
+ * the samples of a chunk stay contiguous in time
+ */
+bool CaptureWriter::add(const uint8_t *frame, uint32_t lostFrames)
+{
+    bool gap = lostFrames || (frame[6] & SD16_FRAME_LOST);
+    uint8_t n = frame[7];
+    uint8_t i;
+
+    header.lostFrames += lostFrames;
+    if ( gap || (header.chunkCount == 0) || (frame[4] != chunk.inCtrl) || (frame[5] != chunk.chctrlHigh)
+      || ((frame[6] & ~SD16_FRAME_LOST) != (chunk.flags & ~SD16_FRAME_LOST)) )
+    {
+        if ( !newChunk(frame) )
+        {
+            return false;
+        }
+        if (gap)
+        {
+            chunk.flags |= SD16_FRAME_LOST;
+            chunk.lostFrames = (lostFrames < 255) ? lostFrames : 255;
+        }
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        if (chunk.samples == header.chunkSamples)
+        {
+            if ( !newChunk(frame) )
+            {
+                return false;
+            }
+        }
+        pending.push_back((int16_t)(frame[SD16_FRAME_HEADER + 2*i] | (frame[SD16_FRAME_HEADER + 2*i + 1] << 8)));
+        chunk.samples++;
+        header.sampleCount++;
+    }
+    header.frameCount++;
+
+    return (pending.size() < FLUSH_SAMPLES) || flush();
+}
+
+
+/*
+ * samples, then chunk header, then file header - a reader never sees a
+ * count that covers samples not written
+ */
+bool CaptureWriter::flush()
+{
+    uint64_t offset = CaptureChunkOffset(&header, header.chunkCount - 1);
+    size_t bytes = pending.size() * sizeof(int16_t);
+
+    if ( bytes && (pwrite(fd, pending.data(), bytes, offset + sizeof(ChunkHeader) + 2ULL * written) != (ssize_t)bytes) )
+    {
+        return false;
+    }
+    written += pending.size();
+    pending.clear();
+
+    return (pwrite(fd, &chunk, sizeof(chunk), offset) == sizeof(chunk)) && writeHeader();
+}
+
+
+bool CaptureWriter::close()
+{
+    bool ok = true;
+
+    if (fd < 0)
+    {
+        return false;
+    }
+    if (header.chunkCount > 0)
+    {
+        ok = flush();
+    }
+    else
+    {
+        ok = writeHeader();
+    }
+    ok = (::close(fd) == 0) && ok;
+    fd = -1;
+    return ok;
+}
+
+
+/******************************************************************************
+ * Frame parser
+ ******************************************************************************/
+static uint16_t Fletcher16(const uint8_t *data, size_t length)
+{
+    uint16_t sum1 = 0;
+    uint16_t sum2 = 0;
+    size_t i;
+
+    for (i = 0; i < length; i++)
+    {
+        sum1 = (sum1 + data[i]) % 255;
+        sum2 = (sum2 + sum1) % 255;
+    }
+    return sum1 | (sum2 << 8);
+}
+
+
+/*
+ * returns bytes used from data: a frame, a byte skipped to find the sync,
+ * or 0 if more bytes are needed. *frame set when a checked frame is found
+ */
+static size_t FrameParse(const uint8_t *data, size_t length, const uint8_t **frame, uint64_t *badFrames)
+{
+    size_t size;
+    uint8_t n;
+
+    *frame = nullptr;
+    if (length < SD16_FRAME_HEADER)
+    {
+        return 0;
+    }
+    if ( (data[0] != SD16_FRAME_SYNC_0) || (data[1] != SD16_FRAME_SYNC_1) )
+    {
+        return 1;
+    }
+
+    n = data[7];
+    if ( (n == 0) || (n > SD16_FRAME_MAX_SAMPLES) )
+    {
+        (*badFrames)++;
+        return 1;
+    }
+    size = SD16_FRAME_SIZE(n);
+    if (length < size)
+    {
+        return 0;
+    }
+    if ( Fletcher16(&data[2], size - 2 - SD16_FRAME_CHECK)
+         != (data[size - 2] | (data[size - 1] << 8)) )
+    {
+        (*badFrames)++;                             // or sync bytes inside samples
+        return 1;
+    }
+
+    *frame = data;
+    return size;
+}
+
+
+/******************************************************************************
+ * Capture file info - read through mmap
+ ******************************************************************************/
+static int CaptureInfo(const char *path)
+{
+    struct stat st;
+    const uint8_t *map;
+    const CaptureHeader *header;
+    uint32_t i, n;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if ( (fd < 0) || (fstat(fd, &st) < 0) )
+    {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    map = (const uint8_t *)mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    header = (const CaptureHeader *)map;
+    if ( !CaptureValid(header, st.st_size) )
+    {
+        fprintf(stderr, "%s: not a capture file\n", path);
+        return 1;
+    }
+    printf("%s: %llu samples, %u chunks, %llu frames, %llu lost, %llu bad, VREF %.3f V\n", path,
+           (unsigned long long)header->sampleCount, header->chunkCount,
+           (unsigned long long)header->frameCount, (unsigned long long)header->lostFrames,
+           (unsigned long long)header->badFrames, header->vref);
+
+    for (i = 0; i < header->chunkCount; i++)
+    {
+        const ChunkHeader *chunk = (const ChunkHeader *)(map + CaptureChunkOffset(header, i));
+        const int16_t *samples = (const int16_t *)(chunk + 1);
+        int16_t min = INT16_MAX;
+        int16_t max = INT16_MIN;
+        double sum = 0;
+
+        for (n = 0; n < chunk->samples; n++)
+        {
+            min = (samples[n] < min) ? samples[n] : min;
+            max = (samples[n] > max) ? samples[n] : max;
+            sum += samples[n];
+        }
+        printf("chunk %u: %u samples from %llu, channel %u, gain %u, OSR %u, VFSR %.4f V, flags 0x%02X",
+               i, chunk->samples, (unsigned long long)chunk->firstSample, chunk->inCtrl & 0x07,
+               chunk->gain, chunk->osr, chunk->vfsr, chunk->flags);
+        if (chunk->flags & SD16_FRAME_LOST)
+        {
+            if (chunk->lostFrames)
+            {
+                printf(", gap before: %u%s frames lost", chunk->lostFrames, (chunk->lostFrames == 255) ? "+" : "");
+            }
+            else
+            {
+                printf(", gap before: samples lost by the sender");
+            }
+        }
+        if (chunk->samples)
+        {
+            printf(", min %d, max %d, mean %.1f", min, max, sum / chunk->samples);
+        }
+        printf("\n");
+    }
+
+    munmap((void *)map, st.st_size);
+    return 0;
+}
+
+
+/******************************************************************************
+ * main
+ ******************************************************************************/
+static void Usage(void)
+{
+    fprintf(stderr, "usage: sd16_capture [-b baud] [-n samples] [-t seconds] [-c chunk samples] <port|file|-> <capture>\n"
+                    "       sd16_capture -i <capture>\n");
+    exit(2);
+}
+
+
+int main(int argc, char **argv)
+{
+    unsigned long baud = SD16_FRAME_BAUD;
+    unsigned long long maxSamples = 0;
+    unsigned long seconds = 0;
+    uint32_t chunkSamples = CAPTURE_CHUNK_SAMPLES;
+    const char *info = nullptr;
+    std::vector<uint8_t> buffer;
+    CaptureWriter writer;
+    uint16_t lastSequence = 0;
+    uint16_t lost;
+    bool sequenceValid = false;
+    time_t startTime;
+    int input;
+    int opt;
+
+    while ( (opt = getopt(argc, argv, "b:n:t:c:i:")) != -1 )
+    {
+        switch (opt)
+        {
+        case 'b':
+            baud = strtoul(optarg, nullptr, 0);
+            if (BaudCode(baud) == B0)
+            {
+                Usage();
+            }
+            break;
+        case 'n':
+            maxSamples = strtoull(optarg, nullptr, 0);
+            break;
+        case 't':
+            seconds = strtoul(optarg, nullptr, 0);
+            break;
+        case 'c':
+            chunkSamples = strtoul(optarg, nullptr, 0);
+            if (chunkSamples == 0)
+            {
+                Usage();
+            }
+            break;
+        case 'i':
+            info = optarg;
+            break;
+        default:
+            Usage();
+        }
+    }
+    if (info)
+    {
+        return CaptureInfo(info);
+    }
+    if (optind != argc - 2)
+    {
+        Usage();
+    }
+
+    input = SerialOpen(argv[optind], baud);
+    if (input < 0)
+    {
+        fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+        return 1;
+    }
+    if ( !writer.open(argv[optind + 1], chunkSamples) )
+    {
+        fprintf(stderr, "%s: %s\n", argv[optind + 1], strerror(errno));
+        return 1;
+    }
+
+    signal(SIGINT, SignalStop);
+    signal(SIGTERM, SignalStop);
+    startTime = time(nullptr);
+
+    while ( !stopRequest )
+    {
+        uint8_t data[READ_SIZE];
+        ssize_t received = read(input, data, sizeof(data));
+        size_t used = 0;
+        size_t step;
+        const uint8_t *frame;
+
+        if (received <= 0)
+        {
+            if ( (received < 0) && (errno == EINTR) )
+            {
+                continue;
+            }
+            break;                                  // end of recorded stream
+        }
+        buffer.insert(buffer.end(), data, data + received);
+
+        while ( (step = FrameParse(buffer.data() + used, buffer.size() - used, &frame, &writer.header.badFrames)) > 0 )
+        {
+            used += step;
+            if ( !frame )
+            {
+                continue;
+            }
+
+            uint16_t sequence = frame[2] | (frame[3] << 8);
+            lost = sequenceValid ? (uint16_t)(sequence - lastSequence - 1) : 0;
+            lastSequence = sequence;
+            sequenceValid = true;
+
+            if ( !writer.add(frame, lost) )
+            {
+                fprintf(stderr, "%s: %s\n", argv[optind + 1], strerror(errno));
+                return 1;
+            }
+        }
+        buffer.erase(buffer.begin(), buffer.begin() + used);
+
+        if ( (maxSamples && (writer.header.sampleCount >= maxSamples))
+          || (seconds && ((unsigned long)(time(nullptr) - startTime) >= seconds)) )
+        {
+            break;
+        }
+    }
+
+    if ( !writer.close() )
+    {
+        fprintf(stderr, "%s: %s\n", argv[optind + 1], strerror(errno));
+        return 1;
+    }
+    fprintf(stderr, "%llu samples, %llu frames, %llu lost, %llu bad\n",
+            (unsigned long long)writer.header.sampleCount, (unsigned long long)writer.header.frameCount,
+            (unsigned long long)writer.header.lostFrames, (unsigned long long)writer.header.badFrames);
+    return 0;
+}
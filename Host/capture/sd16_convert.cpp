@@ -0,0 +1,191 @@
+/******************************************************************************
+ * sd16_convert.cpp - raw SD16 codes to volts or degrees, whole buffers
+ *
+ * Haroldo Amaral
+ * https://github.com/agaelema/msp430f20x3_as_i2c_16bit_adc
+ ******************************************************************************/
+
+#include "sd16_header.h"
+#include "sd16_convert.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define     CONVERT_X86
+#endif
+
+
+/******************************************************************************
+ * Scale - affine map of the signed code
+ ******************************************************************************/
+ConvertScale ConvertVolts(uint8_t format, uint8_t chctrlHigh, unsigned gain, double vref,
+                          const ConvertCal *cal)
+{
+    ConvertScale scale;
+    double vfsr = (vref / 2.0) / (gain ? gain : 1);
+    double a, b;
+
+    if (chctrlHigh & SD16_UNIPOLAR)
+    {
+        a = vfsr / 65536.0;
+        b = vfsr / 2.0;                             // x = -32768 -> 0 V
+    }
+    else
+    {
+        a = vfsr / 32768.0;
+        b = 0.0;
+    }
+
+    if (cal)                                        // (x - offset) * gain
+    {
+        a *= cal->gain;
+        b -= cal->offsetCode * a;
+    }
+
+    scale.mask = (format & SD16_DF_2S_COMP) ? 0x0000 : 0x8000;
+    scale.a = (float)a;
+    scale.b = (float)b;
+    return scale;
+}
+
+
+ConvertScale ConvertTemperature(uint8_t format, uint8_t chctrlHigh, double vref, const ConvertCal *cal)
+{
+    ConvertScale scale = ConvertVolts(format, chctrlHigh, 1, vref, cal);
+
+    scale.a = (float)(scale.a / CONVERT_TEMP_TC);
+    scale.b = (float)(scale.b / CONVERT_TEMP_TC - CONVERT_KELVIN);
+    return scale;
+}
+
+
+/******************************************************************************
+ * Kernels - same operations in the same order (x * a, then + b, no FMA), so
+ * every kernel gives the same floats as the scalar one
+ ******************************************************************************/
+#if defined(__GNUC__) && !defined(__clang__)
+__attribute__((optimize("no-tree-vectorize")))      // reference - one sample at a time
+#endif
+void ConvertCodesScalar(const int16_t *codes, float *out, size_t count, const ConvertScale &scale)
+{
+    size_t i;
+
+#if defined(__clang__)
+#pragma clang loop vectorize(disable)
+#endif
+    for (i = 0; i < count; i++)
+    {
+        int16_t x = (int16_t)((uint16_t)codes[i] ^ scale.mask);
+
+        out[i] = (float)x * scale.a + scale.b;
+    }
+}
+
+
+/*
+ * plain loop - vectorized by the compiler where no kernel below applies
+ */
+static void ConvertCodesGeneric(const int16_t *codes, float *out, size_t count, const ConvertScale &scale)
+{
+    const uint16_t mask = scale.mask;
+    const float a = scale.a;
+    const float b = scale.b;
+    size_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        out[i] = (float)(int16_t)((uint16_t)codes[i] ^ mask) * a + b;
+    }
+}
+
+
+#if defined(CONVERT_X86)
+/*
+ * 8 codes per step: sign extend 16 -> 32 bits by unpacking the code into
+ * the high half and shifting back
+ */
+__attribute__((target("sse2")))
+static void ConvertCodesSse2(const int16_t *codes, float *out, size_t count, const ConvertScale &scale)
+{
+    const __m128i mask = _mm_set1_epi16((int16_t)scale.mask);
+    const __m128 a = _mm_set1_ps(scale.a);
+    const __m128 b = _mm_set1_ps(scale.b);
+    size_t i = 0;
+
+    for (; (i + 8) <= count; i += 8)
+    {
+        __m128i x = _mm_xor_si128(_mm_loadu_si128((const __m128i *)&codes[i]), mask);
+        __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+
+        _mm_storeu_ps(&out[i], _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(low), a), b));
+        _mm_storeu_ps(&out[i + 4], _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(high), a), b));
+    }
+    ConvertCodesGeneric(&codes[i], &out[i], count - i, scale);
+}
+
+
+/*
+ * 16 codes per step
+ */
+__attribute__((target("avx2")))
+static void ConvertCodesAvx2(const int16_t *codes, float *out, size_t count, const ConvertScale &scale)
+{
+    const __m128i mask = _mm_set1_epi16((int16_t)scale.mask);
+    const __m256 a = _mm256_set1_ps(scale.a);
+    const __m256 b = _mm256_set1_ps(scale.b);
+    size_t i = 0;
+
+    for (; (i + 16) <= count; i += 16)
+    {
+        __m128i x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)&codes[i]), mask);
+        __m128i x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)&codes[i + 8]), mask);
+        __m256 f0 = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(x0));
+        __m256 f1 = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(x1));
+
+        _mm256_storeu_ps(&out[i], _mm256_add_ps(_mm256_mul_ps(f0, a), b));
+        _mm256_storeu_ps(&out[i + 8], _mm256_add_ps(_mm256_mul_ps(f1, a), b));
+    }
+    ConvertCodesSse2(&codes[i], &out[i], count - i, scale);
+}
+#endif
+
+
+/******************************************************************************
+ * Dispatch - chosen once
+ ******************************************************************************/
+typedef void (*ConvertFunction)(const int16_t *, float *, size_t, const ConvertScale &);
+
+static ConvertFunction ConvertSelect(const char **name)
+{
+#if defined(CONVERT_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        *name = "avx2";
+        return ConvertCodesAvx2;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        *name = "sse2";
+        return ConvertCodesSse2;
+    }
+#endif
+    *name = "generic";
+    return ConvertCodesGeneric;
+}
+
+
+static const char *kernelName;
+static const ConvertFunction kernel = ConvertSelect(&kernelName);
+
+
+void ConvertCodes(const int16_t *codes, float *out, size_t count, const ConvertScale &scale)
+{
+    kernel(codes, out, count, scale);
+}
+
+
+const char *ConvertKernel()
+{
+    return kernelName;
+}
@@ -0,0 +1,69 @@
+/******************************************************************************
+ * sd16_convert.h - raw SD16 codes to volts or degrees, whole buffers
+ * - every gain, 2's complement / offset binary, bipolar / unipolar
+ * - all cases are one affine map of the signed code:
+ *     x = (int16_t)(code ^ mask)      mask 0x8000 for offset binary
+ *     out = x * a + b
+ *   so calibration (offset in codes, gain factor) is folded into a and b
+ *   and costs nothing per sample
+ * - ConvertCodes() runs AVX2 or SSE2 on x86-64 (selected at run time),
+ *   otherwise a loop the compiler vectorizes (NEON with -O3)
+ *
+ * SD16_A ranges - VFSR = VREF / 2 / gain
+ *   bipolar:  -VFSR .. +VFSR,  v = x * VFSR / 32768
+ *   unipolar:  0 .. +VFSR,     v = (x + 32768) * VFSR / 65536
+ * Temperature (SD16_CH6_Temperature, gain 1):
+ *   v = 1.32 mV/K * (273 + T) + offset, T = v / 1.32 mV - 273
+ *   the sensor offset (datasheet: up to +-100 mV) needs a one point
+ *   calibration - ConvertCal.offsetCode at a known temperature
+ *
+ * Haroldo Amaral
+ * https://github.com/agaelema/msp430f20x3_as_i2c_16bit_adc
+ ******************************************************************************/
+
+#ifndef SD16_CONVERT_H_
+#define SD16_CONVERT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define     CONVERT_TEMP_TC         (0.00132)       // V/K - temperature sensor
+#define     CONVERT_KELVIN          (273.0)
+
+struct ConvertScale
+{
+    uint16_t    mask;                           // XOR to signed code
+    float       a;                              // per code
+    float       b;                              // offset
+};
+
+/*
+ * calibration - corrected = (x - offsetCode) * gain
+ * - as the MSP430 correction (ENABLE_CALIBRATION), with gain as a factor
+ */
+struct ConvertCal
+{
+    double      offsetCode = 0.0;
+    double      gain = 1.0;
+};
+
+
+/******************************************************************************
+ * Prototypes
+ ******************************************************************************/
+/* format: SD16_DF_2S_COMP bit of CHCTRL_L (or SD16_FRAME_2S_COMP), chctrlHigh: unipolar bit */
+ConvertScale ConvertVolts(uint8_t format, uint8_t chctrlHigh, unsigned gain, double vref,
+                          const ConvertCal *cal = nullptr);
+ConvertScale ConvertTemperature(uint8_t format, uint8_t chctrlHigh, double vref,
+                                const ConvertCal *cal = nullptr);
+
+void ConvertCodes(const int16_t *codes, float *out, size_t count, const ConvertScale &scale);
+void ConvertCodesScalar(const int16_t *codes, float *out, size_t count, const ConvertScale &scale);
+const char *ConvertKernel();                    // "avx2", "sse2" or "generic"
+
+
+#endif /* SD16_CONVERT_H_ */
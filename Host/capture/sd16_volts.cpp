@@ -0,0 +1,253 @@
+/******************************************************************************
+ * sd16_volts.cpp - convert a capture file to volts / degrees
+ * - capture mapped with mmap(), each chunk converted with its own gain,
+ *   format and polarity, SD16_CH6_Temperature chunks in degrees C
+ * - optional calibration: offset in codes and gain factor
+ * - -w writes the converted samples as float32, in capture order
+ * - -B compares the vector kernel with the scalar loop (speed, results)
+ *
+ * Build (from this folder):
+ *   g++ -std=c++17 -Wall -O2 -I../../Arduino/msp430f2013_SD16_I2C -o sd16_volts \
+ *       sd16_volts.cpp sd16_convert.cpp
+ *
+ * Usage:
+ *   ./sd16_volts [-o offset code] [-g gain factor] [-w out.f32] capture.cap
+ *   ./sd16_volts -B [capture.cap]
+ *
+ * Haroldo Amaral
+ * https://github.com/agaelema/msp430f20x3_as_i2c_16bit_adc
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vector>
+#include "capture_file.h"
+#include "sd16_convert.h"
+
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define     BENCH_SAMPLES       (4000000UL)     // synthetic capture
+#define     BENCH_ROUNDS        (20)
+
+
+static double Now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static ConvertScale ChunkScale(const ChunkHeader *chunk, double vref, const ConvertCal *cal, bool *degrees)
+{
+    uint8_t format = chunk->flags & SD16_FRAME_2S_COMP;
+
+    *degrees = (chunk->inCtrl & 0x07) == SD16_CH6_Temperature;
+    if (*degrees)
+    {
+        return ConvertTemperature(format, chunk->chctrlHigh, vref, cal);
+    }
+    return ConvertVolts(format, chunk->chctrlHigh, chunk->gain, vref, cal);
+}
+
+
+/*
+ * throughput of both kernels on the same codes, results compared
+ */
+static int Benchmark(const int16_t *codes, size_t count, const ConvertScale &scale)
+{
+    std::vector<float> scalar(count);
+    std::vector<float> vector(count);
+    double start, scalarTime, vectorTime;
+    size_t mismatch = 0;
+    size_t i;
+    int round;
+
+    ConvertCodesScalar(codes, scalar.data(), count, scale);     // warm up, page in
+    ConvertCodes(codes, vector.data(), count, scale);
+
+    start = Now();
+    for (round = 0; round < BENCH_ROUNDS; round++)
+    {
+        ConvertCodesScalar(codes, scalar.data(), count, scale);
+    }
+    scalarTime = (Now() - start) / BENCH_ROUNDS;
+
+    start = Now();
+    for (round = 0; round < BENCH_ROUNDS; round++)
+    {
+        ConvertCodes(codes, vector.data(), count, scale);
+    }
+    vectorTime = (Now() - start) / BENCH_ROUNDS;
+
+    for (i = 0; i < count; i++)
+    {
+        if ( fabsf(scalar[i] - vector[i]) > (1e-6f * fabsf(scalar[i]) + 1e-9f) )   // FMA on some targets
+        {
+            mismatch++;
+        }
+    }
+
+    printf("%zu samples: scalar %.1f Msample/s, %s %.1f Msample/s (x%.1f), %zu mismatches\n", count,
+           count / scalarTime * 1e-6, ConvertKernel(), count / vectorTime * 1e-6,
+           scalarTime / vectorTime, mismatch);
+    return mismatch ? 1 : 0;
+}
+
+
+static void Usage(void)
+{
+    fprintf(stderr, "usage: sd16_volts [-o offset code] [-g gain factor] [-w out.f32] <capture>\n"
+                    "       sd16_volts -B [capture]\n");
+    exit(2);
+}
+
+
+int main(int argc, char **argv)
+{
+    ConvertCal cal;
+    bool useCal = false;
+    bool bench = false;
+    const char *outPath = nullptr;
+    FILE *outFile = nullptr;
+    struct stat st;
+    const uint8_t *map;
+    const CaptureHeader *header;
+    std::vector<float> values;
+    uint32_t i;
+    int opt;
+    int fd;
+
+    while ( (opt = getopt(argc, argv, "o:g:w:B")) != -1 )
+    {
+        switch (opt)
+        {
+        case 'o':
+            cal.offsetCode = strtod(optarg, nullptr);
+            useCal = true;
+            break;
+        case 'g':
+            cal.gain = strtod(optarg, nullptr);
+            useCal = true;
+            break;
+        case 'w':
+            outPath = optarg;
+            break;
+        case 'B':
+            bench = true;
+            break;
+        default:
+            Usage();
+        }
+    }
+
+    if (bench && (optind == argc))                  // synthetic: noisy sine, 2's complement
+    {
+        std::vector<int16_t> codes(BENCH_SAMPLES);
+        size_t n;
+
+        for (n = 0; n < codes.size(); n++)
+        {
+            codes[n] = (int16_t)(20000.0 * sin(n * 0.001) + (rand() % 64) - 32);
+        }
+        return Benchmark(codes.data(), codes.size(), ConvertVolts(SD16_DF_2S_COMP, SD16_BIPOLAR, 1, VREF));
+    }
+    if (optind != argc - 1)
+    {
+        Usage();
+    }
+
+    fd = open(argv[optind], O_RDONLY);
+    if ( (fd < 0) || (fstat(fd, &st) < 0) )
+    {
+        fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+        return 1;
+    }
+    map = (const uint8_t *)mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr, "%s: %s\n", argv[optind], strerror(errno));
+        return 1;
+    }
+    header = (const CaptureHeader *)map;
+    if ( !CaptureValid(header, st.st_size) )
+    {
+        fprintf(stderr, "%s: not a capture file\n", argv[optind]);
+        return 1;
+    }
+
+    if (outPath && !(outFile = fopen(outPath, "wb")))
+    {
+        fprintf(stderr, "%s: %s\n", outPath, strerror(errno));
+        return 1;
+    }
+    values.resize(header->chunkSamples);
+
+    for (i = 0; i < header->chunkCount; i++)
+    {
+        const ChunkHeader *chunk = (const ChunkHeader *)(map + CaptureChunkOffset(header, i));
+        const int16_t *codes = (const int16_t *)(chunk + 1);
+        bool degrees;
+        ConvertScale scale = ChunkScale(chunk, header->vref, useCal ? &cal : nullptr, &degrees);
+        double sum = 0;
+        float min, max;
+        uint32_t n;
+
+        if (chunk->flags & SD16_FRAME_PAIRS)
+        {
+            printf("chunk %u: ADS1115 pairs - not converted\n", i);
+            continue;
+        }
+        if (bench)
+        {
+            printf("chunk %u: ", i);
+            if (Benchmark(codes, chunk->samples, scale))
+            {
+                return 1;
+            }
+            continue;
+        }
+        if (chunk->samples == 0)
+        {
+            continue;
+        }
+
+        ConvertCodes(codes, values.data(), chunk->samples, scale);
+
+        min = max = values[0];
+        for (n = 0; n < chunk->samples; n++)
+        {
+            min = fminf(min, values[n]);
+            max = fmaxf(max, values[n]);
+            sum += values[n];
+        }
+        printf("chunk %u: %u samples, %s, mean %.6f, min %.6f, max %.6f\n", i, chunk->samples,
+               degrees ? "C" : "V", sum / chunk->samples, min, max);
+
+        if (outFile && (fwrite(values.data(), sizeof(float), chunk->samples, outFile) != chunk->samples))
+        {
+            fprintf(stderr, "%s: %s\n", outPath, strerror(errno));
+            return 1;
+        }
+    }
+
+    if (outFile && fclose(outFile))
+    {
+        fprintf(stderr, "%s: %s\n", outPath, strerror(errno));
+        return 1;
+    }
+    munmap((void *)map, st.st_size);
+    return 0;
+}
@@ -0,0 +1,100 @@
+/******************************************************************************
+ * i2c_dev.cpp - Linux /dev/i2c-N transport
+ *
+ * Haroldo Amaral
+ * https://github.com/agaelema/msp430f20x3_as_i2c_16bit_adc
+ ******************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include "i2c_dev.h"
+
+namespace sd16 {
+
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define     MAX_MSGS            (I2C_RDWR_IOCTL_MAX_MSGS)   // 42 - kernel limit per ioctl
+
+
+I2cDev::~I2cDev()
+{
+    close();
+}
+
+
+bool I2cDev::open(const char *device)
+{
+    unsigned long funcs;
+
+    close();
+    fd = ::open(device, O_RDWR);
+    if (fd < 0)
+    {
+        lastError = errno;
+        return false;
+    }
+    if ( (ioctl(fd, I2C_FUNCS, &funcs) < 0) || !(funcs & I2C_FUNC_I2C) )
+    {
+        lastError = EOPNOTSUPP;                 // no combined transfers
+        close();
+        return false;
+    }
+    return true;
+}
+
+
+void I2cDev::close()
+{
+    if (fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+
+bool I2cDev::transfer(Msg *msgs, size_t count)
+{
+    struct i2c_msg kernelMsgs[MAX_MSGS];
+    struct i2c_rdwr_ioctl_data rdwr;
+    size_t i;
+    int ret;
+
+    if ( (fd < 0) || (count == 0) || (count > MAX_MSGS) )
+    {
+        lastError = EINVAL;
+        return false;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        kernelMsgs[i].addr = msgs[i].address;
+        kernelMsgs[i].flags = msgs[i].read ? I2C_M_RD : 0;
+        kernelMsgs[i].len = msgs[i].length;
+        kernelMsgs[i].buf = msgs[i].data;
+    }
+    rdwr.msgs = kernelMsgs;
+    rdwr.nmsgs = count;
+
+    ret = ioctl(fd, I2C_RDWR, &rdwr);
+    if (ret < 0)
+    {
+        lastError = errno;                      // EREMOTEIO / ENXIO: Nack
+        return false;
+    }
+    if (ret != (int)count)                      // messages not all done - errno not set
+    {
+        lastError = EIO;
+        return false;
+    }
+    return true;
+}
+
+
+} // namespace sd16
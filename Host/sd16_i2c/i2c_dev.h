@@ -0,0 +1,40 @@
+/******************************************************************************
+ * i2c_dev.h - Linux /dev/i2c-N transport
+ * - each transfer() is one I2C_RDWR ioctl - repeated start between messages,
+ *   one system call and one stop per driver operation
+ * - needs an adapter with I2C_FUNC_I2C (not SMBus only)
+ *
+ * Haroldo Amaral
+ * https://github.com/agaelema/msp430f20x3_as_i2c_16bit_adc
+ ******************************************************************************/
+
+#ifndef I2C_DEV_H_
+#define I2C_DEV_H_
+
+#include "sd16_i2c.h"
+
+namespace sd16 {
+
+
+class I2cDev : public Transport
+{
+public:
+    I2cDev() {}
+    ~I2cDev();
+
+    bool open(const char *device);              // "/dev/i2c-1"
+    void close();
+    bool isOpen() const { return fd >= 0; }
+    int error() const { return lastError; }     // errno of the last failure
+
+    bool transfer(Msg *msgs, size_t count) override;
+
+private:
+    int     fd = -1;
+    int     lastError = 0;
+};
+
+
+} // namespace sd16
+
+#endif /* I2C_DEV_H_ */
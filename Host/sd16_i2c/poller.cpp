@@ -0,0 +1,316 @@
+/******************************************************************************
+ * poller.cpp - acquisition from many nodes on several buses
+ *
+ * Due time of a node, after a ready read at time t:
+ *   - not ready reads before it (edge found): ready = t, the period is
+ *     corrected from the previous edge (time / results between them),
+ *     due = t + period + margin
+ *   - ready at the first read: ready = due (result was there), due moves
+ *     one period minus a small creep, until a read is too early again
+ *   - SAMPLE_CNT gap (late, results lost): ready = t, and the creep is
+ *     doubled - node clock faster than the tracked period - until the
+ *     next edge
+ * Only edges are measured data ready times (within one retry), so the
+ * jitter statistics use the edge to edge interval per result - the other
+ * time stamps are estimates of the scheduler and would measure it
+ *
+ * Haroldo Amaral
+ * https://github.com/agaelema/msp430f20x3_as_i2c_16bit_adc
+ ******************************************************************************/
+
+#include <math.h>
+#include "poller.h"
+
+namespace sd16 {
+
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define     POLL_MARGIN_DIV     (64)            // due after an edge: period / 64 late
+#define     POLL_CREEP_DIV      (256)           // due earlier by period / 256 per ready read
+#define     POLL_CREEP_MAX_DIV  (16)            // doubled on each loss, up to period / 16
+#define     POLL_RETRY_DIV      (8)             // not ready: next read after period / 8
+#define     POLL_PERIOD_TRACK   (4)             // period correction filter, 1 / 4
+#define     POLL_PERIOD_LIMIT   (10)            // +-nominal / 10 - DCO range
+#define     POLL_START_RETRY_MS (100)           // configuration failed
+
+
+unsigned Poller::addBus(Transport &bus)
+{
+    buses.push_back(Bus{ &bus, {}, std::thread() });
+    return buses.size() - 1;
+}
+
+
+unsigned Poller::addNode(unsigned bus, uint8_t address, const Config &config, DrdyLine drdy)
+{
+    nodes.emplace_back(new NodeState(*buses[bus].transport, bus, address, config, drdy, ringSize));
+    nodes.back()->config.single = false;
+    buses[bus].nodes.push_back(nodes.back().get());
+    return nodes.size() - 1;
+}
+
+
+bool Poller::start()
+{
+    if ( running || nodes.empty() )
+    {
+        return false;
+    }
+    stopping = false;
+    for (Bus &bus : buses)
+    {
+        if ( !bus.nodes.empty() )
+        {
+            bus.worker = std::thread(&Poller::work, this, std::ref(bus));
+        }
+    }
+    running = true;
+    return true;
+}
+
+
+/*
+ * workers joined, then the conversions stopped from this thread
+ */
+void Poller::stop()
+{
+    if ( !running )
+    {
+        return;
+    }
+    stopping = true;
+    for (Bus &bus : buses)
+    {
+        if (bus.worker.joinable())
+        {
+            bus.worker.join();
+        }
+    }
+    for (std::unique_ptr<NodeState> &node : nodes)
+    {
+        if (node->started)
+        {
+            node->driver.stop();
+        }
+    }
+    running = false;
+}
+
+
+PollStats Poller::stats(unsigned node) const
+{
+    const NodeState &state = *nodes[node];
+    PollStats stats = state.stats;
+    double mean, elapsed;
+
+    stats.period = state.config.oversampling() / fm;
+    stats.measuredPeriod = std::chrono::duration<double>(state.period).count();
+    elapsed = std::chrono::duration<double>(state.lastTime - state.firstTime).count();
+    stats.rate = ((stats.samples > 1) && (elapsed > 0)) ? (stats.samples - 1) / elapsed : 0.0;
+
+    if (state.intervals > 1)
+    {
+        mean = state.intervalSum / state.intervals;
+        stats.jitterRms = sqrt(fmax(state.intervalSquares / state.intervals - mean * mean, 0.0));
+        stats.jitterPeak = fmax(state.intervalMax - mean, mean - state.intervalMin);
+    }
+    return stats;
+}
+
+
+/******************************************************************************
+ * Worker
+ ******************************************************************************/
+void Poller::work(Bus &bus)
+{
+    Clock::time_point now = Clock::now();
+
+    for (NodeState *node : bus.nodes)
+    {
+        startNode(*node, now);
+    }
+
+    while ( !stopping )
+    {
+        NodeState *next = bus.nodes[0];
+
+        for (NodeState *node : bus.nodes)           // earliest due - a few nodes per bus
+        {
+            if (node->due < next->due)
+            {
+                next = node;
+            }
+        }
+
+        now = Clock::now();
+        if (next->due > now)
+        {
+            std::this_thread::sleep_until(std::min(next->due,
+                                          now + std::chrono::nanoseconds(POLL_MAX_SLEEP_NS)));
+            continue;
+        }
+
+        if ( !next->started )
+        {
+            startNode(*next, now);
+        }
+        else
+        {
+            poll(*next);
+        }
+    }
+}
+
+
+/*
+ * continuous conversion - first result after the interrupt delay
+ */
+bool Poller::startNode(NodeState &node, Clock::time_point now)
+{
+    unsigned delay = 4 - ((uint8_t)node.config.delay >> 6);
+
+    node.nominal = std::chrono::duration_cast<Clock::duration>(
+                       std::chrono::duration<double>(node.config.oversampling() / fm));
+    node.period = node.nominal;
+    node.haveLast = false;
+    node.haveEdge = false;
+    node.creep = node.period / POLL_CREEP_DIV;
+    node.retried = false;
+
+    if ( !node.driver.configure(node.config, true) )
+    {
+        node.stats.errors++;
+        node.due = now + std::chrono::milliseconds(POLL_START_RETRY_MS);
+        return false;
+    }
+    node.started = true;
+    node.due = Clock::now() + node.period * delay;
+    return true;
+}
+
+
+void Poller::poll(NodeState &node)
+{
+    Clock::time_point now = Clock::now();
+    Clock::duration retry = std::max<Clock::duration>(node.period / POLL_RETRY_DIV,
+                                                      std::chrono::nanoseconds(POLL_MIN_RETRY_NS));
+    Clock::time_point ready;
+    Sample sample;
+    uint8_t step;
+
+    if ( node.drdy && !node.drdy() )                // line checked, no bus traffic
+    {
+        node.stats.notReady++;
+        node.retried = true;
+        node.due = now + retry;
+        return;
+    }
+
+    node.stats.reads++;
+    if ( !node.driver.read(sample) )                // node reset or bus error - configure again
+    {
+        node.stats.errors++;
+        node.started = false;
+        node.due = now + node.period;
+        return;
+    }
+    now = Clock::now();
+    if ( !sample.ready() )
+    {
+        node.stats.notReady++;
+        node.retried = true;
+        node.due = now + retry;
+        return;
+    }
+
+    step = sample.counter - node.counter;
+    if ( !node.haveLast )
+    {
+        step = 1;
+    }
+    node.index += step ? step : 256;
+
+    if (step != 1)                                  // late - results overwritten
+    {
+        node.stats.lost += step ? (step - 1) : 255;
+        node.creep = std::min(node.creep * 2, node.period / POLL_CREEP_MAX_DIV);
+        ready = now;
+    }
+    else if (node.retried)                          // edge within one retry
+    {
+        if (node.haveEdge)
+        {
+            Clock::duration measured = (now - node.lastEdge) / (node.index - node.edgeIndex);
+            double interval = std::chrono::duration<double>(measured).count();
+
+            if ( !node.intervals || (interval < node.intervalMin) )
+            {
+                node.intervalMin = interval;
+            }
+            if ( !node.intervals || (interval > node.intervalMax) )
+            {
+                node.intervalMax = interval;
+            }
+            node.intervalSum += interval;
+            node.intervalSquares += interval * interval;
+            node.intervals++;
+
+            node.period += (measured - node.period) / POLL_PERIOD_TRACK;
+            node.period = std::min(node.period, node.nominal + node.nominal / POLL_PERIOD_LIMIT);
+            node.period = std::max(node.period, node.nominal - node.nominal / POLL_PERIOD_LIMIT);
+        }
+        node.creep = node.period / POLL_CREEP_DIV;
+        node.haveEdge = true;
+        node.lastEdge = now;
+        node.edgeIndex = node.index;
+        ready = now;
+    }
+    else
+    {
+        ready = node.haveLast ? node.due : now;
+    }
+
+    push(node, sample, ready);
+
+    if (node.retried || (step != 1))
+    {
+        node.due = ready + node.period + node.period / POLL_MARGIN_DIV;
+    }
+    else
+    {
+        node.due = ready + node.period - node.creep;
+    }
+    node.retried = false;
+    node.haveLast = true;
+    node.counter = sample.counter;
+    node.lastReady = ready;
+}
+
+
+void Poller::push(NodeState &node, const Sample &sample, Clock::time_point ready)
+{
+    TimedSample *slot = node.ring.claim();
+
+    if ( !node.stats.samples )
+    {
+        node.firstTime = ready;
+    }
+    node.lastTime = ready;
+    node.stats.samples++;
+
+    if ( !slot )
+    {
+        node.stats.overruns++;
+        return;
+    }
+    slot->time = std::chrono::duration_cast<std::chrono::nanoseconds>(ready.time_since_epoch()).count();
+    slot->code = sample.code;
+    slot->counter = sample.counter;
+    slot->status = sample.status;
+    node.ring.publish();
+}
+
+
+} // namespace sd16
@@ -0,0 +1,152 @@
+/******************************************************************************
+ * poller.h - acquisition from many nodes on several buses
+ * - one worker thread per bus (Transport), nodes in continuous conversion
+ * - each node read when its next result is due: OSR period from the last
+ *   data ready, DRDY line if the caller has one, STATUS.DRDY otherwise
+ * - the due time tracks the node clock (DCO): it creeps earlier while the
+ *   result is found ready and is set from the first ready poll after a
+ *   not ready one
+ * - samples go to one SpscRing per node, read in place by the consumer
+ * - per node: achieved rate, lost results (SAMPLE_CNT gaps), jitter of the
+ *   measured data ready interval
+ *
+ * Haroldo Amaral
+ * https://github.com/agaelema/msp430f20x3_as_i2c_16bit_adc
+ ******************************************************************************/
+
+#ifndef POLLER_H_
+#define POLLER_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "sd16_i2c.h"
+#include "spsc_ring.h"
+
+namespace sd16 {
+
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define     POLL_FM_HZ          (1000000.0)     // modulator clock - SMCLK / 16
+#define     POLL_RING_SIZE      (4096)          // samples per node
+#define     POLL_MIN_RETRY_NS   (50000)         // not ready - next poll at least this later
+#define     POLL_MAX_SLEEP_NS   (10000000)      // stop() latency
+
+struct TimedSample
+{
+    uint64_t    time;                           // ns, steady clock - data ready estimate
+    uint16_t    code;
+    uint8_t     counter;                        // SAMPLE_CNT
+    uint8_t     status;
+};
+
+struct PollStats
+{
+    uint64_t    samples;                        // results read - overruns not in the ring
+    uint64_t    lost;                           // SAMPLE_CNT gaps
+    uint64_t    overruns;                       // ring full - sample dropped
+    uint64_t    reads;                          // result reads on the bus
+    uint64_t    notReady;                       // reads (or DRDY checks) too early
+    uint64_t    errors;                         // failed transfers
+    double      period;                         // nominal, s
+    double      measuredPeriod;                 // tracked from the data ready edges
+    double      rate;                           // achieved, samples/s
+    double      jitterRms;                      // deviation of the measured data ready interval
+    double      jitterPeak;                     // (edge to edge, per result), s
+};
+
+
+/******************************************************************************
+ * Poller
+ ******************************************************************************/
+class Poller
+{
+public:
+    typedef std::function<bool()> DrdyLine;         // true while a result is ready
+
+    explicit Poller(double fm = POLL_FM_HZ, size_t ringSize = POLL_RING_SIZE)
+        : fm(fm), ringSize(ringSize) {}
+    ~Poller() { stop(); }
+
+    /* before start() - the bus is used only by its worker */
+    unsigned addBus(Transport &bus);
+    /* config.single is ignored - continuous, started by the worker */
+    unsigned addNode(unsigned bus, uint8_t address, const Config &config, DrdyLine drdy = nullptr);
+
+    bool start();
+    void stop();
+
+    unsigned nodeCount() const { return nodes.size(); }
+    uint8_t nodeAddress(unsigned node) const { return nodes[node]->driver.address(); }
+    unsigned nodeBus(unsigned node) const { return nodes[node]->bus; }
+    /* consumer side - one consumer thread per ring */
+    SpscRing<TimedSample> &ring(unsigned node) { return nodes[node]->ring; }
+    /* after stop() */
+    PollStats stats(unsigned node) const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct NodeState
+    {
+        NodeState(Transport &transport, unsigned bus, uint8_t address, const Config &config,
+                  DrdyLine drdy, size_t ringSize)
+            : bus(bus), driver(transport, address), config(config), drdy(drdy), ring(ringSize) {}
+
+        unsigned                bus;
+        Node                    driver;
+        Config                  config;
+        DrdyLine                drdy;
+        SpscRing<TimedSample>   ring;
+
+        bool                    started = false;
+        Clock::duration         nominal{};          // OSR / fM
+        Clock::duration         period{};           // tracked - node clock
+        Clock::duration         creep{};            // due moved earlier per ready read
+        Clock::time_point       due;
+        Clock::time_point       lastReady;
+        bool                    retried = false;    // not ready since the last sample
+        bool                    haveLast = false;
+        uint8_t                 counter = 0;
+        uint64_t                index = 0;          // results since start, from SAMPLE_CNT
+        bool                    haveEdge = false;
+        Clock::time_point       lastEdge;           // ready found after a not ready read
+        uint64_t                edgeIndex = 0;
+
+        PollStats               stats = PollStats();
+        Clock::time_point       firstTime, lastTime;
+        double                  intervalSum = 0, intervalSquares = 0;           // measured, edge to edge
+        uint64_t                intervals = 0;
+        double                  intervalMin = 0, intervalMax = 0;
+    };
+
+    struct Bus
+    {
+        Transport               *transport;
+        std::vector<NodeState *> nodes;
+        std::thread             worker;
+    };
+
+    void work(Bus &bus);
+    bool startNode(NodeState &node, Clock::time_point now);
+    void poll(NodeState &node);
+    void push(NodeState &node, const Sample &sample, Clock::time_point ready);
+
+    double                  fm;
+    size_t                  ringSize;
+    std::vector<Bus>        buses;
+    std::vector<std::unique_ptr<NodeState>> nodes;
+    std::atomic<bool>       stopping{false};
+    bool                    running = false;
+};
+
+
+} // namespace sd16
+
+#endif /* POLLER_H_ */
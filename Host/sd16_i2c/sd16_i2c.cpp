@@ -0,0 +1,551 @@
+/******************************************************************************
+ * sd16_i2c.cpp - host driver of the MSP430F2013 I2C ADC
+ *
+ * Haroldo Amaral
+ * https://github.com/agaelema/msp430f20x3_as_i2c_16bit_adc
+ ******************************************************************************/
+
+#include <string.h>
+#include "sd16_i2c.h"
+
+namespace sd16 {
+
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define     MAX_WRITE           (32)                    // pointer + data, one message
+#define     PEC_MAX_MSGS        (4)
+#define     PEC_MAX_WIRE        (512)                   // all messages of a transfer with PEC bytes
+
+
+/******************************************************************************
+ * PEC
+ ******************************************************************************/
+static const uint8_t pecTable[256] =
+{
+    0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+    0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65, 0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D,
+    0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+    0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85, 0xA8, 0xAF, 0xA6, 0xA1, 0xB4, 0xB3, 0xBA, 0xBD,
+    0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2, 0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA,
+    0xB7, 0xB0, 0xB9, 0xBE, 0xAB, 0xAC, 0xA5, 0xA2, 0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+    0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32, 0x1F, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0D, 0x0A,
+    0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42, 0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A,
+    0x89, 0x8E, 0x87, 0x80, 0x95, 0x92, 0x9B, 0x9C, 0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+    0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC, 0xC1, 0xC6, 0xCF, 0xC8, 0xDD, 0xDA, 0xD3, 0xD4,
+    0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C, 0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44,
+    0x19, 0x1E, 0x17, 0x10, 0x05, 0x02, 0x0B, 0x0C, 0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+    0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B, 0x76, 0x71, 0x78, 0x7F, 0x6A, 0x6D, 0x64, 0x63,
+    0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B, 0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13,
+    0xAE, 0xA9, 0xA0, 0xA7, 0xB2, 0xB5, 0xBC, 0xBB, 0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+    0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB, 0xE6, 0xE1, 0xE8, 0xEF, 0xFA, 0xFD, 0xF4, 0xF3
+};
+
+
+uint8_t PecUpdate(uint8_t crc, uint8_t data)
+{
+    return pecTable[crc ^ data];
+}
+
+
+/******************************************************************************
+ * Config
+ ******************************************************************************/
+uint8_t Config::chctrlLow() const
+{
+    return (uint8_t)format;
+}
+
+
+uint8_t Config::chctrlHigh() const
+{
+    return (uint8_t)osr | (single ? SD16_SNG_CONV : SD16_CONT_CONV) | (unipolar ? SD16_UNIPOLAR : SD16_BIPOLAR);
+}
+
+
+uint8_t Config::inCtrl() const
+{
+    return (uint8_t)channel | (uint8_t)gain | (uint8_t)delay;
+}
+
+
+Config Config::decode(uint8_t chctrlLow, uint8_t chctrlHigh, uint8_t inCtrl)
+{
+    Config config;
+
+    config.format = (Format)(chctrlLow & SD16_DF_2S_COMP);
+    config.osr = (Osr)(chctrlHigh & (SD16_OSR_32x|SD16_OSR_1024x));
+    config.single = chctrlHigh & SD16_SNG_CONV;
+    config.unipolar = chctrlHigh & SD16_UNIPOLAR;
+    config.channel = (Channel)(inCtrl & 0x07);
+    config.gain = (Gain)(inCtrl & (0x07 << 3));
+    config.delay = (InterruptDelay)(inCtrl & SD16_INTDLY_1ST);
+
+    return config;
+}
+
+
+unsigned Config::oversampling() const
+{
+    switch (osr)
+    {
+    case Osr::x32:      return 32;
+    case Osr::x64:      return 64;
+    case Osr::x128:     return 128;
+    case Osr::x256:     return 256;
+    case Osr::x512:     return 512;
+    case Osr::x1024:    return 1024;
+    }
+    return 256;
+}
+
+
+unsigned Config::gainFactor() const
+{
+    return 1u << ((uint8_t)gain >> 3);
+}
+
+
+bool Config::operator==(const Config &other) const
+{
+    return (chctrlLow() == other.chctrlLow()) && (chctrlHigh() == other.chctrlHigh())
+        && (inCtrl() == other.inCtrl());
+}
+
+
+/******************************************************************************
+ * Node
+ ******************************************************************************/
+Node::Node(Transport &bus, uint8_t address) : bus(bus), nodeAddress(address)
+{
+}
+
+
+/*
+ * a Nack may come from a node that was reset - shadow no longer trusted
+ */
+bool Node::transfer(Msg *msgs, size_t count)
+{
+    if ( !(pecMode ? transferPec(msgs, count) : bus.transfer(msgs, count)) )
+    {
+        shadowValid = false;
+        counterValid = false;
+        return false;
+    }
+    return true;
+}
+
+
+/*
+ * one CRC over the transfer (restarted by the stop): address bytes, pointer,
+ * data and PEC bytes. The CRC is 0 after each correct PEC, so it is known
+ * at the start of every message before the transfer - written PECs are
+ * computed first, read PECs checked after
+ */
+bool Node::transferPec(Msg *msgs, size_t count)
+{
+    uint8_t wire[PEC_MAX_WIRE];
+    Msg framed[PEC_MAX_MSGS];
+    uint8_t readCrc[PEC_MAX_MSGS];
+    uint8_t group = (pecMode & SD16_I2C_PEC_WORD) ? 2 : 1;
+    uint8_t crc = 0;
+    size_t used = 0;
+    size_t i;
+    uint16_t n, out;
+
+    if (count > PEC_MAX_MSGS)
+    {
+        return false;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        framed[i] = msgs[i];
+        framed[i].data = &wire[used];
+        crc = PecUpdate(crc, (msgs[i].address << 1) | (msgs[i].read ? 1 : 0));
+
+        if (msgs[i].read)                           // whole groups, each one with its PEC
+        {
+            framed[i].length = (msgs[i].length + group - 1) / group * (group + 1);
+            readCrc[i] = crc;
+            crc = 0;
+        }
+        else                                        // [pointer] [data] [PEC] ...
+        {
+            framed[i].length = msgs[i].length ? (2 * msgs[i].length - 1) : 0;
+        }
+        if ( (used + framed[i].length) > sizeof(wire) )
+        {
+            return false;
+        }
+        used += framed[i].length;
+
+        if ( !msgs[i].read )
+        {
+            for (n = 0, out = 0; n < msgs[i].length; n++)
+            {
+                framed[i].data[out++] = msgs[i].data[n];
+                crc = PecUpdate(crc, msgs[i].data[n]);
+                if (n > 0)
+                {
+                    framed[i].data[out++] = crc;
+                    crc = 0;
+                }
+            }
+        }
+    }
+
+    if ( !bus.transfer(framed, count) )
+    {
+        return false;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        if ( !msgs[i].read )
+        {
+            continue;
+        }
+        crc = readCrc[i];
+        for (n = 0, out = 0; out < framed[i].length; out++)
+        {
+            if ( ((out + 1) % (group + 1)) == 0 )   // PEC of the group
+            {
+                if (framed[i].data[out] != crc)
+                {
+                    pecErrorCount++;
+                    return false;
+                }
+                crc = 0;
+                continue;
+            }
+            crc = PecUpdate(crc, framed[i].data[out]);
+            if (n < msgs[i].length)
+            {
+                msgs[i].data[n++] = framed[i].data[out];
+            }
+        }
+    }
+    return true;
+}
+
+
+/*
+ * registers that change what the shadow describes: the configuration
+ * itself, and controls that load their own SD16 settings - pacing (SNGL),
+ * sequencer (last slot IN_CTRL, OSR, SNGL), calibration (CH7 while
+ * measuring), drift (aux input) - and the legacy commands
+ */
+static bool ShadowWritten(uint8_t reg, uint8_t length)
+{
+    static const uint8_t controls[] = {
+        SD16_REG_PACE_CTRL, SD16_REG_CHCTRL_L, SD16_REG_CHCTRL_H, SD16_REG_IN_CTRL,
+        SD16_REG_SEQ_CTRL, SD16_REG_CAL_CTRL, SD16_REG_DRIFT_CTRL,
+    };
+
+    if ( (length > 0) && (reg & SD16_LEGACY_CMD) )
+    {
+        return true;
+    }
+    for (uint8_t control : controls)
+    {
+        if ( (control >= reg) && (control < (reg + length)) )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool Node::writeRegs(uint8_t reg, const uint8_t *data, uint8_t length)
+{
+    uint8_t buffer[MAX_WRITE];
+
+    if (length >= MAX_WRITE)
+    {
+        return false;
+    }
+    if ( ShadowWritten(reg, length) )
+    {
+        shadowValid = false;                        // next configure() reads back first
+    }
+    buffer[0] = reg;
+    memcpy(&buffer[1], data, length);
+
+    Msg msg = { nodeAddress, false, buffer, (uint16_t)(length + 1) };
+    return transfer(&msg, 1);
+}
+
+
+bool Node::readRegs(uint8_t reg, uint8_t *data, uint8_t length)
+{
+    Msg msgs[2] = {
+        { nodeAddress, false, &reg, 1 },
+        { nodeAddress, true, data, length },
+    };
+    return transfer(msgs, 2);
+}
+
+
+/*
+ * registers are consecutive (CHCTRL_L .. CONVERSION): write from the first
+ * one that differs - [CONVERSION] only when the configuration is unchanged
+ */
+bool Node::configure(const Config &config, bool start)
+{
+    const uint8_t wanted[3] = { config.chctrlLow(), config.chctrlHigh(), config.inCtrl() };
+    uint8_t buffer[5];
+    uint8_t first = 0;
+    uint8_t length = 0;
+    uint8_t i;
+
+    if ( !shadowValid )
+    {
+        return configureVerify(config, start);
+    }
+    while ( (first < sizeof(wanted)) && (wanted[first] == shadow[first]) )
+    {
+        first++;
+    }
+
+    buffer[length++] = SD16_REG_CHCTRL_L + first;
+    for (i = first; i < sizeof(wanted); i++)
+    {
+        buffer[length++] = wanted[i];
+    }
+    buffer[length++] = start ? SD16_START_CONVERSION : SD16_STOP_CONVERSION;
+
+    Msg msg = { nodeAddress, false, buffer, length };
+    if ( !transfer(&msg, 1) )
+    {
+        return false;
+    }
+    memcpy(shadow, wanted, sizeof(shadow));
+    return true;
+}
+
+
+/*
+ * write, repeated start, read - the read starts at the pointer written
+ * (CHCTRL_L), so the node returns what it applied
+ */
+bool Node::configureVerify(const Config &config, bool start, Config *readBack)
+{
+    uint8_t command[5] = { SD16_REG_CHCTRL_L, config.chctrlLow(), config.chctrlHigh(), config.inCtrl(),
+                           (uint8_t)(start ? SD16_START_CONVERSION : SD16_STOP_CONVERSION) };
+    uint8_t applied[4];
+    Msg msgs[2] = {
+        { nodeAddress, false, command, sizeof(command) },
+        { nodeAddress, true, applied, sizeof(applied) },
+    };
+
+    if ( !transfer(msgs, 2) )
+    {
+        return false;
+    }
+    memcpy(shadow, applied, sizeof(shadow));
+    shadowValid = true;
+
+    Config node = Config::decode(applied[0], applied[1], applied[2]);
+    if (readBack)
+    {
+        *readBack = node;
+    }
+    /* a single conversion may already be complete - START not checked */
+    return node == config;
+}
+
+
+bool Node::readConfig(Config &config, bool *running)
+{
+    uint8_t data[4];
+
+    if ( !readRegs(SD16_REG_CHCTRL_L, data, sizeof(data)) )
+    {
+        return false;
+    }
+    config = Config::decode(data[0], data[1], data[2]);
+    if (running)
+    {
+        *running = data[3] & SD16_START_CONVERSION;
+    }
+    return true;
+}
+
+
+bool Node::sync()
+{
+    if ( !readRegs(SD16_REG_CHCTRL_L, shadow, sizeof(shadow)) )
+    {
+        return false;
+    }
+    shadowValid = true;
+    return true;
+}
+
+
+bool Node::start()
+{
+    const uint8_t value = SD16_START_CONVERSION;
+
+    return writeRegs(SD16_REG_CONVERSION, &value, 1);
+}
+
+
+bool Node::stop()
+{
+    const uint8_t value = SD16_STOP_CONVERSION;
+
+    return writeRegs(SD16_REG_CONVERSION, &value, 1);
+}
+
+
+static void SampleDecode(const uint8_t *data, Sample &sample)
+{
+    sample.status = data[0];
+    sample.code = data[1] | (data[2] << 8);
+    sample.counter = data[3];
+}
+
+
+bool Node::read(Sample &sample)
+{
+    uint8_t data[4];
+
+    if ( !readRegs(SD16_REG_STATUS, data, sizeof(data)) )
+    {
+        return false;
+    }
+    SampleDecode(data, sample);
+
+    if (sample.ready())                             // reference for readAndStart()
+    {
+        lastCounter = sample.counter;
+        counterValid = true;
+    }
+    return true;
+}
+
+
+/*
+ * [STATUS] rs [read 4] rs [CONVERSION START] - STATUS clears DRDY, START
+ * clears it again, so the next DRDY is the new conversion
+ */
+bool Node::readAndStart(Sample &sample)
+{
+    uint8_t pointer = SD16_REG_STATUS;
+    uint8_t data[4];
+    uint8_t start[2] = { SD16_REG_CONVERSION, SD16_START_CONVERSION };
+    Msg msgs[3] = {
+        { nodeAddress, false, &pointer, 1 },
+        { nodeAddress, true, data, sizeof(data) },
+        { nodeAddress, false, start, sizeof(start) },
+    };
+
+    if ( !transfer(msgs, 3) )
+    {
+        return false;
+    }
+    SampleDecode(data, sample);
+
+    if (sample.ready())                             // one START, one result
+    {
+        if ( counterValid && (sample.counter != (uint8_t)(lastCounter + 1)) )
+        {
+            shadowValid = false;                    // counter restarted - reset or general call
+        }
+        lastCounter = sample.counter;
+        counterValid = true;
+    }
+    return true;
+}
+
+
+/*
+ * count first - a FIFO_DATA read past the queued samples returns dummy bytes
+ * that look like samples
+ */
+int Node::readFifo(uint16_t *codes, uint8_t maxCount, bool *overflow)
+{
+    uint8_t count;
+    uint8_t data[2 * 64];
+    uint8_t i;
+
+    if (pecMode & SD16_I2C_PEC_WORD)                // whole word - SAMPLE_CNT, FIFO_COUNT
+    {
+        if ( !readRegs(SD16_REG_SAMPLE_CNT, data, 2) )
+        {
+            return -1;
+        }
+        count = data[1];
+    }
+    else if ( !readRegs(SD16_REG_FIFO_COUNT, &count, 1) )
+    {
+        return -1;
+    }
+    if (overflow)
+    {
+        *overflow = count & SD16_FIFO_OVERFLOW;
+    }
+    count &= ~SD16_FIFO_OVERFLOW;
+    if (count > maxCount)
+    {
+        count = maxCount;
+    }
+    if (count > (sizeof(data) / 2))
+    {
+        count = sizeof(data) / 2;
+    }
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    if ( !readRegs(SD16_REG_FIFO_DATA, data, 2 * count) )
+    {
+        return -1;
+    }
+    for (i = 0; i < count; i++)
+    {
+        codes[i] = data[2*i] | (data[2*i + 1] << 8);
+    }
+    return count;
+}
+
+
+/*
+ * [I2C_CTRL] [value] rs [I2C_CTRL] - still in the current framing, the node
+ * changes it from the next transfer. A node without ENABLE_PEC drops the bits
+ */
+bool Node::setPec(bool enable, bool word)
+{
+    uint8_t ctrl;
+    uint8_t applied;
+
+    if ( !readRegs(SD16_REG_I2C_CTRL, &ctrl, 1) )
+    {
+        return false;
+    }
+
+    uint8_t command[2] = { SD16_REG_I2C_CTRL, (uint8_t)(ctrl & SD16_I2C_GCALL) };
+    Msg msgs[2] = {
+        { nodeAddress, false, command, sizeof(command) },
+        { nodeAddress, true, &applied, 1 },
+    };
+
+    if (enable)
+    {
+        command[1] |= SD16_I2C_PEC | (word ? SD16_I2C_PEC_WORD : 0);
+    }
+    if ( !transfer(msgs, 2) || ((applied & ~SD16_I2C_SAVE) != command[1]) )
+    {
+        return false;
+    }
+    pecMode = command[1] & (SD16_I2C_PEC|SD16_I2C_PEC_WORD);
+    return true;
+}
+
+
+} // namespace sd16
@@ -0,0 +1,205 @@
+/******************************************************************************
+ * sd16_i2c.h - host driver of the MSP430F2013 I2C ADC
+ * - typed configuration (channel, gain, OSR, format) built from sd16_header.h
+ * - each operation is one combined transfer: messages joined by repeated
+ *   start, one stop at the end - one I2C_RDWR ioctl on Linux
+ * - configuration shadow: only registers that differ from the last known
+ *   node configuration are written
+ * - bus access through Transport: Linux /dev/i2c-N (i2c_dev.h) or the
+ *   simulated node (sim_node.h)
+ * - optional SMBus PEC (firmware ENABLE_PEC): framing added and checked by
+ *   Node, the Transport sees plain messages
+ *
+ * Haroldo Amaral
+ * https://github.com/agaelema/msp430f20x3_as_i2c_16bit_adc
+ ******************************************************************************/
+
+#ifndef SD16_I2C_H_
+#define SD16_I2C_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sd16_header.h"
+
+namespace sd16 {
+
+
+/******************************************************************************
+ * Transport
+ ******************************************************************************/
+#define     SD16_SLAVE_ADDR     (0x0B)          // address after programming
+
+struct Msg
+{
+    uint8_t     address;                        // 7-bit slave address
+    bool        read;
+    uint8_t     *data;
+    uint16_t    length;
+};
+
+/*
+ * transfer() sends all messages in one transaction: start, message, repeated
+ * start, message ... stop. Returns false if any address or written byte is
+ * Nacked - the rest of the transaction is not sent.
+ */
+class Transport
+{
+public:
+    virtual ~Transport() {}
+    virtual bool transfer(Msg *msgs, size_t count) = 0;
+};
+
+
+/*
+ * SMBus PEC - CRC-8, polynomial 0x07, table driven as in the firmware
+ */
+uint8_t PecUpdate(uint8_t crc, uint8_t data);
+
+
+/******************************************************************************
+ * Configuration - CHCTRL_L, CHCTRL_H, IN_CTRL
+ ******************************************************************************/
+enum class Channel : uint8_t
+{
+    Ch0 = SD16_CH0, Ch1 = SD16_CH1, Ch2 = SD16_CH2, Ch3 = SD16_CH3, Ch4 = SD16_CH4,
+    Vcc = SD16_CH5_VCC_VSS, Temperature = SD16_CH6_Temperature, Short = SD16_CH7_ShortCircuit
+};
+
+enum class Gain : uint8_t
+{
+    x1 = SD16_GAIN1x, x2 = SD16_GAIN2x, x4 = SD16_GAIN4x,
+    x8 = SD16_GAIN8x, x16 = SD16_GAIN16x, x32 = SD16_GAIN32x
+};
+
+enum class Osr : uint8_t
+{
+    x32 = SD16_OSR_32x, x64 = SD16_OSR_64x, x128 = SD16_OSR_128x,
+    x256 = SD16_OSR_256x, x512 = SD16_OSR_512x, x1024 = SD16_OSR_1024x
+};
+
+enum class Format : uint8_t
+{
+    OffsetBinary = SD16_DF_OFFSET, TwosComplement = SD16_DF_2S_COMP
+};
+
+enum class InterruptDelay : uint8_t
+{
+    Fourth = SD16_INTDLY_4TH, Third = SD16_INTDLY_3RD,
+    Second = SD16_INTDLY_2ND, First = SD16_INTDLY_1ST
+};
+
+struct Config
+{
+    Channel         channel = Channel::Ch0;
+    Gain            gain = Gain::x1;
+    Osr             osr = Osr::x1024;
+    Format          format = Format::TwosComplement;
+    bool            unipolar = false;
+    bool            single = false;                 // single conversion per START
+    InterruptDelay  delay = InterruptDelay::Fourth;
+
+    uint8_t chctrlLow() const;
+    uint8_t chctrlHigh() const;
+    uint8_t inCtrl() const;
+    static Config decode(uint8_t chctrlLow, uint8_t chctrlHigh, uint8_t inCtrl);
+
+    unsigned oversampling() const;                  // 32 .. 1024
+    unsigned gainFactor() const;                    // 1 .. 32
+
+    bool operator==(const Config &other) const;
+    bool operator!=(const Config &other) const { return !(*this == other); }
+};
+
+
+/******************************************************************************
+ * Node
+ ******************************************************************************/
+/*
+ * STATUS, RESULT and SAMPLE_CNT - one snapshot, read together
+ */
+struct Sample
+{
+    uint8_t     status;
+    uint16_t    code;                           // raw result, in the configured format
+    uint8_t     counter;
+
+    bool ready() const { return status & SD16_STATUS_DRDY; }
+};
+
+/*
+ * Configuration shadow - CHCTRL_L, CHCTRL_H, IN_CTRL as last written or read
+ * - configure() writes from the first register that differs, or only
+ *   CONVERSION if none does
+ * - invalid after a failed transfer (Nack: node reset, bus error), a write
+ *   with writeRegs() to the configuration registers or to PACE_CTRL,
+ *   SEQ_CTRL, CAL_CTRL or DRIFT_CTRL (they load their own SD16 settings),
+ *   a legacy command, or a SAMPLE_CNT that does not follow the last one in
+ *   readAndStart() (node reset or general call) - the next configure()
+ *   writes all and reads back
+ * - call invalidate() if the node may have been reset in another way
+ *
+ * PEC - after setPec() every transfer carries a PEC after each written
+ * data byte and after each byte (or word) read, see sd16_header.h
+ * - a write the node rejects is Nacked: the transfer fails, nothing after
+ *   the bad byte is applied
+ * - a read with a wrong PEC fails and is counted in pecErrors(), the data
+ *   is not returned
+ * - word mode reads whole words: an odd length also reads the next register
+ */
+class Node
+{
+public:
+    Node(Transport &bus, uint8_t address = SD16_SLAVE_ADDR);
+
+    uint8_t address() const { return nodeAddress; }
+
+    /* register access - [pointer] [data] ... / [pointer] rs [read] ... */
+    bool writeRegs(uint8_t reg, const uint8_t *data, uint8_t length);
+    bool readRegs(uint8_t reg, uint8_t *data, uint8_t length);
+
+    /* [CHCTRL_L] [CHCTRL_H] [IN_CTRL] [CONVERSION] - registers equal to the shadow skipped */
+    bool configure(const Config &config, bool start);
+    /* all registers written and read back in the same transfer - shadow from read-back */
+    bool configureVerify(const Config &config, bool start, Config *readBack = nullptr);
+    bool readConfig(Config &config, bool *running = nullptr);
+
+    bool sync();                                    // shadow from read-back
+    void invalidate() { shadowValid = false; }
+    bool shadowed() const { return shadowValid; }
+
+    bool start();
+    bool stop();
+
+    /* [0x00] rs [STATUS] [RESULT_L] [RESULT_H] [SAMPLE_CNT] */
+    bool read(Sample &sample);
+    /* read() + START in one transfer - next single conversion runs while the host waits */
+    bool readAndStart(Sample &sample);
+
+    /* FIFO_COUNT + samples - returns samples read, -1 on error */
+    int readFifo(uint16_t *codes, uint8_t maxCount, bool *overflow = nullptr);
+
+    /* I2C_CTRL written and read back (general call kept) - false if the node has no ENABLE_PEC */
+    bool setPec(bool enable, bool word = false);
+    bool pec() const { return pecMode & SD16_I2C_PEC; }
+    uint32_t pecErrors() const { return pecErrorCount; }
+
+private:
+    bool transfer(Msg *msgs, size_t count);
+    bool transferPec(Msg *msgs, size_t count);
+
+    Transport   &bus;
+    uint8_t     nodeAddress;
+
+    uint8_t     shadow[3];                          // CHCTRL_L, CHCTRL_H, IN_CTRL
+    bool        shadowValid = false;
+    uint8_t     lastCounter = 0;
+    bool        counterValid = false;
+
+    uint8_t     pecMode = 0;                        // SD16_I2C_PEC + SD16_I2C_PEC_WORD
+    uint32_t    pecErrorCount = 0;
+};
+
+
+} // namespace sd16
+
+#endif /* SD16_I2C_H_ */
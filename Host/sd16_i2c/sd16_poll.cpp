@@ -0,0 +1,225 @@
+/******************************************************************************
+ * sd16_poll.cpp - continuous acquisition from nodes on several buses
+ * - one Poller worker per bus, samples read in place from the rings by
+ *   this thread (consumer)
+ * - at the end: per node achieved rate, lost results, reads per sample
+ *   and jitter of the measured data ready interval (edge to edge)
+ * - "sim BxN": B timed simulated buses with N nodes each, node clocks
+ *   spread by +-2 % (DCO), transfers held for their time at 400 kHz
+ *
+ * Build (from this folder):
+ *   g++ -std=c++17 -Wall -O2 -pthread -I../../MSP430/F2013_SD16_I2C-01 -o sd16_poll \
+ *       sd16_poll.cpp poller.cpp sd16_i2c.cpp i2c_dev.cpp sim_node.cpp
+ *
+ * Usage:
+ *   ./sd16_poll [-t seconds] [-o osr[,osr...]] [-a addr[,addr...]] /dev/i2c-1 [/dev/i2c-2 ...]
+ *   ./sd16_poll [-t seconds] [-o osr[,osr...]] sim 3x4
+ *
+ * Haroldo Amaral
+ * https://github.com/agaelema/msp430f20x3_as_i2c_16bit_adc
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <memory>
+#include <vector>
+#include "sd16_i2c.h"
+#include "i2c_dev.h"
+#include "sim_node.h"
+#include "poller.h"
+
+using namespace sd16;
+
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define     MAX_LIST            (16)
+#define     SIM_CLOCK_SPREAD    (0.01)          // per step, steps -2 .. +2
+#define     CONSUMER_SLEEP_US   (1000)
+
+
+static void Usage(void)
+{
+    fprintf(stderr, "usage: sd16_poll [-t seconds] [-o osr[,osr...]] [-a addr[,addr...]] <device> [device...]\n"
+                    "       sd16_poll [-t seconds] [-o osr[,osr...]] sim <buses>x<nodes>\n"
+                    "  -o  OSR of each node, repeated when there are more nodes\n"
+                    "  -a  node addresses, the same on every bus\n");
+    exit(2);
+}
+
+
+static unsigned ParseList(const char *text, unsigned *values)
+{
+    unsigned count = 0;
+    char *end;
+
+    do
+    {
+        values[count++] = strtoul(text, &end, 0);
+        text = end + 1;
+    } while ( (*end == ',') && (count < MAX_LIST) );
+    return count;
+}
+
+
+static bool ParseOsr(unsigned value, Osr &osr)
+{
+    const Osr osrs[] = { Osr::x32, Osr::x64, Osr::x128, Osr::x256, Osr::x512, Osr::x1024 };
+    unsigned i;
+
+    for (i = 0; i < 6; i++)
+    {
+        if (value == (32u << i))
+        {
+            osr = osrs[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+
+int main(int argc, char **argv)
+{
+    unsigned osrs[MAX_LIST] = { 1024 };
+    unsigned addresses[MAX_LIST] = { SD16_SLAVE_ADDR };
+    unsigned osrCount = 1, addressCount = 1;
+    double seconds = 5.0;
+    std::vector<std::unique_ptr<Transport>> buses;
+    std::vector<std::unique_ptr<SimNode>> simNodes;
+    std::vector<uint64_t> consumed, gaps;
+    std::vector<uint8_t> lastCounter;
+    Poller poller;
+    unsigned busCount = 0, nodesPerBus = 0;
+    unsigned i, n;
+    int opt;
+
+    while ( (opt = getopt(argc, argv, "t:o:a:")) != -1 )
+    {
+        switch (opt)
+        {
+        case 't':   seconds = strtod(optarg, nullptr);              break;
+        case 'o':   osrCount = ParseList(optarg, osrs);             break;
+        case 'a':   addressCount = ParseList(optarg, addresses);    break;
+        default:    Usage();
+        }
+    }
+    if (optind >= argc)
+    {
+        Usage();
+    }
+
+    if ( !strcmp(argv[optind], "sim") )
+    {
+        if ( (optind + 2 != argc) || (sscanf(argv[optind + 1], "%ux%u", &busCount, &nodesPerBus) != 2)
+             || !busCount || !nodesPerBus || (nodesPerBus > 0x77 - SD16_SLAVE_ADDR) )
+        {
+            Usage();
+        }
+        for (i = 0; i < busCount; i++)
+        {
+            TimedSimBus *bus = new TimedSimBus();
+
+            buses.emplace_back(bus);
+            for (n = 0; n < nodesPerBus; n++)
+            {
+                simNodes.emplace_back(new SimNode(SD16_SLAVE_ADDR + n));
+                bus->attach(*simNodes.back(), 1.0 + ((int)(simNodes.size() % 5) - 2) * SIM_CLOCK_SPREAD);
+            }
+        }
+        for (n = 0; n < nodesPerBus; n++)
+        {
+            addresses[n] = SD16_SLAVE_ADDR + n;
+        }
+        addressCount = nodesPerBus;
+    }
+    else
+    {
+        for (i = optind; i < (unsigned)argc; i++)
+        {
+            I2cDev *dev = new I2cDev();
+
+            buses.emplace_back(dev);
+            if ( !dev->open(argv[i]) )
+            {
+                fprintf(stderr, "%s: %s\n", argv[i], strerror(dev->error()));
+                return 1;
+            }
+        }
+    }
+
+    for (i = 0; i < buses.size(); i++)
+    {
+        unsigned bus = poller.addBus(*buses[i]);
+
+        for (n = 0; n < addressCount; n++)
+        {
+            Config config;
+
+            if ( !ParseOsr(osrs[poller.nodeCount() % osrCount], config.osr) )
+            {
+                Usage();
+            }
+            poller.addNode(bus, addresses[n], config);
+        }
+    }
+    consumed.assign(poller.nodeCount(), 0);
+    gaps.assign(poller.nodeCount(), 0);
+    lastCounter.assign(poller.nodeCount(), 0);
+
+    if ( !poller.start() )
+    {
+        return 1;
+    }
+
+    /*
+     * consumer - samples used in place, then released
+     */
+    for (double elapsed = 0; elapsed < seconds; elapsed += CONSUMER_SLEEP_US * 1e-6)
+    {
+        usleep(CONSUMER_SLEEP_US);
+        for (n = 0; n < poller.nodeCount(); n++)
+        {
+            SpscRing<TimedSample> &ring = poller.ring(n);
+            const TimedSample *samples;
+            size_t count;
+
+            while ( (count = ring.peek(&samples)) != 0 )
+            {
+                for (size_t k = 0; k < count; k++)
+                {
+                    if ( consumed[n] && ((uint8_t)(samples[k].counter - lastCounter[n]) != 1) )
+                    {
+                        gaps[n]++;
+                    }
+                    lastCounter[n] = samples[k].counter;
+                    consumed[n]++;
+                }
+                ring.release(count);
+            }
+        }
+    }
+    poller.stop();
+
+    printf("bus addr  OSR   nominal Hz    rate Hz  period us  lost  overrun  errors  reads/sample  jitter rms us  peak us\n");
+    for (n = 0; n < poller.nodeCount(); n++)
+    {
+        PollStats stats = poller.stats(n);
+
+        printf("%3u 0x%02X %4u %12.1f %10.1f %10.1f %5llu %8llu %7llu %13.2f %14.1f %8.1f\n",
+               poller.nodeBus(n), poller.nodeAddress(n), osrs[n % osrCount], 1.0 / stats.period,
+               stats.rate, stats.measuredPeriod * 1e6, (unsigned long long)stats.lost,
+               (unsigned long long)stats.overruns, (unsigned long long)stats.errors,
+               stats.samples ? (double)stats.reads / stats.samples : 0.0,
+               stats.jitterRms * 1e6, stats.jitterPeak * 1e6);
+        if (gaps[n] > stats.lost + stats.overruns)
+        {
+            printf("    consumer: %llu gaps in %llu samples\n", (unsigned long long)gaps[n],
+                   (unsigned long long)consumed[n]);
+        }
+    }
+    return 0;
+}
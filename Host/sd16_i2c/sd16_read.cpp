@@ -0,0 +1,297 @@
+/******************************************************************************
+ * sd16_read.cpp - read samples from an MSP430F2013 I2C ADC node
+ * - single conversions: one combined transfer per sample (read + next START)
+ * - continuous: one combined transfer per poll
+ * - channel scan (-c 0,1,2): single conversions, the channel is switched
+ *   with configure() - only IN_CTRL and START are sent (configuration shadow)
+ * - "sim" instead of a device runs against the in-process simulated node
+ *   and prints the bus cost per sample
+ * - -p / -P: SMBus PEC after each byte / word (firmware with ENABLE_PEC),
+ *   -e n (sim): one bit flipped every n bytes - failed transfers are
+ *   skipped, samples that do not match the simulated code are counted
+ *
+ * Build (from this folder):
+ *   g++ -std=c++17 -Wall -O2 -I../../MSP430/F2013_SD16_I2C-01 -o sd16_read \
+ *       sd16_read.cpp sd16_i2c.cpp i2c_dev.cpp sim_node.cpp
+ *
+ * Usage:
+ *   ./sd16_read [-a addr] [-n samples] [-c channel[,channel...]] [-g gain] [-o osr] [-C] [-p|-P] /dev/i2c-1
+ *   ./sd16_read sim
+ *   ./sd16_read -c 0,1,2 sim
+ *   ./sd16_read -n 1000 -e 97 [-p] sim
+ *
+ * Haroldo Amaral
+ * https://github.com/agaelema/msp430f20x3_as_i2c_16bit_adc
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include "sd16_i2c.h"
+#include "i2c_dev.h"
+#include "sim_node.h"
+
+using namespace sd16;
+
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define     FM_HZ               (1000000UL)     // modulator clock - SMCLK / 16
+#define     POLL_LIMIT          (100)
+#define     MAX_CHANNELS        (8)
+
+
+static void Usage(void)
+{
+    fprintf(stderr, "usage: sd16_read [-a addr] [-n samples] [-c 0-7[,0-7...]] [-g 1-32] [-o 32-1024] [-C] [-p|-P]\n"
+                    "                 [-e bytes] <device|sim>\n"
+                    "  -c  channel, or channels scanned with single conversions\n"
+                    "  -C  continuous conversion (default: single)\n"
+                    "  -p  PEC after each byte, -P after each word\n"
+                    "  -e  sim: one bit flipped every n bytes\n");
+    exit(2);
+}
+
+
+static unsigned ParseChannels(const char *text, Channel *channels)
+{
+    unsigned count = 0;
+    char *end;
+
+    do
+    {
+        channels[count++] = (Channel)(strtoul(text, &end, 0) & 0x07);
+        text = end + 1;
+    } while ( (*end == ',') && (count < MAX_CHANNELS) );
+
+    return count;
+}
+
+
+static bool ParseGain(unsigned value, Gain &gain)
+{
+    const Gain gains[] = { Gain::x1, Gain::x2, Gain::x4, Gain::x8, Gain::x16, Gain::x32 };
+    unsigned i;
+
+    for (i = 0; i < 6; i++)
+    {
+        if (value == (1u << i))
+        {
+            gain = gains[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+
+static bool ParseOsr(unsigned value, Osr &osr)
+{
+    const Osr osrs[] = { Osr::x32, Osr::x64, Osr::x128, Osr::x256, Osr::x512, Osr::x1024 };
+    unsigned i;
+
+    for (i = 0; i < 6; i++)
+    {
+        if (value == (32u << i))
+        {
+            osr = osrs[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+
+/*
+ * time to the first result of a conversion - 4 samples with the default
+ * interrupt delay
+ */
+static void WaitConversion(const Config &config)
+{
+    struct timespec delay;
+    unsigned long us = 4UL * config.oversampling() * 1000000UL / FM_HZ;
+
+    delay.tv_sec = us / 1000000UL;
+    delay.tv_nsec = (us % 1000000UL) * 1000UL;
+    nanosleep(&delay, nullptr);
+}
+
+
+int main(int argc, char **argv)
+{
+    unsigned address = SD16_SLAVE_ADDR;
+    unsigned samples = 10;
+    Config config;
+    I2cDev dev;
+    SimBus simBus;
+    SimNode simNode;
+    Transport *bus;
+    Channel channels[MAX_CHANNELS] = { Channel::Ch0 };
+    unsigned channelCount = 1;
+    unsigned bitErrors = 0;
+    unsigned failed = 0;
+    unsigned wrong = 0;
+    int pec = 0;                                    // 1: byte, 2: word
+    bool sim;
+    int opt;
+
+    config.single = true;
+    while ( (opt = getopt(argc, argv, "a:n:c:g:o:Cpe:P")) != -1 )
+    {
+        switch (opt)
+        {
+        case 'a':
+            address = strtoul(optarg, nullptr, 0);
+            break;
+        case 'n':
+            samples = strtoul(optarg, nullptr, 0);
+            break;
+        case 'c':
+            channelCount = ParseChannels(optarg, channels);
+            break;
+        case 'g':
+            if ( !ParseGain(strtoul(optarg, nullptr, 0), config.gain) )
+            {
+                Usage();
+            }
+            break;
+        case 'o':
+            if ( !ParseOsr(strtoul(optarg, nullptr, 0), config.osr) )
+            {
+                Usage();
+            }
+            break;
+        case 'C':
+            config.single = false;
+            break;
+        case 'p':
+            pec = 1;
+            break;
+        case 'P':
+            pec = 2;
+            break;
+        case 'e':
+            bitErrors = strtoul(optarg, nullptr, 0);
+            break;
+        default:
+            Usage();
+        }
+    }
+    if ( (optind != argc - 1) || ((channelCount > 1) && !config.single) )
+    {
+        Usage();
+    }
+    config.channel = channels[0];
+
+    sim = !strcmp(argv[optind], "sim");
+    if (sim)
+    {
+        simBus.attach(simNode);
+        address = simNode.address();
+        bus = &simBus;
+    }
+    else
+    {
+        if ( !dev.open(argv[optind]) )
+        {
+            fprintf(stderr, "%s: %s\n", argv[optind], strerror(dev.error()));
+            return 1;
+        }
+        bus = &dev;
+    }
+
+    Node node(*bus, address);
+    Config applied;
+
+    if ( pec && !node.setPec(true, pec == 2) )
+    {
+        fprintf(stderr, "node 0x%02X: no PEC (firmware without ENABLE_PEC?)\n", address);
+        return 1;
+    }
+    if ( !node.configureVerify(config, true, &applied) )
+    {
+        fprintf(stderr, "node 0x%02X: configuration %s\n", address,
+                (applied != config) ? "not applied" : "not acked");
+        return 1;
+    }
+    simBus.clearStats();
+    if (sim)
+    {
+        simBus.setBitErrors(bitErrors);
+    }
+
+    for (unsigned n = 0; n < samples; n++)
+    {
+        Sample sample;
+        unsigned polls = 0;
+        bool ok;
+
+        bool scan = (channelCount > 1);
+
+        if (scan && (n > 0))
+        {
+            config.channel = channels[n % channelCount];
+            if ( !node.configure(config, true) && !bitErrors )
+            {
+                fprintf(stderr, "node 0x%02X: configuration not acked\n", address);
+                return 1;
+            }
+        }
+
+        uint16_t expected = (uint16_t)(1000 * (uint8_t)config.channel + 10 * n);
+
+        if (sim)
+        {
+            simNode.convert(expected);
+        }
+        else
+        {
+            WaitConversion(config);
+        }
+
+        ok = (config.single && !scan) ? node.readAndStart(sample) : node.read(sample);
+        while (ok && !sample.ready() && (polls++ < POLL_LIMIT))
+        {
+            WaitConversion(config);                 // late - poll, then restart
+            ok = node.read(sample) && (!config.single || scan || !sample.ready() || node.start());
+        }
+        if ( (!ok || !sample.ready()) && bitErrors )
+        {
+            failed++;                               // sample lost - restart and go on
+            if (config.single)
+            {
+                node.start();
+            }
+            continue;
+        }
+        if ( !ok || !sample.ready() )
+        {
+            fprintf(stderr, "node 0x%02X: no result\n", address);
+            return 1;
+        }
+        if (sim && (sample.code != expected))
+        {
+            wrong++;                                // corrupted and not detected
+        }
+
+        printf("%u\t%u\t%u\t%d\n", n, (uint8_t)config.channel, sample.counter,
+               (config.format == Format::TwosComplement) ? (int16_t)sample.code : (int)sample.code);
+    }
+
+    if (sim)
+    {
+        const SimBus::Stats &stats = simBus.stats();
+
+        printf("# %u samples: %u transfers, %u messages, %u bytes, %u configuration bytes\n", samples,
+               stats.transfers, stats.messages, stats.bytes, simNode.configWrites());
+        if (bitErrors)
+        {
+            printf("# %u bit errors: %u samples lost, %u wrong samples accepted, PEC errors %u read / %u write\n",
+                   stats.bitErrors, failed, wrong, node.pecErrors(), simNode.pecErrors());
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,431 @@
+/******************************************************************************
+ * sim_node.cpp - in-process simulated node and bus
+ *
+ * Haroldo Amaral
+ * https://github.com/agaelema/msp430f20x3_as_i2c_16bit_adc
+ ******************************************************************************/
+
+#include <string.h>
+#include <thread>
+#include "sim_node.h"
+
+namespace sd16 {
+
+
+/******************************************************************************
+ * Definitions - as main.c
+ ******************************************************************************/
+#define     DUMMY_BYTE          (0xFF)
+#define     FIFO_COUNT_MASK     (0x7F)
+#define     CHCTRL_H_MASK       (0x1F)
+
+
+/******************************************************************************
+ * SimNode
+ ******************************************************************************/
+SimNode::SimNode(uint8_t address) : nodeAddress(address)
+{
+    reset();
+}
+
+
+void SimNode::reset()
+{
+    memset(regs, 0, sizeof(regs));
+    pointer = SD16_REG_RESULT_L;
+    cursor = pointer;
+    rxCount = 0;
+
+    chctrlLow = SD16_DF_2S_COMP;                    // as SD16_Config()
+    chctrlHigh = SD16_OSR_1024x|SD16_SNG_CONV;
+    inCtrl = SD16_CH1|SD16_GAIN1x;
+    converting = false;
+
+    status = 0;
+    counter = 0;
+    result = 0;
+    fifoHead = 0;
+    fifoCount = 0;
+    fifoHighByte = false;
+    fifoLatch = 0;
+    txStatus = 0;
+    txCounter = 0;
+    txResult = 0;
+    statusRead = false;
+    configWriteCount = 0;
+
+    pecCtrl = 0;
+    pecCrc = 0;
+    pecHeld = false;
+    pecData = 0;
+    pecTxCount = 0;
+    pecErrorCount = 0;
+}
+
+
+bool SimNode::convert(uint16_t code)
+{
+    uint8_t slot;
+
+    if ( !converting )
+    {
+        return false;
+    }
+    if (chctrlHigh & SD16_SNG_CONV)
+    {
+        converting = false;
+    }
+
+    result = code;
+    counter++;
+    status |= SD16_STATUS_DRDY;
+
+    if ( (fifoCount & FIFO_COUNT_MASK) < SD16_FIFO_DEPTH )
+    {
+        slot = (fifoHead + (fifoCount & FIFO_COUNT_MASK)) % SD16_FIFO_DEPTH;
+        fifo[2*slot] = code & 0xFF;
+        fifo[2*slot + 1] = code >> 8;
+        fifoCount++;
+    }
+    else
+    {
+        fifoCount |= SD16_FIFO_OVERFLOW;
+    }
+    return true;
+}
+
+
+void SimNode::busStart(bool read, bool repeated)
+{
+    if ( !repeated )                                // CRC and framing per transaction
+    {
+        pecCrc = 0;
+        pecCtrl = regs[SD16_REG_I2C_CTRL] & (SD16_I2C_PEC|SD16_I2C_PEC_WORD);
+    }
+    pecCrc = PecUpdate(pecCrc, (nodeAddress << 1) | (read ? 1 : 0));
+    pecHeld = false;
+    pecTxCount = 0;
+
+    cursor = pointer;
+    rxCount = 0;
+    statusRead = false;
+    fifoHighByte = false;
+
+    if (read)
+    {
+        txStatus = status;
+        txResult = result;
+        txCounter = counter;
+    }
+}
+
+
+/*
+ * with PEC each data byte is held until its PEC - the CRC including a
+ * correct PEC is 0
+ */
+bool SimNode::busWrite(uint8_t data)
+{
+    if (pecCtrl & SD16_I2C_PEC)
+    {
+        pecCrc = PecUpdate(pecCrc, data);
+        if (rxCount != 0)
+        {
+            if ( !pecHeld )
+            {
+                pecHeld = true;
+                pecData = data;
+                return true;
+            }
+            pecHeld = false;
+            if (pecCrc != 0)
+            {
+                pecErrorCount++;
+                return false;
+            }
+            data = pecData;
+        }
+    }
+
+    if (rxCount++ == 0)                             // pointer
+    {
+        if ( (data & SD16_LEGACY_CMD) || (data > SD16_REG_LAST) )
+        {
+            return false;
+        }
+        pointer = data;
+        cursor = data;
+        return true;
+    }
+    return regWrite(cursor++, data);
+}
+
+
+uint8_t SimNode::busRead()
+{
+    uint8_t value;
+
+    if ( (pecCtrl & SD16_I2C_PEC) && (pecTxCount == ((pecCtrl & SD16_I2C_PEC_WORD) ? 2 : 1)) )
+    {
+        pecTxCount = 0;                             // group complete - PEC
+        value = pecCrc;
+        pecCrc = 0;
+        return value;
+    }
+
+    value = regRead(cursor);
+    regCommit(cursor);
+    if ( (cursor != SD16_REG_FIFO_DATA) && (cursor != SD16_REG_FIFO_DELTA) )
+    {
+        cursor++;
+    }
+
+    pecCrc = PecUpdate(pecCrc, value);
+    pecTxCount++;
+    return value;
+}
+
+
+uint8_t SimNode::regRead(uint8_t reg)
+{
+    switch (reg)
+    {
+    case SD16_REG_STATUS:
+        return txStatus | (converting ? SD16_STATUS_BUSY : 0);
+    case SD16_REG_RESULT_L:
+        return txResult & 0xFF;
+    case SD16_REG_RESULT_H:
+        return txResult >> 8;
+    case SD16_REG_SAMPLE_CNT:
+        return txCounter;
+    case SD16_REG_FIFO_COUNT:
+        return fifoCount;
+    case SD16_REG_FIFO_DATA:
+        if (fifoHighByte)
+        {
+            return fifoLatch >> 8;
+        }
+        if (fifoCount & FIFO_COUNT_MASK)
+        {
+            fifoLatch = fifo[2*fifoHead] | (fifo[2*fifoHead + 1] << 8);
+            return fifoLatch & 0xFF;
+        }
+        return DUMMY_BYTE;
+    case SD16_REG_CHCTRL_L:
+        return chctrlLow;
+    case SD16_REG_CHCTRL_H:
+        return chctrlHigh;
+    case SD16_REG_IN_CTRL:
+        return inCtrl;
+    case SD16_REG_CONVERSION:
+        return converting ? SD16_START_CONVERSION : SD16_STOP_CONVERSION;
+    }
+    return (reg <= SD16_REG_LAST) ? regs[reg] : DUMMY_BYTE;
+}
+
+
+void SimNode::regCommit(uint8_t reg)
+{
+    switch (reg)
+    {
+    case SD16_REG_STATUS:
+        if ( (txStatus & SD16_STATUS_DRDY) && (txCounter == counter) )
+        {
+            status &= ~SD16_STATUS_DRDY;
+        }
+        statusRead = true;
+        break;
+
+    case SD16_REG_RESULT_L:
+        if ( !statusRead && (txCounter == counter) )
+        {
+            status &= ~SD16_STATUS_DRDY;
+        }
+        break;
+
+    case SD16_REG_FIFO_DATA:
+        if (fifoHighByte)                           // high byte sent - sample removed
+        {
+            fifoHead = (fifoHead + 1) % SD16_FIFO_DEPTH;
+            fifoCount--;
+            fifoHighByte = false;
+        }
+        else if (fifoCount & FIFO_COUNT_MASK)
+        {
+            fifoHighByte = true;
+        }
+        break;
+    }
+}
+
+
+bool SimNode::regWrite(uint8_t reg, uint8_t value)
+{
+    switch (reg)
+    {
+    case SD16_REG_CHCTRL_L:
+        chctrlLow = value & SD16_DF_2S_COMP;
+        configWriteCount++;
+        return true;
+
+    case SD16_REG_CHCTRL_H:
+        chctrlHigh = value & CHCTRL_H_MASK;
+        configWriteCount++;
+        return true;
+
+    case SD16_REG_IN_CTRL:
+        inCtrl = value;
+        configWriteCount++;
+        return true;
+
+    case SD16_REG_CONVERSION:
+        if (value & SD16_START_CONVERSION)
+        {
+            status &= ~SD16_STATUS_DRDY;
+            converting = true;
+        }
+        else
+        {
+            converting = false;
+        }
+        return true;
+
+    case SD16_REG_FIFO_CTRL:
+        if (value & SD16_FIFO_FLUSH)
+        {
+            fifoCount = 0;
+            fifoHighByte = false;
+        }
+        return true;
+
+    case SD16_REG_I2C_CTRL:                         // framing from the next transaction
+        regs[reg] = value & (SD16_I2C_GCALL|SD16_I2C_PEC|SD16_I2C_PEC_WORD);
+        return true;
+    }
+
+    /* read-only registers */
+    if ( (reg < SD16_REG_PACE_PERIOD) || (reg == SD16_REG_LATENCY) || (reg == SD16_REG_LATENCY + 1)
+      || ((reg >= SD16_REG_SEQ_RESULT) && (reg < SD16_REG_CAL)) || (reg > SD16_REG_LAST) )
+    {
+        return false;
+    }
+    regs[reg] = value;
+    return true;
+}
+
+
+/******************************************************************************
+ * SimBus
+ ******************************************************************************/
+uint8_t SimBus::corrupt()
+{
+    if ( (errorInterval == 0) || (--errorCountdown != 0) )
+    {
+        return 0x00;
+    }
+    errorCountdown = errorInterval;
+    busStats.bitErrors++;
+    return 0x10;
+}
+
+
+bool SimBus::transfer(Msg *msgs, size_t count)
+{
+    SimNode *node;
+    size_t i;
+    uint16_t n;
+
+    busStats.transfers++;
+
+    for (i = 0; i < count; i++)
+    {
+        busStats.messages++;
+        busStats.bytes++;
+
+        node = nullptr;
+        for (SimNode *candidate : nodes)
+        {
+            if (candidate->address() == msgs[i].address)
+            {
+                node = candidate;
+            }
+        }
+        if ( !node )
+        {
+            return false;                           // address Nack - stop
+        }
+
+        node->busStart(msgs[i].read, i > 0);
+        for (n = 0; n < msgs[i].length; n++)
+        {
+            busStats.bytes++;
+            if (msgs[i].read)
+            {
+                msgs[i].data[n] = node->busRead() ^ corrupt();
+            }
+            else if ( !node->busWrite(msgs[i].data[n] ^ corrupt()) )
+            {
+                return false;                       // data Nack - stop
+            }
+        }
+    }
+    return true;
+}
+
+
+/******************************************************************************
+ * TimedSimBus
+ ******************************************************************************/
+void TimedSimBus::attach(SimNode &node, double clockScale)
+{
+    SimBus::attach(node);
+    timing.push_back(Timing{ Clock::now(), clockScale, 0 });
+}
+
+
+/*
+ * conversions due since the last transfer - a stopped node starts one
+ * period after it is found running
+ */
+void TimedSimBus::advance()
+{
+    Clock::time_point now = Clock::now();
+    size_t i;
+
+    for (i = 0; i < nodes.size(); i++)
+    {
+        Timing &node = timing[i];
+        std::chrono::nanoseconds period((long long)(nodes[i]->config().oversampling() * 1e9 / fm
+                                                    * node.clockScale));
+
+        while (node.next <= now)
+        {
+            if ( !nodes[i]->running() )
+            {
+                node.next = now + period;
+                break;
+            }
+            nodes[i]->convert(node.code++);
+            node.next += period;
+        }
+    }
+}
+
+
+bool TimedSimBus::transfer(Msg *msgs, size_t count)
+{
+    uint32_t bytes = busStats.bytes;
+    bool acked;
+
+    advance();
+    acked = SimBus::transfer(msgs, count);
+    if (bitRate > 0)                                // 9 clocks per byte, start and stop
+    {
+        bytes = busStats.bytes - bytes;
+        std::this_thread::sleep_for(std::chrono::nanoseconds((long long)((bytes * 9 + 2) * 1e9 / bitRate)));
+    }
+    return acked;
+}
+
+
+} // namespace sd16
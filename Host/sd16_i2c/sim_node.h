@@ -0,0 +1,140 @@
+/******************************************************************************
+ * sim_node.h - in-process simulated node and bus
+ * - register level model of the firmware protocol: pointer, auto-increment,
+ *   snapshot of STATUS/RESULT/SAMPLE_CNT, DRDY clear on read, FIFO, Nack of
+ *   invalid pointers and read-only registers
+ * - conversions are pushed by the test with convert() - no timing
+ * - SimBus counts transfers, messages and bytes, to compare driver costs
+ * - TimedSimBus runs the conversions on the real clock, one per OSR period
+ *   of each node configuration, and holds each transfer for its time on
+ *   the bus - for the poller (poller.h)
+ * - SMBus PEC modeled as the firmware with ENABLE_PEC (I2C_CTRL), SimBus
+ *   can flip one bit every n data bytes to check that errors are caught
+ * - legacy commands and other firmware options are not modeled (option
+ *   registers are plain storage)
+ *
+ * Haroldo Amaral
+ * https://github.com/agaelema/msp430f20x3_as_i2c_16bit_adc
+ ******************************************************************************/
+
+#ifndef SIM_NODE_H_
+#define SIM_NODE_H_
+
+#include <chrono>
+#include <vector>
+#include "sd16_i2c.h"
+
+namespace sd16 {
+
+
+class SimNode
+{
+public:
+    explicit SimNode(uint8_t address = SD16_SLAVE_ADDR);
+
+    uint8_t address() const { return nodeAddress; }
+    void reset();                                   // power-on state
+    bool convert(uint16_t code);                    // false if the converter is stopped
+
+    bool running() const { return converting; }
+    Config config() const { return Config::decode(chctrlLow, chctrlHigh, inCtrl); }
+    uint32_t configWrites() const { return configWriteCount; }
+    uint32_t pecErrors() const { return pecErrorCount; }    // written bytes rejected
+
+    /* bus side - called by SimBus, repeated: no stop since the last start */
+    void busStart(bool read, bool repeated);
+    bool busWrite(uint8_t data);                    // true if Ack
+    uint8_t busRead();
+
+private:
+    uint8_t regRead(uint8_t reg);
+    void regCommit(uint8_t reg);
+    bool regWrite(uint8_t reg, uint8_t value);
+
+    uint8_t     nodeAddress;
+    uint8_t     regs[SD16_REG_LAST + 1];            // registers without behavior
+    uint8_t     pointer, cursor, rxCount;
+
+    uint8_t     chctrlLow, chctrlHigh, inCtrl;
+    bool        converting;
+    uint8_t     status, counter;
+    uint16_t    result;
+    uint8_t     fifo[SD16_FIFO_DEPTH * 2];
+    uint8_t     fifoHead, fifoCount;                // count + overflow flag, as FIFO_COUNT
+    bool        fifoHighByte;
+    uint16_t    fifoLatch;
+
+    uint8_t     txStatus, txCounter;
+    uint16_t    txResult;
+    bool        statusRead;
+    uint32_t    configWriteCount;
+
+    uint8_t     pecCtrl;                            // SD16_I2C_PEC / _WORD of the transaction
+    uint8_t     pecCrc;
+    bool        pecHeld;                            // data byte waiting for its PEC
+    uint8_t     pecData;
+    uint8_t     pecTxCount;                         // bytes sent in the current group
+    uint32_t    pecErrorCount;
+};
+
+
+class SimBus : public Transport
+{
+public:
+    struct Stats
+    {
+        uint32_t    transfers;                      // start ... stop - ioctl calls
+        uint32_t    messages;                       // start + address
+        uint32_t    bytes;                          // address and data bytes
+        uint32_t    bitErrors;                      // data bytes corrupted
+    };
+
+    void attach(SimNode &node) { nodes.push_back(&node); }
+    bool transfer(Msg *msgs, size_t count) override;
+
+    /* one bit flipped every interval data bytes, either direction - 0 for none */
+    void setBitErrors(uint32_t interval) { errorInterval = interval; errorCountdown = interval; }
+
+    const Stats &stats() const { return busStats; }
+    void clearStats() { busStats = Stats(); }
+
+protected:
+    std::vector<SimNode *>  nodes;
+    Stats                   busStats = Stats();
+    uint32_t                errorInterval = 0;
+    uint32_t                errorCountdown = 0;
+
+    uint8_t corrupt();                              // XOR mask of the next data byte
+};
+
+
+class TimedSimBus : public SimBus
+{
+public:
+    /* fm: modulator clock, bitRate: SCL - 0 for no bus time */
+    explicit TimedSimBus(double fm = 1000000.0, double bitRate = 400000.0) : fm(fm), bitRate(bitRate) {}
+
+    /* clockScale: node clock error, 1.01 = conversions 1 % slower (DCO) */
+    void attach(SimNode &node, double clockScale = 1.0);
+    bool transfer(Msg *msgs, size_t count) override;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Timing
+    {
+        Clock::time_point   next;                   // next conversion
+        double              clockScale;
+        uint16_t            code;
+    };
+
+    void advance();
+
+    double                  fm, bitRate;
+    std::vector<Timing>     timing;                 // same order as nodes
+};
+
+
+} // namespace sd16
+
+#endif /* SIM_NODE_H_ */
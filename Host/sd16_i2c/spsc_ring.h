@@ -0,0 +1,94 @@
+/******************************************************************************
+ * spsc_ring.h - lock-free single producer / single consumer ring
+ * - one thread writes, one thread reads, no locks, no system calls
+ * - samples are written and read in place: the producer fills the slot
+ *   returned by claim() and publishes it, the consumer gets a contiguous
+ *   run of slots with peek() and gives them back with release()
+ * - capacity rounded up to a power of 2, indices run free (modulo 2^N)
+ *
+ * Haroldo Amaral
+ * https://github.com/agaelema/msp430f20x3_as_i2c_16bit_adc
+ ******************************************************************************/
+
+#ifndef SPSC_RING_H_
+#define SPSC_RING_H_
+
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+namespace sd16 {
+
+
+template <typename T>
+class SpscRing
+{
+public:
+    explicit SpscRing(size_t capacity) : slots(RoundUp(capacity)), mask(slots.size() - 1) {}
+
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    size_t capacity() const { return slots.size(); }
+    size_t size() const                             // tail first - head never behind it
+    {
+        size_t position = tail.load(std::memory_order_acquire);
+
+        return head.load(std::memory_order_acquire) - position;
+    }
+
+    /* producer - free slot or nullptr if full, visible after publish() */
+    T *claim()
+    {
+        size_t position = head.load(std::memory_order_relaxed);
+
+        if ( (position - tail.load(std::memory_order_acquire)) == slots.size() )
+        {
+            return nullptr;
+        }
+        return &slots[position & mask];
+    }
+
+    void publish()
+    {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /* consumer - oldest published slots, contiguous (up to the end of the buffer) */
+    size_t peek(const T **first) const
+    {
+        size_t position = tail.load(std::memory_order_relaxed);
+        size_t count = head.load(std::memory_order_acquire) - position;
+        size_t toEnd = slots.size() - (position & mask);
+
+        *first = &slots[position & mask];
+        return (count < toEnd) ? count : toEnd;
+    }
+
+    void release(size_t count)
+    {
+        tail.store(tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+private:
+    static size_t RoundUp(size_t value)
+    {
+        size_t size = 1;
+
+        while (size < value)
+        {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    std::vector<T>          slots;
+    const size_t            mask;
+    alignas(64) std::atomic<size_t> head{0};       // written by the producer
+    alignas(64) std::atomic<size_t> tail{0};       // written by the consumer
+};
+
+
+} // namespace sd16
+
+#endif /* SPSC_RING_H_ */
@@ -0,0 +1,260 @@
+/******************************************************************************
+ * sd16_bench.cpp - noise and speed of each SD16_A setting, from the model
+ * - for every OSR x gain: output data rate, time to the first result
+ *   after a start (single conversion), and with the model:
+ *   - DC input: rms and peak to peak noise (codes and uV input referred),
+ *     noise free bits
+ *   - sine input (coherent, fitted): SINAD and ENOB, full scale referred
+ * - -b / -e: fastest setting within a noise budget (uVrms) or a minimum
+ *   ENOB - the CHCTRL_H / IN_CTRL values are printed for the firmware
+ *
+ * Build (from this folder):
+ *   g++ -std=c++17 -Wall -O2 -I../../MSP430/F2013_SD16_I2C-01 -o sd16_bench \
+ *       sd16_bench.cpp sd16_model.cpp
+ *
+ * Usage:
+ *   ./sd16_bench [-o osr[,osr...]] [-g gain[,gain...]] [-n results] [-d nV/sqrt(Hz)]
+ *                [-a sine dBFS] [-v dc V] [-f fM Hz] [-b uVrms] [-e bits]
+ *
+ * Haroldo Amaral
+ * https://github.com/agaelema/msp430f20x3_as_i2c_16bit_adc
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "sd16_model.h"
+
+using namespace sd16;
+
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define     SINE_CYCLES         (7)             // per test - odd, coherent
+#define     MIN_RESULTS         (64)
+#define     MAX_SETTINGS        (8)
+
+struct Result
+{
+    ModelConfig config;
+    double      noiseCodes;                     // rms, DC input
+    double      noiseUv;                        // rms, input referred
+    int         peakToPeak;                     // codes
+    double      sinad;                          // dB
+    double      enob;                           // full scale referred
+};
+
+static const unsigned osrList[] = { 32, 64, 128, 256, 512, 1024 };
+static const uint8_t osrBits[] = { SD16_OSR_32x, SD16_OSR_64x, SD16_OSR_128x,
+                                   SD16_OSR_256x, SD16_OSR_512x, SD16_OSR_1024x };
+
+
+static unsigned ParseList(const char *text, unsigned *values)
+{
+    unsigned count = 0;
+    char *end;
+
+    do
+    {
+        values[count++] = strtoul(text, &end, 0);
+        text = end + 1;
+    } while ( (*end == ',') && (count < MAX_SETTINGS) );
+    return count;
+}
+
+
+static bool ValidSetting(unsigned osr, unsigned gain)
+{
+    return (osr >= 32) && (osr <= 1024) && !(osr & (osr - 1))
+        && (gain >= 1) && (gain <= 32) && !(gain & (gain - 1));
+}
+
+
+/*
+ * DC input held - noise of the results
+ */
+static void TestDc(Result &result, double dc, unsigned count)
+{
+    Sd16Model model(result.config);
+    double sum = 0, sumSquares = 0;
+    int min = INT16_MAX, max = INT16_MIN;
+    unsigned i;
+
+    for (i = 0; i < count; i++)
+    {
+        int code = model.convert(dc);
+
+        sum += code;
+        sumSquares += (double)code * code;
+        min = (code < min) ? code : min;
+        max = (code > max) ? code : max;
+    }
+    sum /= count;
+    result.noiseCodes = sqrt(fmax(sumSquares / count - sum * sum, 0.0));
+    result.noiseUv = result.noiseCodes * result.config.vfsr() / 32768.0 * 1e6;
+    result.peakToPeak = max - min;
+}
+
+
+/*
+ * sine with SINE_CYCLES periods in count results - sin, cos and DC are
+ * orthogonal over the record, the fit is three projections
+ */
+static void TestSine(Result &result, double dbfs, unsigned count)
+{
+    const ModelConfig &config = result.config;
+    Sd16Model model(config, 2);
+    std::vector<double> codes(count);
+    double amplitude = config.vfsr() * pow(10.0, dbfs / 20.0);
+    double w = 2.0 * M_PI * SINE_CYCLES / count;    // per result
+    double wClock = w / config.osr;                 // per modulator clock
+    double s = 0, c = 0, dc = 0, residual = 0;
+    unsigned i;
+
+    for (i = 0; i < count; i++)                     // sine from the start - first result settled
+    {
+        int16_t code;
+
+        while (!model.clock(amplitude * sin(wClock * model.clocks()), code))
+        {
+        }
+        codes[i] = code;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        s += codes[i] * sin(w * i);
+        c += codes[i] * cos(w * i);
+        dc += codes[i];
+    }
+    s *= 2.0 / count;
+    c *= 2.0 / count;
+    dc /= count;
+    for (i = 0; i < count; i++)
+    {
+        double error = codes[i] - (s * sin(w * i) + c * cos(w * i) + dc);
+
+        residual += error * error;
+    }
+    residual = sqrt(residual / count);
+    if (residual < 1e-3)
+    {
+        residual = 1e-3;
+    }
+    result.sinad = 20.0 * log10(sqrt((s * s + c * c) / 2.0) / residual);
+    result.enob = (20.0 * log10(32768.0 / sqrt(2.0) / residual) - 1.76) / 6.02;
+}
+
+
+static void Usage(void)
+{
+    fprintf(stderr, "usage: sd16_bench [-o osr[,osr...]] [-g gain[,gain...]] [-n results] [-d nV/sqrt(Hz)]\n"
+                    "                  [-a sine dBFS] [-v dc V] [-f fM Hz] [-b uVrms] [-e bits]\n"
+                    "  -b  fastest setting with noise <= uVrms (input referred)\n"
+                    "  -e  fastest setting with ENOB >= bits\n");
+    exit(2);
+}
+
+
+int main(int argc, char **argv)
+{
+    unsigned osrs[MAX_SETTINGS] = { 32, 64, 128, 256, 512, 1024 };
+    unsigned gains[MAX_SETTINGS] = { 1, 2, 4, 8, 16, 32 };
+    unsigned osrCount = 6, gainCount = 6;
+    unsigned count = 1024;
+    double dbfs = -6.0, dc = 0.0;
+    double budget = 0, minEnob = 0;
+    ModelConfig base;
+    std::vector<Result> results;
+    const Result *best = nullptr;
+    clock_t elapsed;
+    unsigned i, j;
+    int opt;
+
+    while ( (opt = getopt(argc, argv, "o:g:n:d:a:v:f:b:e:")) != -1 )
+    {
+        switch (opt)
+        {
+        case 'o':   osrCount = ParseList(optarg, osrs);             break;
+        case 'g':   gainCount = ParseList(optarg, gains);           break;
+        case 'n':   count = strtoul(optarg, nullptr, 0);            break;
+        case 'd':   base.noiseDensity = strtod(optarg, nullptr) * 1e-9; break;
+        case 'a':   dbfs = strtod(optarg, nullptr);                 break;
+        case 'v':   dc = strtod(optarg, nullptr);                   break;
+        case 'f':   base.smclk = strtod(optarg, nullptr);
+                    base.div = base.xdiv = 1;                       break;
+        case 'b':   budget = strtod(optarg, nullptr);               break;
+        case 'e':   minEnob = strtod(optarg, nullptr);              break;
+        default:    Usage();
+        }
+    }
+    if ( (optind != argc) || (count < MIN_RESULTS) || (dbfs > 0.0) || !(base.fm() > 0.0) )
+    {
+        Usage();
+    }
+
+    printf("fM %.0f Hz, noise %.0f nV/sqrt(Hz), %u results per test, sine %.1f dBFS, DC %.6f V\n\n",
+           base.fm(), base.noiseDensity * 1e9, count, dbfs, dc);
+    printf(" OSR gain   rate Hz  first ms  noise uV  rms code  p-p  NF bits  SINAD dB  ENOB\n");
+
+    elapsed = clock();
+    for (i = 0; i < osrCount; i++)
+    {
+        for (j = 0; j < gainCount; j++)
+        {
+            Result result;
+
+            if ( !ValidSetting(osrs[i], gains[j]) )
+            {
+                fprintf(stderr, "OSR %u gain %u: not a SD16_A setting\n", osrs[i], gains[j]);
+                return 2;
+            }
+            result.config = base;
+            result.config.osr = osrs[i];
+            result.config.gain = gains[j];
+            TestDc(result, dc, count);
+            TestSine(result, dbfs, count);
+            results.push_back(result);
+
+            printf("%4u %4u %9.1f %9.3f %9.2f %9.2f %4d %8.1f %9.1f %5.1f\n", osrs[i], gains[j],
+                   result.config.outputRate(), result.config.latency() * 1e3, result.noiseUv,
+                   result.noiseCodes, result.peakToPeak, log2(65536.0 / (result.peakToPeak + 1)),
+                   result.sinad, result.enob);
+        }
+    }
+    elapsed = clock() - elapsed;
+    printf("\nmodel: %.1f s\n", (double)elapsed / CLOCKS_PER_SEC);
+
+    if ( (budget <= 0.0) && (minEnob <= 0.0) )
+    {
+        return 0;
+    }
+    for (const Result &result : results)
+    {
+        if ( ((budget > 0.0) && (result.noiseUv > budget)) || (result.enob < minEnob) )
+        {
+            continue;
+        }
+        if ( !best || (result.config.outputRate() > best->config.outputRate())
+             || ((result.config.outputRate() == best->config.outputRate()) && (result.noiseUv < best->noiseUv)) )
+        {
+            best = &result;
+        }
+    }
+    if (!best)
+    {
+        printf("no setting within the budget\n");
+        return 1;
+    }
+    for (i = 0; (i < 6) && (osrList[i] != best->config.osr); i++)
+    {
+    }
+    printf("fastest: OSR %u gain %u, %.1f Hz - CHCTRL_H 0x%02X, IN_CTRL gain bits 0x%02X\n",
+           best->config.osr, best->config.gain, best->config.outputRate(), osrBits[i],
+           (unsigned)(log2(best->config.gain)) << 3);
+    return 0;
+}
@@ -0,0 +1,134 @@
+/******************************************************************************
+ * sd16_model.cpp - behavioral model of the MSP430F2013 SD16_A converter
+ *
+ * Modulator - 2nd order, delaying integrators (Boser-Wooley), 1 bit:
+ *   u = (vin + offset + noise) * gain / VREF      +-0.5 at full scale
+ *   v = sign(int2)
+ *   int2 += (int1 - v) / 2,  int1 += (u - v) / 2
+ *   mean(v) = u, quantization noise shaped by (1 - z^-1)^2
+ * Decimator - sinc3, integrators at fM and combs at fM / OSR:
+ *   output +-OSR^3 for v = +-1, result = output * 65536 / OSR^3 saturated,
+ *   so +-VFSR gives +-32768 - at OSR 32 the lowest bit is always 0
+ *
+ * Haroldo Amaral
+ * https://github.com/agaelema/msp430f20x3_as_i2c_16bit_adc
+ ******************************************************************************/
+
+#include <math.h>
+#include "sd16_model.h"
+
+namespace sd16 {
+
+
+ModelConfig ModelConfig::fromRegisters(uint8_t chctrlHigh, uint8_t inCtrl)
+{
+    ModelConfig config;
+
+    switch (chctrlHigh & (SD16_OSR_32x|SD16_OSR_1024x))
+    {
+    case SD16_OSR_32x:      config.osr = 32;    break;
+    case SD16_OSR_64x:      config.osr = 64;    break;
+    case SD16_OSR_128x:     config.osr = 128;   break;
+    case SD16_OSR_512x:     config.osr = 512;   break;
+    case SD16_OSR_1024x:    config.osr = 1024;  break;
+    default:                config.osr = 256;   break;
+    }
+    config.gain = 1 << ((inCtrl >> 3) & 0x07);
+    config.intDelay = 4 - ((inCtrl >> 6) & 0x03);  // SD16_INTDLY_4TH .. 1ST
+    return config;
+}
+
+
+Sd16Model::Sd16Model(const ModelConfig &config, uint32_t seed)
+    : modelConfig(config), random(seed)
+{
+    unsigned bits = 0;
+
+    while ((1U << bits) < config.osr)
+    {
+        bits++;
+    }
+    shift = 3 * bits - 16;
+    noiseRms = config.noiseDensity * sqrt(config.fm() / 2.0);  // white up to fM / 2
+    start();
+}
+
+
+void Sd16Model::start()
+{
+    int1 = int2 = 0.0;
+    bit = 1;
+    acc1 = acc2 = acc3 = 0;
+    comb1 = comb2 = comb3 = 0;
+    phase = 0;
+    results = 0;
+    clockCount = 0;
+}
+
+
+bool Sd16Model::clock(double vin, int16_t &code)
+{
+    double u = vin + modelConfig.offset;
+    uint64_t diff1, diff2, diff3;
+    int64_t output;
+
+    if (noiseRms > 0.0)
+    {
+        u += noise(random) * noiseRms;
+    }
+    u *= modelConfig.gain / modelConfig.vref;
+
+    bit = (int2 >= 0.0) ? 1 : -1;
+    int2 += 0.5 * (int1 - bit);
+    int1 += 0.5 * (u - bit);
+
+    acc1 += (uint64_t)(int64_t)bit;
+    acc2 += acc1;
+    acc3 += acc2;
+    clockCount++;
+
+    if (++phase < modelConfig.osr)
+    {
+        return false;
+    }
+    phase = 0;
+
+    diff1 = acc3 - comb1;   comb1 = acc3;
+    diff2 = diff1 - comb2;  comb2 = diff1;
+    diff3 = diff2 - comb3;  comb3 = diff2;
+
+    if (results < modelConfig.intDelay)             // filter settling - no interrupt yet
+    {
+        if (++results < modelConfig.intDelay)
+        {
+            return false;
+        }
+    }
+
+    output = (int64_t)diff3;
+    output = (shift >= 0) ? (output >> shift) : (output * (1 << -shift));
+    if (output > INT16_MAX)
+    {
+        output = INT16_MAX;
+    }
+    if (output < INT16_MIN)
+    {
+        output = INT16_MIN;
+    }
+    code = (int16_t)output;
+    return true;
+}
+
+
+int16_t Sd16Model::convert(double vin)
+{
+    int16_t code = 0;
+
+    while (!clock(vin, code))
+    {
+    }
+    return code;
+}
+
+
+}   // namespace sd16
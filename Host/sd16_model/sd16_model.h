@@ -0,0 +1,91 @@
+/******************************************************************************
+ * sd16_model.h - behavioral model of the MSP430F2013 SD16_A converter
+ * - PGA, 2nd order single bit modulator, sinc3 decimator and the 16 bit
+ *   result (SD16LSBACC = 0), in the bipolar 2's complement format
+ * - clock as set in main.c: SMCLK 16 MHz, SD16DIV_0, SD16XDIV_2 (/16) -
+ *   fM = 1 MHz, one result per OSR modulator clocks
+ * - first result on the SD16INTDLY sample after a start, as the hardware
+ * - input referred white noise (V/sqrt(Hz)) and offset - the modulator
+ *   alone only shows quantization noise, set the noise from a measurement
+ *
+ * Haroldo Amaral
+ * https://github.com/agaelema/msp430f20x3_as_i2c_16bit_adc
+ ******************************************************************************/
+
+#ifndef SD16_MODEL_H_
+#define SD16_MODEL_H_
+
+#include <stdint.h>
+#include <random>
+#include "sd16_header.h"
+
+namespace sd16 {
+
+
+/******************************************************************************
+ * Definitions
+ ******************************************************************************/
+#define     MODEL_SMCLK_HZ          (16000000.0)    // DCO - CALBC1_16MHZ
+#define     MODEL_NOISE_DENSITY     (200e-9)        // V/sqrt(Hz) - assumed, not from the datasheet
+
+struct ModelConfig
+{
+    double      smclk = MODEL_SMCLK_HZ;
+    unsigned    div = 1;                            // SD16DIV_x
+    unsigned    xdiv = 16;                          // SD16XDIV_x
+    unsigned    osr = 1024;                         // 32 .. 1024
+    unsigned    gain = 1;                           // 1 .. 32
+    unsigned    intDelay = 4;                       // result with the first interrupt - SD16INTDLY
+    double      vref = VREF;                        // V
+    double      noiseDensity = MODEL_NOISE_DENSITY; // input referred
+    double      offset = 0.0;                       // V, input referred
+
+    double fm() const { return smclk / div / xdiv; }
+    double outputRate() const { return fm() / osr; }
+    double vfsr() const { return vref / 2.0 / gain; }
+    double latency() const { return intDelay * osr / fm(); }    // start to first result, s
+
+    /* OSR from CHCTRL_H, gain and interrupt delay from IN_CTRL */
+    static ModelConfig fromRegisters(uint8_t chctrlHigh, uint8_t inCtrl);
+};
+
+
+/******************************************************************************
+ * Model
+ ******************************************************************************/
+class Sd16Model
+{
+public:
+    explicit Sd16Model(const ModelConfig &config, uint32_t seed = 1);
+
+    const ModelConfig &config() const { return modelConfig; }
+
+    /* SD16SC set - modulator and filter cleared, results counted from here */
+    void start();
+    /* one modulator clock with the input (V) - true when a result is ready */
+    bool clock(double vin, int16_t &code);
+    /* input held for one conversion - blocks until the next result */
+    int16_t convert(double vin);
+
+    uint64_t clocks() const { return clockCount; }
+
+private:
+    ModelConfig         modelConfig;
+    std::mt19937_64     random;
+    std::normal_distribution<double> noise;
+    double              noiseRms;                   // per modulator clock, V
+    int                 shift;                      // filter output to 16 bits, < 0 left
+
+    double              int1, int2;                 // modulator integrators
+    int                 bit;                        // last modulator output, +1 / -1
+    uint64_t            acc1, acc2, acc3;           // sinc3 - modulo 2^64
+    uint64_t            comb1, comb2, comb3;
+    unsigned            phase;                      // modulator clocks in this conversion
+    unsigned            results;                    // since start, up to intDelay
+    uint64_t            clockCount;
+};
+
+
+}   // namespace sd16
+
+#endif /* SD16_MODEL_H_ */
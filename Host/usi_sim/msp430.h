@@ -0,0 +1,198 @@
+/******************************************************************************
+ * msp430.h - host register model of the MSP430F2013
+ * - used instead of the TI header when main.c is built by usi_sim
+ * - each register is a plain variable, each access is counted - one MSP430
+ *   instruction with an absolute operand (see usi_sim.c, cycle estimate)
+ * - only registers and bits used by the firmware, values as in msp430f2013.h
+ *
+ * Haroldo Amaral
+ * https://github.com/agaelema/msp430f20x3_as_i2c_16bit_adc
+ ******************************************************************************/
+
+#ifndef SIM_MSP430_H_
+#define SIM_MSP430_H_
+
+#include <stdint.h>
+
+
+/******************************************************************************
+ * Register model
+ ******************************************************************************/
+extern uint32_t     simRegAccess;                   // peripheral accesses since reset
+extern uint32_t     simCntAccess;                   // last USICNT access - SCL released
+
+static inline volatile uint8_t *SIM_Reg8(volatile uint8_t *r)     { simRegAccess++; return r; }
+static inline volatile uint16_t *SIM_Reg16(volatile uint16_t *r)  { simRegAccess++; return r; }
+static inline volatile uint8_t *SIM_RegCnt(volatile uint8_t *r)   { simCntAccess = ++simRegAccess; return r; }
+
+extern volatile uint8_t     sim_DCOCTL, sim_BCSCTL1, sim_P1OUT, sim_P1DIR, sim_P1SEL, sim_P1REN,
+                            sim_P2OUT, sim_P2DIR, sim_P2SEL, sim_USICTL0, sim_USICTL1,
+                            sim_USICKCTL, sim_USICNT, sim_USISRL, sim_SD16INCTL0, sim_SD16AE,
+                            sim_BCSCTL3, sim_SD16PRE0;
+extern volatile uint16_t    sim_WDTCTL, sim_SD16CTL, sim_SD16CCTL0, sim_SD16MEM0,
+                            sim_FCTL1, sim_FCTL2, sim_FCTL3,
+                            sim_TACTL, sim_TACCTL0, sim_TACCTL1, sim_TACCR0, sim_TACCR1, sim_TAIV;
+extern volatile uint8_t     sim_CALBC1_16MHZ, sim_CALDCO_16MHZ;
+extern uint16_t     sim_InfoC[32];                  // information flash segments C, D
+extern uint16_t     sim_InfoD[32];
+
+#define     DCOCTL              (*SIM_Reg8(&sim_DCOCTL))
+#define     BCSCTL1             (*SIM_Reg8(&sim_BCSCTL1))
+#define     BCSCTL3             (*SIM_Reg8(&sim_BCSCTL3))
+#define     CALBC1_16MHZ        (*SIM_Reg8(&sim_CALBC1_16MHZ))
+#define     CALDCO_16MHZ        (*SIM_Reg8(&sim_CALDCO_16MHZ))
+#define     WDTCTL              (*SIM_Reg16(&sim_WDTCTL))
+#define     P1OUT               (*SIM_Reg8(&sim_P1OUT))
+#define     P1DIR               (*SIM_Reg8(&sim_P1DIR))
+#define     P1SEL               (*SIM_Reg8(&sim_P1SEL))
+#define     P1REN               (*SIM_Reg8(&sim_P1REN))
+#define     P2OUT               (*SIM_Reg8(&sim_P2OUT))
+#define     P2DIR               (*SIM_Reg8(&sim_P2DIR))
+#define     P2SEL               (*SIM_Reg8(&sim_P2SEL))
+#define     USICTL0             (*SIM_Reg8(&sim_USICTL0))
+#define     USICTL1             (*SIM_Reg8(&sim_USICTL1))
+#define     USICKCTL            (*SIM_Reg8(&sim_USICKCTL))
+#define     USICNT              (*SIM_RegCnt(&sim_USICNT))
+#define     USISRL              (*SIM_Reg8(&sim_USISRL))
+#define     SD16CTL             (*SIM_Reg16(&sim_SD16CTL))
+#define     SD16CCTL0           (*SIM_Reg16(&sim_SD16CCTL0))
+#define     SD16INCTL0          (*SIM_Reg8(&sim_SD16INCTL0))
+#define     SD16MEM0            (*SIM_Reg16(&sim_SD16MEM0))
+#define     SD16AE              (*SIM_Reg8(&sim_SD16AE))
+#define     SD16PRE0            (*SIM_Reg8(&sim_SD16PRE0))
+#define     FCTL1               (*SIM_Reg16(&sim_FCTL1))
+#define     FCTL2               (*SIM_Reg16(&sim_FCTL2))
+#define     FCTL3               (*SIM_Reg16(&sim_FCTL3))
+#define     TACTL               (*SIM_Reg16(&sim_TACTL))
+#define     TACCTL0             (*SIM_Reg16(&sim_TACCTL0))
+#define     TACCTL1             (*SIM_Reg16(&sim_TACCTL1))
+#define     TACCR0              (*SIM_Reg16(&sim_TACCR0))
+#define     TACCR1              (*SIM_Reg16(&sim_TACCR1))
+#define     TAIV                (*SIM_Reg16(&sim_TAIV))
+
+#define     CAL_FLASH_SEGMENT   (sim_InfoD)         // calibration block - see main.c
+#define     ADDR_FLASH_SEGMENT  (sim_InfoC)         // slave address
+
+
+/******************************************************************************
+ * Bits
+ ******************************************************************************/
+#define     BIT0                (0x0001)
+#define     BIT1                (0x0002)
+#define     BIT2                (0x0004)
+#define     BIT3                (0x0008)
+#define     BIT4                (0x0010)
+#define     BIT5                (0x0020)
+#define     BIT6                (0x0040)
+#define     BIT7                (0x0080)
+
+/* status register */
+#define     GIE                 (0x0008)
+#define     CPUOFF              (0x0010)
+#define     SCG0                (0x0040)
+#define     SCG1                (0x0080)
+#define     LPM1_bits           (SCG0+CPUOFF)
+#define     LPM3_bits           (SCG1+SCG0+CPUOFF)
+
+/* clock */
+#define     LFXT1S_2            (0x20)
+
+/* WDT */
+#define     WDTPW               (0x5A00)
+#define     WDTHOLD             (0x0080)
+
+/* flash */
+#define     FWKEY               (0xA500)
+#define     ERASE               (0x0002)
+#define     WRT                 (0x0040)
+#define     LOCK                (0x0010)
+#define     FSSEL_1             (0x0040)
+#define     FN0                 (0x0001)
+#define     FN1                 (0x0002)
+#define     FN2                 (0x0004)
+#define     FN5                 (0x0020)
+
+/* Timer_A */
+#define     TASSEL_1            (0x0100)
+#define     TASSEL_2            (0x0200)
+#define     ID_3                (0x00C0)
+#define     MC_1                (0x0010)
+#define     TACLR               (0x0004)
+#define     CCIE                (0x0010)
+#define     TAIV_TACCR1         (0x0002)
+
+/* USI */
+#define     USIPE7              (0x80)
+#define     USIPE6              (0x40)
+#define     USIOE               (0x02)
+#define     USISWRST            (0x01)
+#define     USII2C              (0x40)
+#define     USISTTIE            (0x20)
+#define     USIIE               (0x10)
+#define     USISTP              (0x04)
+#define     USISTTIFG           (0x02)
+#define     USIIFG              (0x01)
+#define     USICKPL             (0x02)
+#define     USIIFGCC            (0x20)
+
+/* SD16 */
+#define     SD16REFON           (0x0004)
+#define     SD16VMIDON          (0x0008)
+#define     SD16SSEL_1          (0x0010)
+#define     SD16DIV_0           (0x0000)
+#define     SD16XDIV_2          (0x0400)
+#define     SD16SC              (0x0002)
+#define     SD16IFG             (0x0004)
+#define     SD16IE              (0x0008)
+#define     SD16DF              (0x0010)
+#define     SD16OSR_1024        (0x0900)
+#define     SD16SNGL            (0x0400)
+#define     SD16UNI             (0x1000)
+#define     SD16INCH_0          (0x00)
+#define     SD16INCH_1          (0x01)
+#define     SD16INCH_2          (0x02)
+#define     SD16INCH_5          (0x05)
+#define     SD16INCH_6          (0x06)
+#define     SD16INCH_7          (0x07)
+#define     SD16GAIN_1          (0x00)
+#define     SD16INTDLY0         (0x40)
+#define     SD16INTDLY1         (0x80)
+#define     SD16INTDLY_0        (0x00)
+#define     SD16INTDLY_1        (0x40)
+#define     SD16AE0             (0x01)
+#define     SD16AE1             (0x02)
+#define     SD16AE2             (0x04)
+#define     SD16AE3             (0x08)
+#define     SD16AE4             (0x10)
+#define     SD16AE5             (0x20)
+
+/* vectors */
+#define     USI_VECTOR          (4 * 2)
+#define     SD16_VECTOR         (5 * 2)
+#define     TIMERA1_VECTOR      (8 * 2)
+#define     TIMERA0_VECTOR      (9 * 2)
+
+
+/******************************************************************************
+ * Intrinsics
+ * - low power mode returns to the harness, SIM_MainLoop() resumes the main loop
+ ******************************************************************************/
+void SIM_Sleep(void);
+
+#define     _BIS_SR(x)                      SIM_Sleep()
+#define     _BIC_SR(x)                      ((void)(x))
+#define     __bic_SR_register_on_exit(x)    ((void)(x))
+#define     __bis_SR_register_on_exit(x)    ((void)(x))
+#define     __even_in_range(x, y)           (x)
+#define     __no_operation()                ((void)0)
+#define     __disable_interrupt()           ((void)0)
+#define     __enable_interrupt()            ((void)0)
+
+#define     interrupt(vector)               used        // __attribute__((interrupt(n)))
+
+#if !defined (SIM_HARNESS)
+#define     main                firmware_main           // firmware entry called by the harness
+#endif
+
+
+#endif /* SIM_MSP430_H_ */
@@ -0,0 +1,262 @@
+/******************************************************************************
+ * usi_node.cpp - host driver (Host/sd16_i2c) against the simulated firmware
+ * - sd16::Node runs on a Transport that clocks its messages bit by bit into
+ *   MSP430/F2013_SD16_I2C-01/main.c, through the usi_sim.c harness
+ * - checks that the byte streams of the driver (configure, configureVerify,
+ *   read, readAndStart, readFifo, setPec) are accepted by the firmware, not
+ *   only by the register model in sim_node.cpp
+ * - PEC part with a firmware built with -DENABLE_PEC, sequencer part with
+ *   -DENABLE_SCAN_SEQUENCER
+ * - returns 1 if a transfer fails or a value does not match
+ *
+ * Build and run (from this folder):
+ *   gcc -std=gnu99 -Wall -DSIM_NO_MAIN -I. -I../../MSP430/F2013_SD16_I2C-01 -c \
+ *       usi_sim.c ../../MSP430/F2013_SD16_I2C-01/main.c
+ *   g++ -std=c++17 -Wall -I. -I../sd16_i2c -I../../MSP430/F2013_SD16_I2C-01 -o usi_node \
+ *       usi_node.cpp ../sd16_i2c/sd16_i2c.cpp usi_sim.o main.o
+ *   ./usi_node
+ *
+ * Same firmware options on both gcc and g++ command lines (-DENABLE_PEC,
+ * -DENABLE_SCAN_SEQUENCER).
+ *
+ * Haroldo Amaral
+ * https://github.com/agaelema/msp430f20x3_as_i2c_16bit_adc
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdint.h>
+#include "usi_sim.h"
+#include "sd16_i2c.h"
+
+using namespace sd16;
+
+
+/******************************************************************************
+ * Definitions and macros
+ ******************************************************************************/
+#define     NODE_CHECK(cond, text)  NodeCheck((cond), (text), __LINE__)
+
+
+/******************************************************************************
+ * Variables
+ ******************************************************************************/
+static uint32_t     errors = 0;
+
+
+static void NodeCheck(bool cond, const char *text, int line)
+{
+    if ( !cond )
+    {
+        printf("    FAIL (line %d): %s\n", line, text);
+        errors++;
+    }
+}
+
+
+/******************************************************************************
+ * Transport - I2C master of the harness
+ ******************************************************************************/
+/*
+ * start, message, repeated start ... stop, as i2c-dev I2C_RDWR - the last
+ * byte of each read is Nacked. The firmware main loop runs after each
+ * transfer, as it would between two transactions on the bus.
+ */
+class FirmwareBus : public Transport
+{
+public:
+    bool transfer(Msg *msgs, size_t count) override;
+
+    uint32_t transfers = 0;
+    uint32_t bytes = 0;                             // address and data bytes
+};
+
+
+bool FirmwareBus::transfer(Msg *msgs, size_t count)
+{
+    bool acked = true;
+    size_t i;
+    uint16_t n;
+
+    transfers++;
+
+    for (i = 0; (i < count) && acked; i++)
+    {
+        bytes++;
+        acked = I2C_Start(msgs[i].address, msgs[i].read);
+        for (n = 0; (n < msgs[i].length) && acked; n++)
+        {
+            bytes++;
+            if (msgs[i].read)
+            {
+                msgs[i].data[n] = I2C_Read(n < (msgs[i].length - 1));
+            }
+            else
+            {
+                acked = I2C_Write(msgs[i].data[n]);
+            }
+        }
+    }
+    I2C_Stop();
+    SIM_MainLoop();
+
+    return acked;
+}
+
+
+/******************************************************************************
+ * Scenarios
+ ******************************************************************************/
+/*
+ * single conversions - readAndStart() restarts the converter in the same
+ * transfer, one result per call with consecutive SAMPLE_CNT
+ */
+static void NodeSingle(Node &node, const char *name)
+{
+    Config config;
+    Sample sample;
+    uint8_t counter = 0;
+    int16_t i;
+
+    printf("%s\n", name);
+
+    config.single = true;
+    config.osr = Osr::x256;
+    NODE_CHECK( node.configure(config, true), "single configure failed" );
+    for (i = 0; i < 4; i++)
+    {
+        SD16_Convert(-300 + i);
+        NODE_CHECK( node.readAndStart(sample), "readAndStart failed" );
+        NODE_CHECK( sample.ready(), "single result not ready" );
+        NODE_CHECK( sample.code == (uint16_t)(-300 + i), "wrong single result" );
+        NODE_CHECK( (i == 0) || (sample.counter == (uint8_t)(counter + 1)), "SAMPLE_CNT not consecutive" );
+        counter = sample.counter;
+        if (i == 0)
+        {
+            NODE_CHECK( node.sync(), "sync failed" );   // counter jumped since the last scenario
+        }
+    }
+    NODE_CHECK( node.shadowed(), "shadow lost on consecutive samples" );
+
+    /* channel switch - only IN_CTRL and START sent */
+    config.channel = Channel::Ch1;
+    NODE_CHECK( node.configure(config, true), "channel switch failed" );
+    SD16_Convert(77);
+    NODE_CHECK( node.read(sample) && sample.ready() && (sample.code == 77), "result after channel switch" );
+
+    Config readBack;
+    NODE_CHECK( node.readConfig(readBack) && (readBack == config), "configuration read back differs" );
+    NODE_CHECK( node.stop(), "stop failed" );
+}
+
+
+/*
+ * continuous conversions into the FIFO
+ */
+static void NodeFifo(Node &node, const char *name)
+{
+    Config config;
+    uint16_t codes[SD16_FIFO_DEPTH];
+    uint8_t flush = SD16_FIFO_FLUSH;
+    bool overflow = true;
+    int count;
+    int16_t i;
+
+    printf("%s\n", name);
+
+    NODE_CHECK( node.writeRegs(SD16_REG_FIFO_CTRL, &flush, 1), "FIFO flush failed" );     // single results queued too
+    NODE_CHECK( node.configure(config, true), "continuous configure failed" );
+    for (i = 0; i < 5; i++)
+    {
+        SD16_Convert(1000 * i - 2000);
+    }
+    count = node.readFifo(codes, SD16_FIFO_DEPTH, &overflow);
+    NODE_CHECK( count == 5, "wrong FIFO count" );
+    NODE_CHECK( !overflow, "FIFO overflow flagged" );
+    for (i = 0; (i < count) && (i < 5); i++)
+    {
+        NODE_CHECK( codes[i] == (uint16_t)(1000 * i - 2000), "wrong FIFO sample" );
+    }
+    NODE_CHECK( node.readFifo(codes, SD16_FIFO_DEPTH) == 0, "FIFO not empty after read" );
+    NODE_CHECK( node.stop(), "stop failed" );
+}
+
+
+/*
+ * sequencer pass leaves its last slot loaded - configure() with the same
+ * configuration must not trust the shadow
+ */
+static void NodeSequencer(Node &node, const char *name)
+{
+    Config config;
+    Config readBack;
+    const uint8_t slots[4] = { SD16_CH2|SD16_GAIN1x, SD16_OSR_256x|SD16_BIPOLAR,
+                               SD16_CH3|SD16_GAIN1x, SD16_OSR_256x|SD16_BIPOLAR };
+    uint8_t seq = SD16_SEQ_ENABLE|SD16_SEQ_LENGTH(2);
+    int16_t i;
+
+    printf("%s\n", name);
+
+    NODE_CHECK( node.configure(config, true), "configure failed" );
+    if ( !node.writeRegs(SD16_REG_SEQ_CONFIG, slots, sizeof(slots)) || !node.writeRegs(SD16_REG_SEQ_CTRL, &seq, 1) )
+    {
+        printf("    skipped - no ENABLE_SCAN_SEQUENCER\n");
+        return;
+    }
+    for (i = 0; i < 2; i++)                         // single pass - slot 1 left loaded
+    {
+        SD16_Convert(10 * i);
+    }
+    NODE_CHECK( node.configure(config, true), "configure after sequencer failed" );
+    NODE_CHECK( node.readConfig(readBack) && (readBack == config), "sequencer slot left in use" );
+    NODE_CHECK( node.stop(), "stop failed" );
+}
+
+
+/******************************************************************************
+ * main code
+ ******************************************************************************/
+int main(void)
+{
+    FirmwareBus bus;
+    Node node(bus);
+    Config config;
+    Config readBack;
+    Sample sample;
+
+    SIM_Start();
+
+    /* configuration written and read back in one transfer */
+    printf("configureVerify\n");
+    config.osr = Osr::x512;
+    config.gain = Gain::x4;
+    NODE_CHECK( node.configureVerify(config, true, &readBack), "configureVerify failed" );
+    NODE_CHECK( readBack == config, "configuration read back differs" );
+    SD16_Convert(1234);
+    NODE_CHECK( node.read(sample) && sample.ready() && (sample.code == 1234), "continuous result" );
+    NODE_CHECK( node.read(sample) && !sample.ready(), "DRDY not cleared by read" );
+    NODE_CHECK( node.stop(), "stop failed" );
+
+    NodeSingle(node, "single + readAndStart");
+    NodeFifo(node, "FIFO");
+    NodeSequencer(node, "sequencer + configure");
+
+#if defined (ENABLE_PEC)
+    NODE_CHECK( node.setPec(true), "PEC not enabled" );
+    NodeSingle(node, "PEC byte");
+    NodeFifo(node, "PEC byte FIFO");
+    NODE_CHECK( node.setPec(true, true), "PEC word not enabled" );
+    NodeSingle(node, "PEC word");
+    NodeFifo(node, "PEC word FIFO");
+    NODE_CHECK( node.setPec(false), "PEC not disabled" );
+    NODE_CHECK( node.pecErrors() == 0, "PEC errors" );
+    NODE_CHECK( node.configureVerify(config, false), "configureVerify after PEC failed" );
+#else
+    NODE_CHECK( !node.setPec(true), "PEC enabled without ENABLE_PEC" );
+#endif
+
+    errors += SIM_Errors();
+    printf("\n%lu error(s) - %lu transfers, %lu bytes\n",
+           (unsigned long)errors, (unsigned long)bus.transfers, (unsigned long)bus.bytes);
+
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,1283 @@
+/******************************************************************************
+ * usi_sim.c - host simulator of the USI I2C slave
+ * - builds MSP430/F2013_SD16_I2C-01/main.c against the register model in
+ *   msp430.h and plays the I2C master bit by bit (start, address, data, ACK)
+ * - ISRs are called when the USI counter expires, as the hardware does
+ * - counts ISR entries and estimates CPU cycles per transferred byte
+ * - the firmware main() runs as a coroutine: it returns to the scenario
+ *   when it sleeps, SIM_MainLoop() runs one more pass of its loop
+ * - returns 1 if a transaction does not behave as the protocol expects
+ *
+ * Build and run (from this folder):
+ *   gcc -std=gnu99 -Wall -I. -I../../MSP430/F2013_SD16_I2C-01 -o usi_sim \
+ *       usi_sim.c ../../MSP430/F2013_SD16_I2C-01/main.c
+ *   ./usi_sim
+ *
+ * Firmware options are the ENABLE_... defines in main.c, extra ones can be
+ * added with -D on the command line. Scenarios of options that are off are
+ * skipped - run it with the defaults and with every option added.
+ *
+ * With -DSIM_NO_MAIN only the harness is built (usi_sim.h), for programs
+ * that bring their own master - see usi_node.cpp.
+ *
+ * Haroldo Amaral
+ * https://github.com/agaelema/msp430f20x3_as_i2c_16bit_adc
+ ******************************************************************************/
+
+#define     SIM_HARNESS
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <ucontext.h>
+#include "msp430.h"
+#include "sd16_header.h"
+#include "usi_sim.h"
+
+
+/******************************************************************************
+ * Definitions and macros
+ ******************************************************************************/
+#define     SLAVE_ADDR          (0x0B)
+
+/*
+ * cycle estimate - MCLK 16 MHz
+ * - ISR entry: accept (6) + push R12-R15 (12) + state dispatch (7)
+ * - ISR exit: pop R12-R15 (8) + RETI (5)
+ * - peripheral access: one instruction with absolute operand
+ * - code not touching registers (RAM, branches) is not counted - use the
+ *   figures to compare firmware versions, not as an absolute limit
+ * - SCL is released when USICNT is loaded (USIIFGCC = 0) or USIIFG cleared
+ */
+#define     SIM_MCLK            (16000000UL)
+#define     SIM_CYCLES_ENTRY    (25)
+#define     SIM_CYCLES_EXIT     (13)
+#define     SIM_CYCLES_REG      (4)
+
+#define     SIM_CHECK(cond, text)   SIM_Check((cond), (text), __LINE__)
+
+
+/******************************************************************************
+ * Register model - accessed directly by the harness (not counted)
+ ******************************************************************************/
+uint32_t    simRegAccess = 0;
+uint32_t    simCntAccess = 0;
+
+volatile uint8_t    sim_DCOCTL, sim_BCSCTL1, sim_P1OUT, sim_P1DIR, sim_P1SEL, sim_P1REN,
+                    sim_P2OUT, sim_P2DIR, sim_P2SEL, sim_USICTL0, sim_USICTL1,
+                    sim_USICKCTL, sim_USICNT, sim_USISRL, sim_SD16INCTL0, sim_SD16AE,
+                    sim_BCSCTL3, sim_SD16PRE0;
+volatile uint16_t   sim_WDTCTL, sim_SD16CTL, sim_SD16CCTL0, sim_SD16MEM0,
+                    sim_FCTL1, sim_FCTL2, sim_FCTL3,
+                    sim_TACTL, sim_TACCTL0, sim_TACCTL1, sim_TACCR0, sim_TACCR1, sim_TAIV;
+volatile uint8_t    sim_CALBC1_16MHZ = 0x8F;
+volatile uint8_t    sim_CALDCO_16MHZ = 0x95;
+uint16_t    sim_InfoC[32];
+uint16_t    sim_InfoD[32];
+
+
+/******************************************************************************
+ * Variables
+ ******************************************************************************/
+struct _sim_stats
+{
+    uint32_t    bytes;                  // bytes on the bus, address included
+    uint32_t    usiEntries;
+    uint32_t    sd16Entries;
+    uint32_t    cycles;                 // estimated - USI ISR only
+    uint32_t    maxRelease;             // worst cycles from interrupt to SCL release
+};
+typedef struct _sim_stats sim_stats;
+
+static sim_stats    simStats;
+static uint32_t     errors = 0;
+static ucontext_t   simContext;                 // scenario
+static ucontext_t   firmwareContext;            // firmware main(), stopped in low power mode
+static uint8_t      firmwareStack[64 * 1024];
+
+
+/******************************************************************************
+ * Prototype of functions
+ ******************************************************************************/
+int firmware_main(void);
+void USI_TXRX_ISR(void);
+void SD16_ISR(void);
+void TIMERA0_ISR(void) __attribute__((weak));       // firmware options - may be missing
+void TIMERA1_ISR(void) __attribute__((weak));
+void ADDR_Load(void) __attribute__((weak));
+
+
+/******************************************************************************
+ * Harness helpers
+ ******************************************************************************/
+void SIM_Sleep(void)
+{
+    swapcontext(&firmwareContext, &simContext);     // firmware ready - back to the scenario
+}
+
+
+static void SIM_Firmware(void)
+{
+    firmware_main();
+}
+
+
+/*
+ * woken from low power mode - main loop handles the requests of the ISRs
+ * and sleeps again
+ */
+void SIM_MainLoop(void)
+{
+    swapcontext(&simContext, &firmwareContext);
+}
+
+
+/*
+ * power-up - erased flash, firmware main() from reset to its first sleep
+ */
+void SIM_Start(void)
+{
+    memset(sim_InfoC, 0xFF, sizeof(sim_InfoC));
+    memset(sim_InfoD, 0xFF, sizeof(sim_InfoD));
+    getcontext(&firmwareContext);
+    firmwareContext.uc_stack.ss_sp = firmwareStack;
+    firmwareContext.uc_stack.ss_size = sizeof(firmwareStack);
+    firmwareContext.uc_link = NULL;
+    makecontext(&firmwareContext, SIM_Firmware, 0);
+    SIM_MainLoop();
+}
+
+
+uint32_t SIM_Errors(void)
+{
+    return errors;
+}
+
+
+static void SIM_Check(int cond, const char *text, int line)
+{
+    if ( !cond )
+    {
+        printf("    FAIL (line %d): %s\n", line, text);
+        errors++;
+    }
+}
+
+
+/*
+ * USI interrupt - pending while enabled flags are set
+ */
+static void SIM_UsiService(void)
+{
+    uint32_t access;
+    uint32_t cycles;
+    uint32_t release;
+
+    while ( ((sim_USICTL1 & USIIFG) && (sim_USICTL1 & USIIE))
+         || ((sim_USICTL1 & USISTTIFG) && (sim_USICTL1 & USISTTIE)) )
+    {
+        access = simRegAccess;
+        USI_TXRX_ISR();
+        cycles = SIM_CYCLES_ENTRY + (simRegAccess - access) * SIM_CYCLES_REG;
+
+        if ( (simCntAccess > access) && (sim_USICNT & 0x1F) && !(sim_USICNT & USIIFGCC) )
+        {
+            release = SIM_CYCLES_ENTRY + (simCntAccess - access) * SIM_CYCLES_REG;
+            sim_USICTL1 &= ~USIIFG;                 // cleared by the counter load
+        }
+        else
+        {
+            release = cycles;                       // released by USIIFG clear
+        }
+
+        simStats.usiEntries++;
+        simStats.cycles += cycles + SIM_CYCLES_EXIT;
+        if (release > simStats.maxRelease)
+        {
+            simStats.maxRelease = release;
+        }
+    }
+}
+
+
+/*
+ * clock n bits on the bus - SDA is the wired AND of master and slave
+ * - slave drives the MSB of USISRL while USIOE is set, received bits
+ *   are shifted in from the LSB
+ * - no effect if the ISR did not load the counter (slave not taking part)
+ */
+static uint8_t BUS_Clock(uint8_t bits, uint8_t master)
+{
+    uint8_t line = 0;
+    uint8_t sda;
+    uint8_t i;
+
+    if ( (sim_USICNT & 0x1F) == 0 )
+    {
+        return 0xFF;                    // released - Nack / 0xFF
+    }
+    SIM_CHECK( (sim_USICNT & 0x1F) == bits, "USI counter does not match the bus phase" );
+
+    for (i = 0; i < bits; i++)
+    {
+        sda = (master >> (bits - 1 - i)) & 0x01;
+        if ( (sim_USICTL0 & USIOE) && !(sim_USISRL & 0x80) )
+        {
+            sda = 0;                    // slave pulls SDA low
+        }
+        sim_USISRL = (sim_USISRL << 1) | sda;
+        line = (line << 1) | sda;
+    }
+
+    sim_USICNT &= ~0x1F;
+    sim_USICTL1 |= USIIFG;              // counter expired
+    SIM_UsiService();
+
+    return line;
+}
+
+
+/******************************************************************************
+ * I2C master
+ ******************************************************************************/
+uint8_t I2C_Start(uint8_t address, uint8_t read)
+{
+    sim_USICTL1 |= USISTTIFG;
+    SIM_UsiService();
+
+    BUS_Clock(8, (address << 1) | read);
+    simStats.bytes++;
+
+    return !(BUS_Clock(1, 0x01) & 0x01);            // true if Ack
+}
+
+
+uint8_t I2C_Write(uint8_t data)
+{
+    BUS_Clock(8, data);
+    simStats.bytes++;
+
+    return !(BUS_Clock(1, 0x01) & 0x01);
+}
+
+
+uint8_t I2C_Read(uint8_t ack)
+{
+    uint8_t data = BUS_Clock(8, 0xFF);              // master releases SDA
+    simStats.bytes++;
+
+    BUS_Clock(1, ack ? 0x00 : 0x01);
+    return data;
+}
+
+
+void I2C_Stop(void)
+{
+    sim_USICTL1 |= USISTP;                          // no interrupt - seen by the firmware at next start
+}
+
+
+/******************************************************************************
+ * SD16 - conversion result ready
+ ******************************************************************************/
+void SD16_Convert(int16_t value)
+{
+    if ( !(sim_SD16CCTL0 & SD16SC) )
+    {
+        return;                                     // converter stopped
+    }
+    if (sim_SD16CCTL0 & SD16SNGL)
+    {
+        sim_SD16CCTL0 &= ~SD16SC;                   // single conversion complete
+    }
+
+    sim_SD16MEM0 = (uint16_t)value;
+    sim_SD16CCTL0 |= SD16IFG;
+    if (sim_SD16CCTL0 & SD16IE)
+    {
+        SD16_ISR();
+        simStats.sd16Entries++;
+    }
+    sim_SD16CCTL0 &= ~SD16IFG;                      // cleared by reading SD16MEM0
+}
+
+
+#if !defined (SIM_NO_MAIN)                           // scenarios - not in programs using usi_sim.h
+static uint8_t      simAddr = SLAVE_ADDR;       // slave addressed by I2C_WriteRegs / ReadRegs
+
+
+/*
+ * [pointer] [data] ... - returns number of bytes acked
+ */
+static uint8_t I2C_WriteRegs(const uint8_t *data, uint8_t length)
+{
+    uint8_t acked = 0;
+
+    if ( I2C_Start(simAddr, 0) )
+    {
+        while ( (acked < length) && I2C_Write(data[acked]) )
+        {
+            acked++;
+        }
+    }
+    I2C_Stop();
+
+    return acked;
+}
+
+
+static void I2C_ReadRegs(uint8_t *data, uint8_t length)
+{
+    uint8_t i;
+
+    SIM_CHECK( I2C_Start(simAddr, 1), "read address not acked" );
+    for (i = 0; i < length; i++)
+    {
+        data[i] = I2C_Read(i < (length - 1));       // Nack on last byte
+    }
+    I2C_Stop();
+}
+
+
+/*
+ * SMBus PEC - bitwise CRC-8 (polynomial 0x07), independent of the firmware table
+ */
+static uint8_t SIM_Crc8(uint8_t crc, uint8_t data)
+{
+    uint8_t i;
+
+    crc ^= data;
+    for (i = 0; i < 8; i++)
+    {
+        crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+    return crc;
+}
+
+
+/*
+ * [pointer] [data] [PEC] [data] [PEC] ... - returns bytes acked, PEC included
+ * - corrupt: index of a data byte sent with one bit flipped, 0 for none
+ */
+static uint8_t I2C_WritePec(const uint8_t *data, uint8_t length, uint8_t corrupt)
+{
+    uint8_t crc = SIM_Crc8(0, simAddr << 1);
+    uint8_t acked = 0;
+    uint8_t i;
+
+    if ( I2C_Start(simAddr, 0) && I2C_Write(data[0]) )
+    {
+        acked++;
+        crc = SIM_Crc8(crc, data[0]);
+        for (i = 1; i < length; i++)
+        {
+            crc = SIM_Crc8(crc, data[i]);
+            if ( !I2C_Write((i == corrupt) ? (data[i] ^ 0x10) : data[i]) )
+            {
+                break;
+            }
+            acked++;
+            if ( !I2C_Write(crc) )
+            {
+                break;
+            }
+            acked++;
+            crc = 0;                                // CRC including its PEC
+        }
+    }
+    I2C_Stop();
+
+    return acked;
+}
+
+
+/*
+ * [pointer] rs [data ...] [PEC] - PEC after each byte or each word,
+ * returns true if all match
+ */
+static uint8_t I2C_ReadPec(uint8_t pointer, uint8_t *data, uint8_t length, uint8_t word)
+{
+    uint8_t crc = SIM_Crc8(0, simAddr << 1);
+    uint8_t match = 1;
+    uint8_t i;
+
+    SIM_CHECK( I2C_Start(simAddr, 0) && I2C_Write(pointer), "pointer not acked" );
+    crc = SIM_Crc8(crc, pointer);
+    SIM_CHECK( I2C_Start(simAddr, 1), "read address not acked" );     // repeated start
+    crc = SIM_Crc8(crc, (simAddr << 1) | 1);
+
+    for (i = 0; i < length; i++)
+    {
+        data[i] = I2C_Read(1);
+        crc = SIM_Crc8(crc, data[i]);
+        if ( !word || (i & 0x01) )
+        {
+            match &= (I2C_Read(i < (length - 1)) == crc);
+            crc = 0;
+        }
+    }
+    I2C_Stop();
+
+    return match;
+}
+
+
+/*
+ * FIFO_DELTA stream - returns decoded samples, same as the Arduino example
+ */
+static uint8_t SIM_DecodeDelta(const uint8_t *data, uint8_t length, int16_t *samples)
+{
+    uint8_t n = 0;
+    uint8_t i = 3;
+
+    if ( (length < 3) || !(data[0] & ~SD16_FIFO_OVERFLOW) )
+    {
+        return 0;
+    }
+    samples[n++] = (int16_t)(data[1] | (data[2] << 8));
+
+    while (i < length)
+    {
+        if (data[i] == SD16_DELTA_EMPTY)
+        {
+            break;
+        }
+        if (data[i] == SD16_DELTA_ESCAPE)
+        {
+            if ( (i + 3) > length )
+            {
+                break;                              // incomplete - sent again next read
+            }
+            samples[n] = (int16_t)(data[i + 1] | (data[i + 2] << 8));
+            i += 3;
+        }
+        else
+        {
+            samples[n] = (int16_t)((uint16_t)samples[n - 1] + (int8_t)data[i]);
+            i++;
+        }
+        n++;
+    }
+
+    return n;
+}
+
+
+/******************************************************************************
+ * Report
+ ******************************************************************************/
+static void SIM_Begin(const char *name)
+{
+    memset(&simStats, 0, sizeof(simStats));
+    printf("%-22s", name);
+}
+
+
+/*
+ * cycles per byte
+ * - CPU kHz: SCL rate that keeps the CPU busy with the USI
+ * - no stretch kHz: SCL low (half period) longer than the worst release
+ */
+static void SIM_End(void)
+{
+    uint32_t perByte = simStats.bytes ? (simStats.cycles / simStats.bytes) : 0;
+
+    printf("%5lu %6lu %6lu %8lu %7lu %8lu %9lu",
+           (unsigned long)simStats.bytes, (unsigned long)simStats.usiEntries,
+           (unsigned long)simStats.cycles, (unsigned long)perByte,
+           (unsigned long)simStats.maxRelease,
+           perByte ? (unsigned long)((9 * SIM_MCLK) / perByte / 1000) : 0UL,
+           simStats.maxRelease ? (unsigned long)(SIM_MCLK / (2 * simStats.maxRelease) / 1000) : 0UL);
+    if (simStats.sd16Entries)
+    {
+        printf("   (+%lu SD16)", (unsigned long)simStats.sd16Entries);
+    }
+    printf("\n");
+}
+
+
+/******************************************************************************
+ * main code - scenarios run in sequence on one firmware instance
+ ******************************************************************************/
+int main(void)
+{
+    uint8_t buffer[16];
+    uint8_t i;
+
+    SIM_Start();
+
+    printf("%-22s%5s %6s %6s %8s %7s %8s %9s\n",
+           "scenario", "bytes", "ISRs", "cycles", "cyc/byte", "release", "CPU kHz", "no stretch");
+
+    /* wrong address - Nack, slave back to idle */
+    SIM_Begin("address nack");
+    SIM_CHECK( !I2C_Start(SLAVE_ADDR + 1, 0), "other address acked" );
+    I2C_Stop();
+    SIM_End();
+
+    /* configure and start in one transaction */
+    SIM_Begin("config + start");
+    {
+        const uint8_t config[] = { SD16_REG_CHCTRL_L, SD16_DF_2S_COMP,
+                                   SD16_OSR_1024x|SD16_CONT_CONV|SD16_BIPOLAR,
+                                   SD16_CH1|SD16_GAIN1x, SD16_START_CONVERSION };
+
+        SIM_CHECK( I2C_WriteRegs(config, sizeof(config)) == sizeof(config), "configuration not acked" );
+    }
+    SIM_End();
+    SIM_CHECK( sim_SD16CCTL0 & SD16SC, "conversion not started" );
+    SIM_CHECK( !(sim_SD16CCTL0 & SD16SNGL), "continuous mode not set" );
+    SIM_CHECK( sim_SD16INCTL0 == SD16_CH1, "input not set" );
+    SIM_CHECK( sim_SD16AE == (SD16AE2|SD16AE3), "inputs not connected" );
+
+    SD16_Convert(1000);
+    SD16_Convert(-2000);
+    SD16_Convert(3000);
+
+    /* status + result + counter */
+    SIM_Begin("status + result");
+    buffer[0] = SD16_REG_STATUS;
+    SIM_CHECK( I2C_WriteRegs(buffer, 1) == 1, "pointer not acked" );
+    I2C_ReadRegs(buffer, 4);
+    SIM_End();
+    SIM_CHECK( buffer[0] & SD16_STATUS_DRDY, "DRDY not set" );
+    SIM_CHECK( (int16_t)(buffer[1] | (buffer[2] << 8)) == 3000, "wrong result" );
+    I2C_ReadRegs(buffer, 1);
+    SIM_CHECK( !(buffer[0] & SD16_STATUS_DRDY), "DRDY not cleared on read" );
+
+    /* legacy command - second byte Nacked, pointer back on result - skipped if ENABLE_LEGACY_COMMANDS is off (Nack) */
+    buffer[0] = SD16_IN_CTRL;
+    buffer[1] = SD16_CH2|SD16_GAIN1x;
+    if ( I2C_WriteRegs(buffer, 2) == 1 )
+    {
+        buffer[1] = SD16_CH1|SD16_GAIN1x;
+        SIM_Begin("legacy command");
+        SIM_CHECK( I2C_WriteRegs(buffer, 2) == 1, "legacy command not completed with Nack" );
+        I2C_ReadRegs(buffer, 2);
+        SIM_End();
+        SIM_CHECK( sim_SD16INCTL0 == SD16_CH1, "legacy command not applied" );
+        SIM_CHECK( (int16_t)(buffer[0] | (buffer[1] << 8)) == 3000, "pointer not on result" );
+    }
+
+    /* pointer out of map */
+    SIM_Begin("invalid pointer");
+    buffer[0] = 0x7F;
+    SIM_CHECK( I2C_WriteRegs(buffer, 1) == 0, "invalid pointer acked" );
+    SIM_End();
+
+    /* FIFO burst - 4 samples */
+    buffer[0] = SD16_REG_FIFO_CTRL;
+    buffer[1] = SD16_FIFO_FLUSH;
+    I2C_WriteRegs(buffer, 2);
+    for (i = 0; i < 4; i++)
+    {
+        SD16_Convert(100 * i);
+    }
+    SIM_Begin("fifo burst");
+    buffer[0] = SD16_REG_FIFO_COUNT;
+    I2C_WriteRegs(buffer, 1);
+    I2C_ReadRegs(buffer, 9);
+    SIM_End();
+    SIM_CHECK( buffer[0] == 4, "wrong FIFO count" );
+    for (i = 0; i < 4; i++)
+    {
+        SIM_CHECK( (int16_t)(buffer[1 + 2*i] | (buffer[2 + 2*i] << 8)) == 100 * i, "wrong FIFO sample" );
+    }
+
+    /* FIFO read stopped after a low byte - that sample is sent again */
+    buffer[0] = SD16_REG_FIFO_CTRL;
+    buffer[1] = SD16_FIFO_FLUSH;
+    I2C_WriteRegs(buffer, 2);
+    SD16_Convert(111);
+    SD16_Convert(-222);
+    buffer[0] = SD16_REG_FIFO_DATA;
+    I2C_WriteRegs(buffer, 1);
+    I2C_ReadRegs(buffer, 3);
+    SIM_CHECK( (int16_t)(buffer[0] | (buffer[1] << 8)) == 111, "wrong FIFO sample" );
+    I2C_ReadRegs(buffer, 2);
+    SIM_CHECK( (int16_t)(buffer[0] | (buffer[1] << 8)) == -222, "half sent FIFO sample lost" );
+    buffer[0] = SD16_REG_FIFO_COUNT;
+    I2C_WriteRegs(buffer, 1);
+    I2C_ReadRegs(buffer, 1);
+    SIM_CHECK( buffer[0] == 0, "FIFO not empty" );
+
+    /* FIFO burst - 7 slowly varying samples, raw and delta coded */
+    {
+        const int16_t wave[7] = { 1000, 1003, 998, 1010, 5000, 5002, 4990 };
+        int16_t decoded[16];
+
+        buffer[0] = SD16_REG_FIFO_CTRL;
+        buffer[1] = SD16_FIFO_FLUSH;
+        I2C_WriteRegs(buffer, 2);
+        for (i = 0; i < 7; i++)
+        {
+            SD16_Convert(wave[i]);
+        }
+        SIM_Begin("fifo raw 7");
+        buffer[0] = SD16_REG_FIFO_COUNT;
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(buffer, 15);
+        SIM_End();
+        SIM_CHECK( buffer[0] == 7, "wrong FIFO count" );
+
+        for (i = 0; i < 7; i++)
+        {
+            SD16_Convert(wave[i]);
+        }
+        SIM_Begin("fifo delta 7");
+        buffer[0] = SD16_REG_FIFO_DELTA;
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(buffer, 11);                   // count + key + 3 deltas + escape + 2 deltas
+        SIM_End();
+        if (buffer[0] != 0xFF)                      // skipped if ENABLE_FIFO_DELTA is off (dummy bytes)
+        {
+            SIM_CHECK( buffer[0] == 7, "wrong FIFO count" );
+            SIM_CHECK( buffer[6] == SD16_DELTA_ESCAPE, "large step not escaped" );
+            SIM_CHECK( SIM_DecodeDelta(buffer, 11, decoded) == 7, "wrong number of delta samples" );
+            for (i = 0; i < 7; i++)
+            {
+                SIM_CHECK( decoded[i] == wave[i], "wrong delta sample" );
+            }
+
+            /* read ends inside an escaped sample - sent again by the next read */
+            SD16_Convert(0);
+            SD16_Convert(2000);
+            SD16_Convert(2001);
+            I2C_ReadRegs(buffer, 5);                // count + key + escape + low byte
+            SIM_CHECK( SIM_DecodeDelta(buffer, 5, decoded) == 1, "incomplete sample decoded" );
+            I2C_ReadRegs(buffer, 6);
+            SIM_CHECK( buffer[0] == 2, "incomplete sample removed" );
+            SIM_CHECK( (SIM_DecodeDelta(buffer, 6, decoded) == 2) && (decoded[0] == 2000) && (decoded[1] == 2001),
+                       "wrong samples after incomplete read" );
+            SIM_CHECK( buffer[4] == SD16_DELTA_EMPTY, "empty FIFO not signaled" );
+        }
+    }
+
+    /* long reads - cost of each byte in steady state */
+    SIM_Begin("burst read 16");
+    buffer[0] = SD16_REG_RESULT_EXT;
+    I2C_WriteRegs(buffer, 1);
+    I2C_ReadRegs(buffer, 16);
+    SIM_End();
+
+    SIM_Begin("burst write 4");
+    {
+        const uint8_t config[] = { SD16_REG_CHCTRL_L, SD16_DF_2S_COMP,
+                                   SD16_OSR_1024x|SD16_SNG_CONV|SD16_BIPOLAR,
+                                   SD16_CH1|SD16_GAIN1x, SD16_STOP_CONVERSION };
+
+        SIM_CHECK( I2C_WriteRegs(config, sizeof(config)) == sizeof(config), "configuration not acked" );
+    }
+    SIM_End();
+
+    /* settling - latency of the current configuration, discarded results - skipped if ENABLE_LATENCY_CONTROL is off (Nack) */
+    {
+        const uint8_t config[] = { SD16_REG_CHCTRL_L, SD16_DF_2S_COMP,
+                                   SD16_OSR_256x|SD16_CONT_CONV|SD16_BIPOLAR,
+                                   SD16_CH1|SD16_GAIN1x|SD16_INTDLY_3RD, SD16_START_CONVERSION };
+
+        buffer[0] = SD16_REG_DISCARD;
+        buffer[1] = 2;
+        if ( I2C_WriteRegs(buffer, 2) == 2 )
+        {
+            SIM_Begin("settling");
+            SIM_CHECK( I2C_WriteRegs(config, sizeof(config)) == sizeof(config), "configuration not acked" );
+            buffer[0] = SD16_REG_PRELOAD;
+            buffer[1] = 16;
+            I2C_WriteRegs(buffer, 2);
+            I2C_ReadRegs(buffer, 4);
+            SIM_End();
+            SIM_CHECK( (buffer[0] == 16) && (buffer[1] == 2), "preload / discard not read back" );
+            SIM_CHECK( (buffer[2] | (buffer[3] << 8)) == ((3 + 2) * 256 + 16), "wrong latency" );
+            buffer[0] = SD16_REG_CHCTRL_H;          // single - every discard converts again
+            buffer[1] = SD16_OSR_256x|SD16_SNG_CONV|SD16_BIPOLAR;
+            I2C_WriteRegs(buffer, 2);
+            buffer[0] = SD16_REG_LATENCY;
+            I2C_WriteRegs(buffer, 1);
+            I2C_ReadRegs(buffer, 2);
+            SIM_CHECK( (buffer[0] | (buffer[1] << 8)) == (1 + 2) * (3 * 256 + 16), "wrong latency, single mode" );
+            buffer[0] = SD16_REG_CHCTRL_H;
+            buffer[1] = SD16_OSR_256x|SD16_CONT_CONV|SD16_BIPOLAR;
+            buffer[2] = SD16_CH1|SD16_GAIN1x|SD16_INTDLY_3RD;
+            buffer[3] = SD16_START_CONVERSION;
+            I2C_WriteRegs(buffer, 4);
+            buffer[0] = SD16_REG_SAMPLE_CNT;
+            I2C_WriteRegs(buffer, 1);
+            I2C_ReadRegs(buffer, 1);
+            i = buffer[0];
+            SD16_Convert(1);
+            SD16_Convert(2);
+            I2C_ReadRegs(buffer, 1);
+            SIM_CHECK( buffer[0] == i, "result not discarded" );
+            SD16_Convert(3);
+            I2C_ReadRegs(buffer, 1);
+            SIM_CHECK( buffer[0] == (uint8_t)(i + 1), "result after discard missing" );
+            buffer[0] = SD16_REG_DISCARD;
+            buffer[1] = SD16_DISCARD_MAX + 1;
+            SIM_CHECK( I2C_WriteRegs(buffer, 2) == 1, "discard out of range acked" );
+            buffer[1] = 0;
+            I2C_WriteRegs(buffer, 2);
+        }
+        else
+        {
+            I2C_WriteRegs(config, sizeof(config));  // continuous, as left by the checks above
+        }
+    }
+
+    /* paced sampling - skipped if ENABLE_PACED_SAMPLING is off (Nack) */
+    buffer[0] = SD16_REG_FIFO_CTRL;
+    buffer[1] = SD16_FIFO_FLUSH;
+    I2C_WriteRegs(buffer, 2);
+    buffer[0] = SD16_REG_PACE_PERIOD;
+    buffer[1] = 1200 & 0xFF;                        // 100 ms at 12 kHz
+    buffer[2] = 1200 >> 8;
+    buffer[3] = SD16_PACE_ENABLE|SD16_PACE_POWER_DOWN;
+    SIM_CHECK( !(sim_SD16CCTL0 & SD16SNGL), "continuous mode not set before pacing" );
+    if ( (I2C_WriteRegs(buffer, 4) == 4) && TIMERA0_ISR && TIMERA1_ISR )
+    {
+        SIM_CHECK( (sim_TACTL & (TASSEL_2|TASSEL_1|MC_1)) == (TASSEL_1|MC_1), "timer not on ACLK, up mode" );
+        SIM_CHECK( (sim_TACCR0 == 1199) && (sim_TACCR1 < sim_TACCR0), "wrong timer period / warm-up" );
+        SIM_CHECK( !(sim_SD16CTL & (SD16REFON|SD16VMIDON)), "reference not powered down" );
+        SIM_CHECK( sim_SD16CCTL0 & SD16SNGL, "single conversion not forced" );
+
+        sim_TAIV = TAIV_TACCR1;
+        TIMERA1_ISR();
+        SIM_CHECK( (sim_SD16CTL & (SD16REFON|SD16VMIDON)) == (SD16REFON|SD16VMIDON), "reference not warmed up" );
+        TIMERA0_ISR();
+        SIM_CHECK( sim_SD16CCTL0 & SD16SC, "tick did not start a conversion" );
+        SD16_Convert(123);
+        SIM_CHECK( !(sim_SD16CTL & (SD16REFON|SD16VMIDON)), "reference not off after sample" );
+
+        buffer[0] = SD16_REG_PACE_CTRL;
+        buffer[1] = 0;
+        I2C_WriteRegs(buffer, 2);
+        SIM_CHECK( !(sim_TACTL & MC_1) && (sim_SD16CTL & SD16REFON), "pacing not stopped" );
+        SIM_CHECK( !(sim_SD16CCTL0 & SD16SNGL), "continuous mode not restored after pacing" );
+        buffer[0] = SD16_REG_FIFO_COUNT;
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(buffer, 3);
+        SIM_CHECK( (buffer[0] == 1) && ((int16_t)(buffer[1] | (buffer[2] << 8)) == 123), "paced sample not queued" );
+    }
+
+    /* new address stored in flash, main loop writes it - skipped if ENABLE_ADDRESS_FLASH is off (Nack) */
+    SIM_CHECK( !I2C_Start(0x00, 0), "general call acked while disabled" );
+    I2C_Stop();
+    SIM_Begin("address");
+    buffer[0] = SD16_REG_I2C_ADDR;
+    buffer[1] = 0x21;
+    buffer[2] = SD16_I2C_GCALL|SD16_I2C_SAVE;
+    i = I2C_WriteRegs(buffer, 3);
+    SIM_End();
+    if (i == 3)
+    {
+        SIM_CHECK( !I2C_Start(SLAVE_ADDR, 0), "old address acked" );
+        I2C_Stop();
+        simAddr = 0x21;
+        buffer[0] = SD16_REG_I2C_CTRL;
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(buffer, 1);
+        SIM_CHECK( buffer[0] & SD16_I2C_SAVE, "save not pending" );
+        SIM_MainLoop();
+        SIM_CHECK( sim_InfoC[0] == (((buffer[0] & ~SD16_I2C_SAVE) << 8) | 0x21), "address not stored" );
+        buffer[0] = SD16_REG_I2C_ADDR;
+        buffer[1] = 0x7F;
+        SIM_CHECK( I2C_WriteRegs(buffer, 2) == 1, "reserved address acked" );
+    }
+    else
+    {
+        SIM_CHECK( i == 1, "save acked without ENABLE_ADDRESS_FLASH" );
+    }
+
+    /* general call start - conversion restarted, counter and FIFO aligned - skipped if ENABLE_GENERAL_CALL is off */
+    buffer[0] = SD16_REG_I2C_CTRL;
+    buffer[1] = SD16_I2C_GCALL;
+    I2C_WriteRegs(buffer, 2);
+    I2C_ReadRegs(buffer, 1);
+    if (buffer[0] & SD16_I2C_GCALL)
+    {
+        SD16_Convert(10);
+        SIM_Begin("gcall start");
+        SIM_CHECK( I2C_Start(0x00, 0), "general call not acked" );
+        SIM_CHECK( I2C_Write(SD16_GCALL_START), "start command not acked" );
+        SIM_CHECK( !I2C_Write(SD16_GCALL_START), "second command byte acked" );
+        I2C_Stop();
+        SIM_End();
+        SIM_CHECK( sim_SD16CCTL0 & SD16SC, "conversion not started" );
+        SIM_CHECK( I2C_Start(0x00, 0) && !I2C_Write(0x55), "unknown command acked" );
+        I2C_Stop();
+        buffer[0] = SD16_REG_SAMPLE_CNT;
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(buffer, 2);
+        SIM_CHECK( (buffer[0] == 0) && (buffer[1] == 0), "counter / FIFO not restarted" );
+    }
+
+    /* stored address used after reset */
+    if (ADDR_Load)
+    {
+        buffer[0] = SD16_REG_I2C_ADDR;
+        buffer[1] = SLAVE_ADDR;
+        I2C_WriteRegs(buffer, 2);
+        ADDR_Load();
+        SIM_CHECK( !I2C_Start(SLAVE_ADDR, 0), "address not loaded from flash" );
+        I2C_Stop();
+    }
+
+    /* statistics - one window of 5 results, sum of squares over 32 bits, next window on read */
+    {
+        const uint8_t config[] = { SD16_REG_CHCTRL_L, SD16_DF_2S_COMP,
+                                   SD16_OSR_256x|SD16_CONT_CONV|SD16_BIPOLAR,
+                                   SD16_CH1|SD16_GAIN1x, SD16_START_CONVERSION };
+
+        I2C_WriteRegs(config, sizeof(config));
+    }
+    buffer[0] = SD16_REG_STATS_WINDOW;
+    buffer[1] = 5;
+    buffer[2] = 0;
+    buffer[3] = SD16_STATS_ENABLE|SD16_STATS_CLEAR_ON_READ;
+    if ( I2C_WriteRegs(buffer, 4) == 4 )            // skipped if ENABLE_STATISTICS is off (Nack)
+    {
+        const int16_t window[5] = { -30000, 30000, 30000, -30000, 30000 };
+        uint8_t block[SD16_STATS_SIZE];
+        uint64_t squares;
+
+        for (i = 0; i < 4; i++)
+        {
+            SD16_Convert(window[i]);
+        }
+        buffer[0] = SD16_REG_STATUS;
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(buffer, 1);
+        SIM_CHECK( !(buffer[0] & SD16_STATUS_STATS), "window complete early" );
+        SD16_Convert(window[4]);
+        SD16_Convert(-1);                           // after the window - not counted
+        I2C_ReadRegs(buffer, 1);
+        SIM_CHECK( buffer[0] & SD16_STATUS_STATS, "window complete not signaled" );
+
+        SIM_Begin("statistics block");
+        buffer[0] = SD16_REG_STATS;
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(block, SD16_STATS_SIZE);
+        SIM_End();
+        squares = 0;
+        for (i = 0; i < 6; i++)
+        {
+            squares |= (uint64_t)block[SD16_STATS_SUM_SQUARES + i] << (8 * i);
+        }
+        SIM_CHECK( (int32_t)(block[0] | (block[1] << 8) | (block[2] << 16) | ((uint32_t)block[3] << 24)) == 30000,
+                   "wrong sum" );
+        SIM_CHECK( squares == 5ULL * 30000 * 30000, "wrong sum of squares" );
+        SIM_CHECK( (block[SD16_STATS_COUNT] | (block[SD16_STATS_COUNT + 1] << 8)) == 5, "wrong count" );
+        SIM_CHECK( (int16_t)(block[SD16_STATS_MIN] | (block[SD16_STATS_MIN + 1] << 8)) == -30000, "wrong min" );
+        SIM_CHECK( (int16_t)(block[SD16_STATS_MAX] | (block[SD16_STATS_MAX + 1] << 8)) == 30000, "wrong max" );
+
+        buffer[0] = SD16_REG_STATUS;                // block read - next window
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(buffer, 1);
+        SIM_CHECK( !(buffer[0] & SD16_STATUS_STATS), "window not restarted on read" );
+        SD16_Convert(20);
+        SD16_Convert(10);
+        buffer[0] = SD16_REG_STATS;
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(block, SD16_STATS_SIZE);
+        SIM_CHECK( (block[SD16_STATS_COUNT] == 2) && (block[SD16_STATS_SUM] == 30)
+                   && (block[SD16_STATS_MIN] == 10) && (block[SD16_STATS_MAX] == 20), "wrong second window" );
+
+        buffer[0] = SD16_REG_STATS_CTRL;
+        buffer[1] = 0;
+        I2C_WriteRegs(buffer, 2);
+    }
+
+    /* comparator - crossings both ways, hysteresis, queue, window latched until STATUS is read */
+    buffer[0] = SD16_REG_COMP_LOW;
+    buffer[1] = 100 & 0xFF;
+    buffer[2] = 100 >> 8;
+    buffer[3] = 1000 & 0xFF;
+    buffer[4] = 1000 >> 8;
+    buffer[5] = SD16_COMP_ENABLE|SD16_COMP_TRADITIONAL|SD16_COMP_QUEUE_2;
+    if ( I2C_WriteRegs(buffer, 6) == 6 )            // skipped if ENABLE_COMPARATOR is off (Nack)
+    {
+        SIM_CHECK( !(sim_P2DIR & BIT7), "ALERT driven without alert" );
+        SD16_Convert(500);
+        SD16_Convert(1500);                         // one result above HIGH - queue of 2
+        SD16_Convert(500);
+        SD16_Convert(1500);
+        SIM_CHECK( !(sim_P2DIR & BIT7), "alert before 2 consecutive results" );
+        SD16_Convert(1500);
+        SIM_CHECK( sim_P2DIR & BIT7, "rising crossing not signaled" );
+        SD16_Convert(500);                          // between LOW and HIGH - hysteresis
+        SIM_CHECK( sim_P2DIR & BIT7, "alert released inside hysteresis" );
+        buffer[0] = SD16_REG_STATUS;
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(buffer, 1);
+        SIM_CHECK( buffer[0] & SD16_STATUS_ALERT, "alert not in status" );
+        SD16_Convert(50);                           // below LOW
+        SIM_CHECK( !(sim_P2DIR & BIT7), "falling crossing not released" );
+        I2C_ReadRegs(buffer, 1);
+        SIM_CHECK( !(buffer[0] & SD16_STATUS_ALERT), "alert still in status" );
+
+        buffer[0] = SD16_REG_COMP_CTRL;
+        buffer[1] = SD16_COMP_ENABLE|SD16_COMP_WINDOW|SD16_COMP_LATCH|SD16_COMP_ACTIVE_HIGH;
+        I2C_WriteRegs(buffer, 2);
+        SIM_CHECK( sim_P2DIR & BIT7, "active high ALERT not driven low" );
+        SD16_Convert(-200);                         // below the window
+        SIM_CHECK( !(sim_P2DIR & BIT7), "window crossing (low) not signaled" );
+        SD16_Convert(500);                          // back inside - latched
+        SIM_CHECK( !(sim_P2DIR & BIT7), "latched alert released by a result" );
+        buffer[0] = SD16_REG_STATUS;
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(buffer, 1);
+        SIM_CHECK( (buffer[0] & SD16_STATUS_ALERT) && (sim_P2DIR & BIT7), "latched alert not cleared by status read" );
+        I2C_ReadRegs(buffer, 1);
+        SIM_CHECK( !(buffer[0] & SD16_STATUS_ALERT), "latched alert read twice" );
+        SD16_Convert(2000);                         // above the window
+        SIM_CHECK( !(sim_P2DIR & BIT7), "window crossing (high) not signaled" );
+
+        /* threshold written across a result - the whole old word is used */
+        buffer[0] = SD16_REG_COMP_CTRL;
+        buffer[1] = SD16_COMP_ENABLE|SD16_COMP_TRADITIONAL;
+        I2C_WriteRegs(buffer, 2);
+        SIM_CHECK( I2C_Start(simAddr, 0) && I2C_Write(SD16_REG_COMP_HIGH) && I2C_Write(1024 & 0xFF),
+                   "threshold low byte not acked" );
+        SD16_Convert(800);                          // above 0x0300 (torn), below 1000 and 1024
+        SIM_CHECK( I2C_Write(1024 >> 8), "threshold high byte not acked" );
+        I2C_Stop();
+        SIM_CHECK( !(sim_P2DIR & BIT7), "half written threshold used" );
+        SD16_Convert(1100);
+        SIM_CHECK( sim_P2DIR & BIT7, "new threshold not used" );
+
+        buffer[0] = SD16_REG_COMP_CTRL;
+        buffer[1] = 0;
+        I2C_WriteRegs(buffer, 2);
+        SIM_CHECK( !(sim_P2DIR & BIT7), "ALERT not released when disabled" );
+    }
+
+    /* drift compensation - skipped if ENABLE_DRIFT_COMPENSATION is off (Nack) */
+    {
+        const uint8_t config[] = { SD16_REG_CHCTRL_L, SD16_DF_2S_COMP,
+                                   SD16_OSR_256x|SD16_CONT_CONV|SD16_BIPOLAR,
+                                   SD16_CH1|SD16_GAIN1x, SD16_START_CONVERSION };
+
+        SIM_CHECK( I2C_WriteRegs(config, sizeof(config)) == sizeof(config), "configuration not acked" );
+    }
+    buffer[0] = SD16_REG_DRIFT_CTRL;
+    buffer[1] = SD16_DRIFT_ENABLE|SD16_DRIFT_APPLY|SD16_DRIFT_CAPTURE;
+    buffer[2] = 2;                                  // aux every 4 results
+    if ( I2C_WriteRegs(buffer, 3) == 3 )
+    {
+        uint8_t inCtrl = sim_SD16INCTL0;
+
+        buffer[0] = SD16_REG_SAMPLE_CNT;
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(buffer, 1);
+        i = buffer[0];
+        SD16_Convert(100);
+        SD16_Convert(100);
+        SD16_Convert(100);
+        SIM_CHECK( sim_SD16INCTL0 == inCtrl, "aux conversion started early" );
+        SD16_Convert(100);
+        SIM_CHECK( (sim_SD16INCTL0 & 0x07) == SD16_CH6_Temperature, "temperature conversion not started" );
+        buffer[0] = SD16_REG_IN_CTRL;
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(buffer, 1);
+        SIM_CHECK( buffer[0] == inCtrl, "main IN_CTRL not read back" );
+
+        SD16_Convert(500);                          // reference
+        SIM_CHECK( (sim_SD16INCTL0 == inCtrl) && (sim_SD16CCTL0 & SD16SC), "main channel not restarted" );
+        buffer[0] = SD16_REG_SAMPLE_CNT;
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(buffer, 1);
+        SIM_CHECK( buffer[0] == (uint8_t)(i + 4), "aux result published" );
+        buffer[0] = SD16_REG_DRIFT_CTRL;
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(buffer, 1);
+        SIM_CHECK( buffer[0] == (SD16_DRIFT_ENABLE|SD16_DRIFT_APPLY), "capture not cleared" );
+
+        buffer[0] = SD16_REG_DRIFT + SD16_DRIFT_AUX;
+        buffer[1] = 0;
+        SIM_CHECK( I2C_WriteRegs(buffer, 2) == 1, "aux result writable" );
+        buffer[0] = SD16_REG_DRIFT + SD16_DRIFT_OFFSET_COEF;
+        buffer[1] = 0x00;                           // 0.25 code per aux code
+        buffer[2] = 0x40;
+        SIM_CHECK( I2C_WriteRegs(buffer, 3) == 3, "offset coefficient not acked" );
+        for (i = 0; i < 4; i++)
+        {
+            SD16_Convert(100);
+        }
+        SD16_Convert(900);                          // +400 codes
+        SD16_Convert(100);
+        buffer[0] = SD16_REG_RESULT_L;
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(buffer, 2);
+        SIM_CHECK( (int16_t)(buffer[0] | (buffer[1] << 8)) == 200, "result not corrected" );
+        SIM_Begin("drift block");
+        buffer[0] = SD16_REG_DRIFT;
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(buffer, SD16_DRIFT_SIZE);
+        SIM_End();
+        SIM_CHECK( (buffer[SD16_DRIFT_AUX] | (buffer[SD16_DRIFT_AUX + 1] << 8)) == 900, "aux not read back" );
+        SIM_CHECK( (buffer[SD16_DRIFT_REFERENCE] | (buffer[SD16_DRIFT_REFERENCE + 1] << 8)) == 500,
+                   "reference not captured" );
+        SIM_CHECK( (buffer[SD16_DRIFT_GAIN] | (buffer[SD16_DRIFT_GAIN + 1] << 8)) == SD16_CAL_GAIN_UNITY,
+                   "gain changed" );
+
+        /* coefficient low byte only - word kept until its high byte arrives */
+        buffer[0] = SD16_REG_DRIFT + SD16_DRIFT_OFFSET_COEF;
+        buffer[1] = 0xFF;
+        SIM_CHECK( I2C_WriteRegs(buffer, 2) == 2, "offset coefficient low byte not acked" );
+        for (i = 0; (i < 8) && ((sim_SD16INCTL0 & 0x07) != SD16_CH6_Temperature); i++)
+        {
+            SD16_Convert(100);
+        }
+        SD16_Convert(900);
+        buffer[0] = SD16_REG_DRIFT + SD16_DRIFT_OFFSET;
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(buffer, 2);
+        SIM_CHECK( (int16_t)(buffer[0] | (buffer[1] << 8)) == 100, "half written coefficient used" );
+
+        buffer[0] = SD16_REG_DRIFT_INTERVAL;
+        buffer[1] = SD16_DRIFT_INTERVAL_MAX + 1;
+        SIM_CHECK( I2C_WriteRegs(buffer, 2) == 1, "interval out of range acked" );
+
+        /* single mode - compensation stops and shows it, enable Nacked */
+        buffer[0] = SD16_REG_CHCTRL_H;
+        buffer[1] = SD16_OSR_256x|SD16_SNG_CONV|SD16_BIPOLAR;
+        buffer[2] = inCtrl;
+        buffer[3] = SD16_START_CONVERSION;
+        I2C_WriteRegs(buffer, 4);
+        SD16_Convert(100);
+        SIM_CHECK( sim_SD16INCTL0 == inCtrl, "aux conversion in single mode" );
+        buffer[0] = SD16_REG_DRIFT_CTRL;
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(buffer, 1);
+        SIM_CHECK( !(buffer[0] & (SD16_DRIFT_ENABLE|SD16_DRIFT_APPLY)), "drift still on in single mode" );
+        buffer[0] = SD16_REG_DRIFT_CTRL;
+        buffer[1] = SD16_DRIFT_ENABLE;
+        SIM_CHECK( I2C_WriteRegs(buffer, 2) == 1, "drift enable acked in single mode" );
+        buffer[1] = 0;
+        I2C_WriteRegs(buffer, 2);
+
+        buffer[0] = SD16_REG_CHCTRL_H;
+        buffer[1] = SD16_OSR_256x|SD16_CONT_CONV|SD16_BIPOLAR;
+        buffer[2] = inCtrl;
+        buffer[3] = SD16_START_CONVERSION;
+        I2C_WriteRegs(buffer, 4);
+    }
+
+    /* calibration - skipped if ENABLE_CALIBRATION is off (Nack) */
+    buffer[0] = SD16_REG_CAL + SD16_CAL_GAIN;
+    buffer[1] = 0x34;                               // low byte only - gain kept
+    if ( I2C_WriteRegs(buffer, 2) == 2 )
+    {
+        const uint8_t config[] = { SD16_REG_CHCTRL_L, SD16_DF_2S_COMP,
+                                   SD16_OSR_256x|SD16_CONT_CONV|SD16_BIPOLAR,
+                                   SD16_CH1|SD16_GAIN1x, SD16_START_CONVERSION };
+        uint8_t gain;
+
+        I2C_WriteRegs(config, sizeof(config));
+        buffer[0] = SD16_REG_CAL_CTRL;
+        buffer[1] = SD16_CAL_ENABLE;
+        I2C_WriteRegs(buffer, 2);
+        SD16_Convert(1000);
+        buffer[0] = SD16_REG_RESULT_L;
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(buffer, 2);
+        SIM_CHECK( (int16_t)(buffer[0] | (buffer[1] << 8)) == 1000, "half written gain used" );
+        buffer[0] = SD16_REG_CAL + SD16_CAL_GAIN + 1;
+        buffer[1] = 0x40;                           // 0x4034 - about 0.5
+        I2C_WriteRegs(buffer, 2);
+        SD16_Convert(1000);
+        buffer[0] = SD16_REG_RESULT_L;
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(buffer, 2);
+        SIM_CHECK( (int16_t)(buffer[0] | (buffer[1] << 8)) == (1000 * 0x4034) >> 15, "gain not applied" );
+
+        /* offsets of 6 gains, 8 conversions each, stored in flash by the main loop */
+        SIM_Begin("cal measure + save");
+        buffer[0] = SD16_REG_CAL_CTRL;
+        buffer[1] = SD16_CAL_ENABLE|SD16_CAL_MEASURE|SD16_CAL_SAVE;
+        SIM_CHECK( I2C_WriteRegs(buffer, 2) == 2, "measurement not acked" );
+        SIM_CHECK( (sim_SD16INCTL0 & 0x3F) == (SD16INCH_7|SD16_GAIN1x), "offset input not selected" );
+        SIM_CHECK( (sim_SD16CCTL0 & (SD16SNGL|SD16SC)) == (SD16SNGL|SD16SC), "single conversion not started" );
+        buffer[0] = SD16_REG_IN_CTRL;
+        buffer[1] = SD16_CH2|SD16_GAIN1x;
+        SIM_CHECK( I2C_WriteRegs(buffer, 2) == 1, "configuration acked while measuring" );
+        for (gain = 0; gain < 6; gain++)
+        {
+            SIM_CHECK( ((sim_SD16INCTL0 >> 3) & 0x07) == gain, "wrong gain measured" );
+            for (i = 0; i < 8; i++)
+            {
+                SD16_Convert(10 * (gain + 1) + ((i & 1) ? 2 : -2));
+            }
+        }
+        SIM_End();
+        SIM_CHECK( (sim_SD16INCTL0 == (SD16_CH1|SD16_GAIN1x)) && !(sim_SD16CCTL0 & (SD16SNGL|SD16SC)),
+                   "configuration not restored" );
+        buffer[0] = SD16_REG_STATUS;
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(buffer, 1);
+        SIM_CHECK( buffer[0] & SD16_STATUS_CAL, "save not pending" );
+        SIM_MainLoop();
+        I2C_ReadRegs(buffer, 1);
+        SIM_CHECK( !(buffer[0] & SD16_STATUS_CAL), "save not completed" );
+        SIM_CHECK( (sim_InfoD[0] == 0x4034) && (sim_InfoD[1] == 10) && (sim_InfoD[6] == 60) && (sim_InfoD[7] == 0xCA1B),
+                   "calibration not stored" );
+
+        /* correction with the measured offset, block restored from flash */
+        buffer[0] = SD16_REG_CONVERSION;
+        buffer[1] = SD16_START_CONVERSION;
+        I2C_WriteRegs(buffer, 2);
+        SD16_Convert(1010);
+        buffer[0] = SD16_REG_RESULT_L;
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(buffer, 2);
+        SIM_CHECK( (int16_t)(buffer[0] | (buffer[1] << 8)) == (1000 * 0x4034) >> 15, "offset not applied" );
+        buffer[0] = SD16_REG_CAL + SD16_CAL_OFFSET;
+        buffer[1] = 0;
+        buffer[2] = 0;
+        I2C_WriteRegs(buffer, 3);
+        buffer[0] = SD16_REG_CAL_CTRL;
+        buffer[1] = SD16_CAL_RESTORE;
+        I2C_WriteRegs(buffer, 2);
+        buffer[0] = SD16_REG_CAL;
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(buffer, SD16_CAL_SIZE);
+        SIM_CHECK( (buffer[SD16_CAL_OFFSET] == 10) && (buffer[SD16_CAL_OFFSET + 10] == 60), "block not restored" );
+        buffer[0] = SD16_REG_CAL_CTRL;
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(buffer, 1);
+        SIM_CHECK( buffer[0] == 0, "correction not disabled" );
+    }
+
+    /* packet error check - skipped if ENABLE_PEC is off (bit not read back) */
+    buffer[0] = SD16_REG_DIAG;
+    buffer[1] = 0;
+    i = (I2C_WriteRegs(buffer, 2) == 2);            // counters cleared - ENABLE_DIAGNOSTICS
+    buffer[0] = SD16_REG_I2C_CTRL;
+    I2C_WriteRegs(buffer, 1);
+    I2C_ReadRegs(&buffer[1], 1);
+    buffer[1] |= SD16_I2C_PEC;
+    I2C_WriteRegs(buffer, 2);
+    I2C_ReadRegs(&buffer[2], 1);
+    if (buffer[2] & SD16_I2C_PEC)
+    {
+        const uint8_t config[] = { SD16_REG_CHCTRL_L, SD16_DF_2S_COMP,
+                                   SD16_OSR_256x|SD16_CONT_CONV|SD16_BIPOLAR,
+                                   SD16_CH0|SD16_GAIN1x, SD16_START_CONVERSION };
+        uint8_t diagPresent = i;
+        uint8_t ctrl = buffer[2];
+
+        SIM_Begin("pec write 4");
+        SIM_CHECK( I2C_WritePec(config, sizeof(config), 0) == 2 * sizeof(config) - 1, "PEC write not acked" );
+        SIM_End();
+        SIM_CHECK( sim_SD16INCTL0 == SD16_CH0, "PEC write not applied" );
+
+        buffer[0] = SD16_REG_IN_CTRL;
+        buffer[1] = SD16_CH2|SD16_GAIN1x;
+        SIM_CHECK( I2C_WritePec(buffer, 2, 1) == 2, "wrong PEC acked" );
+        SIM_CHECK( I2C_WriteRegs(buffer, 2) == 2, "byte without PEC not acked" );
+        SIM_CHECK( sim_SD16INCTL0 == SD16_CH0, "byte with wrong or without PEC applied" );
+        buffer[0] = SD16_IN_CTRL;
+        SIM_CHECK( I2C_WriteRegs(buffer, 1) == 0, "legacy command acked with PEC" );
+
+        SD16_Convert(1234);
+        SIM_Begin("pec read 4");
+        SIM_CHECK( I2C_ReadPec(SD16_REG_STATUS, buffer, 4, 0), "wrong read PEC" );
+        SIM_End();
+        SIM_CHECK( (int16_t)(buffer[1] | (buffer[2] << 8)) == 1234, "wrong result with PEC" );
+
+        buffer[0] = SD16_REG_I2C_CTRL;
+        buffer[1] = ctrl | SD16_I2C_PEC_WORD;
+        SIM_CHECK( I2C_WritePec(buffer, 2, 0) == 3, "PEC word mode not acked" );
+        SD16_Convert(-5);
+        SIM_Begin("pec read word 4");
+        SIM_CHECK( I2C_ReadPec(SD16_REG_STATUS, buffer, 4, 1), "wrong read PEC, word mode" );
+        SIM_End();
+        SIM_CHECK( (int16_t)(buffer[1] | (buffer[2] << 8)) == -5, "wrong result with PEC, word mode" );
+
+        if (diagPresent)
+        {
+            I2C_ReadPec(SD16_REG_DIAG + SD16_DIAG_PEC_ERROR, buffer, 2, 1);
+            SIM_CHECK( (buffer[0] | (buffer[1] << 8)) == 1, "PEC error not counted" );
+        }
+
+        buffer[0] = SD16_REG_I2C_CTRL;
+        buffer[1] = ctrl & ~SD16_I2C_PEC;
+        SIM_CHECK( I2C_WritePec(buffer, 2, 0) == 3, "PEC disable not acked" );
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(buffer, 2);
+        SIM_CHECK( buffer[0] == (ctrl & ~SD16_I2C_PEC), "PEC not disabled" );
+    }
+
+    /* sequencer single pass - slot result read from its high byte (odd start) */
+    {
+        const uint8_t slots[] = { SD16_REG_SEQ_CONFIG,
+                                  SD16_CH2|SD16_GAIN1x, SD16_OSR_256x|SD16_BIPOLAR,
+                                  SD16_CH3|SD16_GAIN1x, SD16_OSR_256x|SD16_BIPOLAR };
+        const uint8_t config[] = { SD16_REG_CHCTRL_L, SD16_DF_2S_COMP,
+                                   SD16_OSR_256x|SD16_CONT_CONV|SD16_BIPOLAR,
+                                   SD16_CH1|SD16_GAIN1x, SD16_START_CONVERSION };
+
+        buffer[0] = SD16_REG_SEQ_CTRL;
+        buffer[1] = SD16_SEQ_ENABLE|SD16_SEQ_LENGTH(2);
+        if ( (I2C_WriteRegs(slots, sizeof(slots)) == sizeof(slots)) && (I2C_WriteRegs(buffer, 2) == 2) )
+        {
+            SD16_Convert(0x1122);
+            SD16_Convert(0x3344);
+            buffer[0] = SD16_REG_SEQ_RESULT + 2;
+            I2C_WriteRegs(buffer, 1);
+            I2C_ReadRegs(buffer, 2);
+            SIM_CHECK( (buffer[0] | (buffer[1] << 8)) == 0x3344, "wrong slot 1 result" );
+            buffer[0] = SD16_REG_SEQ_RESULT + 1;
+            I2C_WriteRegs(buffer, 1);
+            I2C_ReadRegs(buffer, 3);
+            SIM_CHECK( (buffer[0] == 0x11) && (buffer[1] == 0x44) && (buffer[2] == 0x33),
+                       "read from a high byte not latched" );
+        }
+        I2C_WriteRegs(config, sizeof(config));      // back to continuous
+    }
+
+    /* diagnostic counters - skipped if ENABLE_DIAGNOSTICS is off (Nack) */
+    buffer[0] = SD16_REG_DIAG;
+    buffer[1] = 0;
+    if ( I2C_WriteRegs(buffer, 2) == 2 )
+    {
+        uint16_t diag[SD16_DIAG_SIZE / 2];
+
+        SIM_CHECK( !I2C_Start(SLAVE_ADDR + 1, 0), "other address acked" );
+        I2C_Stop();
+        buffer[0] = SD16_REG_LAST + 1;
+        I2C_WriteRegs(buffer, 1);                   // pointer Nacked
+        buffer[0] = SD16_REG_FIFO_CTRL;
+        buffer[1] = SD16_FIFO_FLUSH;
+        I2C_WriteRegs(buffer, 2);
+        buffer[0] = SD16_REG_FIFO_DATA;
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(buffer, 2);                    // empty FIFO - 2 dummy bytes
+        for (i = 0; i < SD16_FIFO_DEPTH + 2; i++)   // not read - 9 overruns, 2 dropped
+        {
+            SD16_Convert(i);
+        }
+
+        SIM_Begin("diagnostics");
+        buffer[0] = SD16_REG_DIAG;
+        I2C_WriteRegs(buffer, 1);
+        I2C_ReadRegs(buffer, SD16_DIAG_SIZE);
+        SIM_End();
+        for (i = 0; i < SD16_DIAG_SIZE / 2; i++)
+        {
+            diag[i] = buffer[2*i] | (buffer[2*i + 1] << 8);
+        }
+        SIM_CHECK( diag[SD16_DIAG_USI_ISR / 2] > 0, "USI ISR not counted" );
+        SIM_CHECK( diag[SD16_DIAG_SD16_ISR / 2] == SD16_FIFO_DEPTH + 2, "SD16 ISR not counted" );
+        SIM_CHECK( diag[SD16_DIAG_ADDR_NACK / 2] == 1, "address Nack not counted" );
+        SIM_CHECK( diag[SD16_DIAG_RX_NACK / 2] == 1, "rx Nack not counted" );
+        SIM_CHECK( diag[SD16_DIAG_DUMMY / 2] == 2, "dummy bytes not counted" );
+        SIM_CHECK( diag[SD16_DIAG_OVERRUN / 2] == SD16_FIFO_DEPTH + 1, "overrun not counted" );
+        SIM_CHECK( diag[SD16_DIAG_FIFO_OVERFLOW / 2] == 2, "FIFO overflow not counted" );
+    }
+
+    printf("\n%lu error(s) - %lu register accesses\n", (unsigned long)errors, (unsigned long)simRegAccess);
+
+    return errors ? 1 : 0;
+}
+#endif /* SIM_NO_MAIN */
@@ -0,0 +1,40 @@
+/******************************************************************************
+ * usi_sim.h - harness of usi_sim.c, for host programs built against the
+ * simulated firmware (usi_sim.c compiled with -DSIM_NO_MAIN)
+ * - one firmware instance per program, SIM_Start() once before the bus
+ * - the I2C master functions clock the bus bit by bit, as in usi_sim.c
+ *
+ * Haroldo Amaral
+ * https://github.com/agaelema/msp430f20x3_as_i2c_16bit_adc
+ ******************************************************************************/
+
+#ifndef USI_SIM_H_
+#define USI_SIM_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/******************************************************************************
+ * Prototype of functions
+ ******************************************************************************/
+void SIM_Start(void);                               // reset - firmware runs to the first sleep
+void SIM_MainLoop(void);                            // one more pass of the main loop
+uint32_t SIM_Errors(void);                          // bus phase errors seen by the harness
+
+uint8_t I2C_Start(uint8_t address, uint8_t read);   // (repeated) start + address, true if Ack
+uint8_t I2C_Write(uint8_t data);                    // true if Ack
+uint8_t I2C_Read(uint8_t ack);
+void I2C_Stop(void);
+
+void SD16_Convert(int16_t value);                   // result ready - ignored if stopped
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* USI_SIM_H_ */
@@ -1,6 +1,7 @@
 /******************************************************************************
  * SD16_A as a I2C ADC
- * - configured as Slave address 0X0B
+ * - Slave address 0X0B, or address stored in flash (SD16_REG_I2C_ADDR,
+ *   ENABLE_ADDRESS_FLASH)
  ******************************************************************************
  *
  *                MSP430F20x3
@@ -15,6 +16,8 @@
  *    Vin- -->|A1- P1.3     P1.6|- <-	I2C CLK
  *    Vin+ -->|A2+ P1.4         |
  *    Vin- -->|A2- P1.5         |
+ *            |             P2.6|-->    DRDY (open-drain, active low)
+ *            |             P2.7|-->    ALERT (open-drain, comparator)
  *            |                 |
  *
  * Haroldo Amaral - 2019
@@ -34,47 +37,374 @@
 
 /* I2C */
 #define     I2C_READ_STATUS     (1)             // Read bit - master read from slave
-#define     I2C_WRITE_STATUS    (0)             // write bit - master write to slave
 #define     I2C_ACK             (0x00)
 #define     I2C_NACK            (0xFF)
 #define     I2C_DUMMY_BYTE      (0xFF)
 
-#define     SLAVE_ADDR          (0x0B)          // slave address
-#define     RX_MAX_BYTES        (2)             // **** How many bytes?? ****
-#define     TX_MAX_BYTES        (2)             // **** How many bytes?? ****
+#ifndef     SLAVE_ADDR
+#define     SLAVE_ADDR          (0x0B)          // slave address - no address stored in flash
+#endif
+#define     GENERAL_CALL_ADDR   (0x00)          // general call - write only
+#define     LEGACY_MAX_BYTES    (2)             // legacy command - [command] [value]
+
+#define     FIFO_COUNT_MASK     (0x7F)          // fifoCount bits 0-6 - queued samples
+#define     FIFO_HIGH_READ      (2)             // fifoHighByte: high byte read ahead, sample removed when sent
+
+/*
+ * Firmware options - uncomment to add a feature
+ * - F2013 has 128 bytes of RAM (50 for stack) and 2016 bytes of flash - not
+ *   all options fit together
+ * - the defaults take about 1350 bytes of code + 500 of run-time library
+ *   (startup, shifts); flash sizes below are estimates - check the .map file
+ */
+#define     ENABLE_DRDY_PIN                     // data ready output on P2.6 - about 25 bytes flash
+//#define     ENABLE_SCAN_SEQUENCER               // multi-channel scan - 22 bytes RAM, about 400 bytes flash
+//#define     ENABLE_SD16_FILTER                  // averaging / decimation filter - 9 bytes RAM, about 350 bytes flash
+//#define     ENABLE_STATISTICS                   // windowed min/max/sum/sum of squares - 20 bytes RAM, about 500 bytes flash
+//#define     ENABLE_COMPARATOR                   // threshold comparator + ALERT on P2.7 - 7 bytes RAM, about 400 bytes flash
+//#define     ENABLE_CALIBRATION                  // offset/gain calibration stored in INFOD - 22 bytes RAM, about 1100 bytes flash
+//#define     ENABLE_FIFO_DELTA                   // delta coded FIFO read - 4 bytes RAM, about 250 bytes flash
+//#define     ENABLE_PACED_SAMPLING               // Timer_A paced single conversions - 3 bytes RAM, about 300 bytes flash
+//#define     ENABLE_DIAGNOSTICS                  // bus / converter event counters - 17 bytes RAM, about 150 bytes flash
+//#define     ENABLE_DRIFT_COMPENSATION           // interleaved temperature / supply correction - 18 bytes RAM, about 900 bytes flash
+//#define     ENABLE_PEC                          // SMBus packet error check, CRC-8 - 3 bytes RAM, about 500 bytes flash (256 table)
+//#define     ENABLE_LEGACY_COMMANDS              // 2-byte commands of the first protocol (0xA0, 0xA1, 0xB0, 0xFF) - about 120 bytes flash
+//#define     ENABLE_ADDRESS_FLASH                // slave address + I2C_CTRL stored in INFOC (SD16_REG_I2C_ADDR) - about 350 bytes flash
+//#define     ENABLE_GENERAL_CALL                 // synchronized start / stop by general call (SD16_I2C_GCALL) - about 150 bytes flash
+//#define     ENABLE_LATENCY_CONTROL              // preload, discarded results and latency report - 2 bytes RAM, about 300 bytes flash
+
+#define     DRDY_PIN            (BIT6)          // P2.6 - open-drain, low while result not read
+#define     ALERT_PIN           (BIT7)          // P2.7 - open-drain, polarity in COMP_CTRL
+#define     FILTER_MAX_SHIFT    (8)             // decimation up to 256x - 24-bit mean
+
+#ifndef     CAL_FLASH_SEGMENT
+#define     CAL_FLASH_SEGMENT   (0x1000)        // INFOD - INFOA keeps the DCO calibration
+#endif
+#ifndef     ADDR_FLASH_SEGMENT
+#define     ADDR_FLASH_SEGMENT  (0x1040)        // INFOC - slave address + SD16_I2C_GCALL
+#endif
+#define     FLASH_BLOCK_KEY     (0xCA1B)        // stored after a block - segment not erased
+#define     CAL_GAINS           (6)             // gain 1x to 32x
+#define     CAL_SAMPLES_SHIFT   (3)             // offset = mean of 8 conversions per gain
+#define     CAL_IDLE            (0xFF)          // calStep - no measurement
+#define     CAL_SAVE_PENDING    (0x40)          // calCtrl - store block after measurement
+#define     CAL_CONTINUOUS      (0x80)          // calCtrl - restore continuous mode after measurement
+
+/* delta coded FIFO read - byte sent next (fifoDeltaPhase) */
+#define     DELTA_COUNT         (0)             // FIFO count snapshot
+#define     DELTA_KEY_L         (1)             // first sample, 16 bits
+#define     DELTA_KEY_H         (2)
+#define     DELTA_TOKEN         (3)             // delta / escape / empty
+#define     DELTA_ESC_L         (4)             // full sample after escape
+#define     DELTA_ESC_H         (5)
+#define     DELTA_END           (6)             // FIFO was empty - dummy bytes
+#define     DELTA_POP           (0x80)          // fifoDeltaNext - byte completes a sample
+
+/* paced sampling - reference and buffer warm-up before each tick (about 5 ms) */
+#define     PACE_WARMUP_ACLK    (60)            // VLO ticks - about 12 kHz
+#define     PACE_WARMUP_SMCLK   (10000)         // SMCLK / 8 ticks - 2 MHz
+#define     PACE_REF_OFF        (0x80)          // paceCtrl - reference off between samples
+#define     PACE_CONTINUOUS     (0x40)          // paceCtrl - restore continuous mode when pacing stops
+#define     SD16_REF_BITS       (SD16REFON + SD16VMIDON)
+
+/*
+ * SMCLK needed by SD16 (conversion running) or Timer_A - else LPM3, the USI
+ * start condition and ACLK (VLO) keep running
+ */
+#define     SMCLK_NEEDED()      ( (SD16CCTL0 & SD16SC) || (TACTL & TASSEL_2) )
+
+/* packet error check - pecFlags: SD16_I2C_PEC / SD16_I2C_PEC_WORD latched at the first start + state */
+#define     PEC_RX_HELD         (0x10)          // data byte received - applied when its PEC matches
+#define     PEC_TX_HALF         (0x20)          // first byte of a word sent
+#define     PEC_TX_CRC          (0x40)          // byte read ahead is the PEC
+
+/* drift compensation - driftCtrl bit 7: aux conversion running, SD16INCTL0 in driftInCtrl */
+#define     DRIFT_AUX_RUNNING   (0x80)
+
+/* work deferred to main loop - mainRequest flags */
+#define     MAIN_REQ_CAL_SAVE   (0x01)          // write calibration block to flash
+#define     MAIN_REQ_ADDR_SAVE  (0x02)          // write slave address to flash
+
+#if defined (ENABLE_DRDY_PIN)
+#define     DRDY_ASSERT()       (P2DIR |= DRDY_PIN)         // drive low
+#define     DRDY_RELEASE()      (P2DIR &= ~DRDY_PIN)        // high-Z - pulled up by master
+#else
+#define     DRDY_ASSERT()
+#define     DRDY_RELEASE()
+#endif
+
+#if defined (ENABLE_DRIFT_COMPENSATION)
+#define     SD16_MAIN_INCTL()   ( (driftCtrl & DRIFT_AUX_RUNNING) ? driftInCtrl : SD16INCTL0 )
+#else
+#define     SD16_MAIN_INCTL()   (SD16INCTL0)
+#endif
+
+#if defined (ENABLE_GENERAL_CALL)
+#define     I2C_GCALL_BIT       (SD16_I2C_GCALL)
+#define     GCALL_ACTIVE()      (generalCall)
+#else
+#define     I2C_GCALL_BIT       (0)
+#define     GCALL_ACTIVE()      (false)
+#endif
+
+#if defined (ENABLE_PEC)
+#define     I2C_CTRL_BITS       (I2C_GCALL_BIT|SD16_I2C_PEC|SD16_I2C_PEC_WORD)
+#define     PEC_ACTIVE()        (pecFlags & SD16_I2C_PEC)
+#define     PEC_UPDATE(byte)    (pecCrc = pecTable[pecCrc ^ (byte)])
+#else
+#define     I2C_CTRL_BITS       (I2C_GCALL_BIT)
+#define     PEC_ACTIVE()        (false)
+#define     PEC_UPDATE(byte)
+#endif
+
+#if defined (ENABLE_LATENCY_CONTROL)
+#define     DISCARD_RESTART()   (discardCount = discardCtrl)
+#else
+#define     DISCARD_RESTART()
+#endif
+
+#if defined (ENABLE_DIAGNOSTICS)
+#define     DIAG_COUNT(counter) (diag.counter++)            // 16-bit, wraps - use differences
+#define     DIAG_DUMMY()        (txDummy = true)
+#else
+#define     DIAG_COUNT(counter)
+#define     DIAG_DUMMY()
+#endif
 
 
 /******************************************************************************
  * Variables
  ******************************************************************************/
 /* I2C */
-const uint8_t     SLV_Addr = SLAVE_ADDR << 1;   // Address is 0x48<<1 for R/W
+uint8_t     SLV_Addr = SLAVE_ADDR << 1;         // own address << 1 (R/W bit clear) - flash or default
+uint8_t     i2cCtrl = 0;                        // SD16_I2C_GCALL - answer general call
+#if defined (ENABLE_GENERAL_CALL)
+uint8_t     generalCall = false;                // transaction addressed to general call
+#endif
 uint8_t     i2c_State = 0;                      // machine state variable
-uint8_t     i2c_Direction = 0;                  // State variables
 uint8_t     rxByteCounter = 0;
-uint8_t     txByteCounter = 0;
-uint8_t     receivedData[RX_MAX_BYTES] = {0};   // store received data
+uint8_t     txNext;                             // next byte to send - read one byte ahead
+
+#if defined (ENABLE_PEC)
+/* SMBus PEC - CRC-8, polynomial 0x07: pecTable[crc ^ byte] is the CRC after the byte */
+const uint8_t     pecTable[256] =
+{
+    0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+    0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65, 0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D,
+    0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+    0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85, 0xA8, 0xAF, 0xA6, 0xA1, 0xB4, 0xB3, 0xBA, 0xBD,
+    0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2, 0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA,
+    0xB7, 0xB0, 0xB9, 0xBE, 0xAB, 0xAC, 0xA5, 0xA2, 0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+    0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32, 0x1F, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0D, 0x0A,
+    0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42, 0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A,
+    0x89, 0x8E, 0x87, 0x80, 0x95, 0x92, 0x9B, 0x9C, 0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+    0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC, 0xC1, 0xC6, 0xCF, 0xC8, 0xDD, 0xDA, 0xD3, 0xD4,
+    0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C, 0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44,
+    0x19, 0x1E, 0x17, 0x10, 0x05, 0x02, 0x0B, 0x0C, 0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+    0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B, 0x76, 0x71, 0x78, 0x7F, 0x6A, 0x6D, 0x64, 0x63,
+    0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B, 0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13,
+    0xAE, 0xA9, 0xA0, 0xA7, 0xB2, 0xB5, 0xBC, 0xBB, 0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+    0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB, 0xE6, 0xE1, 0xE8, 0xEF, 0xFA, 0xFD, 0xF4, 0xF3
+};
+uint8_t     pecCrc = 0;                         // CRC of the transaction so far
+uint8_t     pecFlags = 0;                       // SD16_I2C_PEC / _WORD of the transaction + PEC_xx
+uint8_t     pecData;                            // data byte waiting for its PEC
+#endif
+
+/* SD16AE pins (+ and -) of each channel - SD16INCH_0 to SD16INCH_7 */
+const uint8_t     sd16InputPins[8] =
+{
+    SD16AE0|SD16AE1, SD16AE2|SD16AE3, SD16AE4|SD16AE5, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+/* register interface */
+uint8_t     regPointer = SD16_REG_RESULT_L;     // last pointer written - kept between transactions
+uint8_t     regCursor = SD16_REG_RESULT_L;      // auto-incremented inside a transaction
+#if defined (ENABLE_LEGACY_COMMANDS)
+uint8_t     legacyCommand = false;              // first byte was a legacy command
+#endif
+uint8_t     statusRead = false;                 // STATUS read in the current transaction
+uint8_t     fifoHighByte = false;               // next FIFO_DATA byte is the high byte (true) / FIFO_HIGH_READ
 
 
 /* SD16 */
 volatile static int16_t    ADC_Read = 0;                        // store conversion result
+volatile uint8_t    sd16Status = 0;                             // SD16_STATUS_xx flags
+volatile uint8_t    sampleCounter = 0;                          // incremented on each new result
+#if defined (ENABLE_LATENCY_CONTROL)
+uint8_t     discardCtrl = 0;                                    // results dropped after start / configuration
+uint8_t     discardCount = 0;                                   // results still to drop
+#endif
+
+/* read snapshot - captured on address match, SD16 ISR can not change it during the read */
+int16_t     txResult;
+uint8_t     txCounter;
+uint8_t     txStatus;
+
+/* sample FIFO - filled by SD16 ISR, drained by i2c burst read */
+#define     FIFO_MASK           (SD16_FIFO_DEPTH - 1)           // depth must be power of 2
+volatile int16_t    fifoBuffer[SD16_FIFO_DEPTH];
+volatile uint8_t    fifoHead = 0;                               // next position to write
+volatile uint8_t    fifoTail = 0;                               // next position to read
+volatile uint8_t    fifoCount = 0;                              // queued samples + overflow flag
+int16_t     txSample;                                    // 16-bit read latch - FIFO sample / sequencer slot
+
+#if defined (ENABLE_FIFO_DELTA)
+uint8_t     fifoDeltaPhase;                                     // DELTA_xx - next byte of FIFO_DELTA
+uint8_t     fifoDeltaNext;                                      // phase after the byte read ahead + DELTA_POP
+int16_t     fifoDeltaRef;                                       // last sample sent - reference of next delta
+#endif
+
+volatile uint8_t    mainRequest = 0;                            // MAIN_REQ_xx - set by ISRs, done in main loop
+
+#if defined (ENABLE_SCAN_SEQUENCER)
+/* scan sequencer - one single conversion per slot, started from SD16 ISR */
+volatile uint8_t    seqCtrl = 0;                                // SD16_SEQ_xx flags + length
+volatile uint8_t    seqIndex = 0;                               // slot being converted
+uint8_t     seqConfig[2 * SD16_SEQ_SLOTS] =                     // [IN_CTRL] [CHCTRL_H] per slot
+{
+    SD16_CH0|SD16_GAIN1x,               SD16_OSR_256x|SD16_BIPOLAR,
+    SD16_CH1|SD16_GAIN1x,               SD16_OSR_256x|SD16_BIPOLAR,
+    SD16_CH2|SD16_GAIN1x,               SD16_OSR_256x|SD16_BIPOLAR,
+    SD16_CH6_Temperature|SD16_GAIN1x,   SD16_OSR_256x|SD16_BIPOLAR,
+    SD16_CH5_VCC_VSS|SD16_GAIN1x,       SD16_OSR_256x|SD16_BIPOLAR,
+};
+volatile int16_t    seqResult[SD16_SEQ_SLOTS];                  // latest result of each slot
+#endif
+
+#if defined (ENABLE_SD16_FILTER)
+/* averaging filter - boxcar decimator, mean of 2^filterShift samples */
+uint8_t     filterShift = 0;                                    // log2 decimation - 0 = off
+uint16_t    filterCount = 0;                                    // samples left in current block
+int32_t     filterSum = 0;
+#endif
+volatile uint8_t    resultFraction = 0;                         // 8 extra bits of filtered result
+uint8_t     txFraction;
+
+#if defined (ENABLE_PACED_SAMPLING)
+/* paced sampling - Timer_A up mode, CCR0 starts a conversion, CCR1 warms up the reference */
+uint16_t    pacePeriod = 0;                                     // timer ticks - 0 = off
+uint8_t     paceCtrl = 0;                                       // SD16_PACE_xx + PACE_REF_OFF/CONTINUOUS
+#endif
+
+#if defined (ENABLE_DIAGNOSTICS)
+/* diagnostic counters - register layout, LSB first */
+struct _diagnostics
+{
+    uint16_t    usiIsr;                                         // USI ISR entries
+    uint16_t    sd16Isr;                                        // SD16 ISR entries
+    uint16_t    addrNack;                                       // other address on the bus
+    uint16_t    rxNack;                                         // written bytes refused
+    uint16_t    dummyBytes;                                     // empty FIFO / unmapped register sent
+    uint16_t    resultOverrun;                                  // result replaced before read (DRDY set)
+    uint16_t    fifoOverflow;                                   // samples dropped - FIFO full
+    uint16_t    pecError;                                       // written bytes rejected - PEC mismatch
+};
+typedef struct _diagnostics diagnostics;
+
+diagnostics diag;
+uint8_t     txDummy = false;                                    // byte read ahead is a dummy byte
+#endif
+
+#if defined (ENABLE_STATISTICS)
+/* statistics block - register layout, LSB first, 32-bit fields first (no padding) */
+struct _statistics
+{
+    int32_t     sum;
+    uint32_t    sumSquaresLow;                                  // sum of squares - 48 bits
+    uint16_t    sumSquaresHigh;
+    uint16_t    count;                                          // samples in window
+    int16_t     min;
+    int16_t     max;
+};
+typedef struct _statistics statistics;
+
+statistics  stats;
+uint16_t    statsWindow = 0;                                    // samples per window - 0 = no limit
+uint8_t     statsCtrl = 0;                                      // SD16_STATS_xx flags
+uint8_t     statsHold = false;                                  // block being read - skip samples
+#endif
 
-enum _outputSelection
+#if defined (ENABLE_COMPARATOR)
+/* threshold comparator - same data format as the result */
+int16_t     compLow = 0;
+int16_t     compHigh = 0;
+uint8_t     compCtrl = 0;                                       // SD16_COMP_xx flags
+uint8_t     compCount = 0;                                      // consecutive results beyond threshold
+uint8_t     compWriteLow;                                       // threshold write - low byte until the high byte
+#endif
+
+#if defined (ENABLE_CALIBRATION)
+/* calibration block - register layout, working copy of the flash segment */
+struct _calibration
 {
-    out_MEM0 = 0,                               // SD16MEM0
+    uint16_t    gain;                                           // Q15 - 0x8000 = 1.0
+    int16_t     offset[CAL_GAINS];                              // 2's complement, per gain
 };
-typedef enum _outputSelection outputSelection;
+typedef struct _calibration calibration;
+
+calibration cal;
+uint8_t     calCtrl = 0;                                        // SD16_CAL_ENABLE + CAL_xx flags
+uint8_t     calStep = CAL_IDLE;                                 // offset measurement - gain * 8 + conversion
+uint8_t     calInCtrl;                                          // SD16INCTL0 restored after measurement
+uint8_t     calWriteLow;                                        // block write - low byte until the high byte
+int32_t     calSum;
+#endif
 
-outputSelection TXdataSelection = out_MEM0;
-int16_t     *transmittedValue;                           // pointer to transmitted result - era dataPTR
+#if defined (ENABLE_DRIFT_COMPENSATION)
+/* drift compensation block - register layout, LSB first */
+struct _drift
+{
+    int16_t     aux;                                            // last temperature / supply result
+    int16_t     reference;                                      // aux without correction
+    int16_t     gainCoef;                                       // 2^-31 gain per aux code
+    int16_t     offsetCoef;                                     // 1/65536 code per aux code
+    uint16_t    gain;                                           // Q15 - in use
+    int16_t     offset;                                         // codes - in use
+};
+typedef struct _drift drift_t;
+
+drift_t     drift = { 0, 0, 0, 0, SD16_CAL_GAIN_UNITY, 0 };
+uint8_t     driftCtrl = 0;                                      // SD16_DRIFT_xx + DRIFT_AUX_RUNNING
+uint8_t     driftInterval = 0;                                  // log2 of results between aux conversions
+uint16_t    driftCountdown = 1;                                 // results to next aux conversion
+uint8_t     driftInCtrl;                                        // main SD16INCTL0 during aux conversion
+uint8_t     driftWriteLow;                                      // block write - low byte until the high byte
+#endif
 
 
 /******************************************************************************
  * Prototype of functions
  ******************************************************************************/
-void Data_RX(void);
-void TX_Data(uint8_t data);
 void Setup_USI_Slave(void);
+void FIFO_Push(int16_t sample);
+void FIFO_Flush(void);
+uint8_t FIFO_DeltaRead(void);
+uint8_t REG_Read(uint8_t address);
+void REG_Commit(uint8_t address);
+uint8_t REG_Write(uint8_t address, uint8_t value);
+void SD16_SelectInputs(void);
+uint16_t SD16_Latency(void);
+void SEQ_LoadSlot(uint8_t slot);
+uint8_t SEQ_Length(void);
+void FILTER_Reset(void);
+void STATS_Update(int16_t sample);
+void STATS_Reset(void);
+void COMP_Update(int16_t sample);
+void COMP_SetAlert(uint8_t alert);
+int16_t CAL_Apply(int16_t sample);
+void CAL_StartMeasure(void);
+uint8_t CAL_Measure(int16_t sample);
+void CAL_Load(void);
+int16_t DRIFT_Apply(int16_t sample);
+void DRIFT_StartAux(void);
+void DRIFT_Restore(void);
+void DRIFT_Update(int16_t aux);
+uint8_t GCALL_Command(uint8_t command);
+void ADDR_Load(void);
+void ADDR_Save(void);
+void FLASH_Write(uint16_t *segment, const uint16_t *data, uint8_t words);
+void PACE_Setup(void);
 
 
 
@@ -88,19 +418,27 @@ int main(void)
     DCOCTL = 0;
     BCSCTL1 = CALBC1_16MHZ;
     DCOCTL = CALDCO_16MHZ;
+    BCSCTL3 = LFXT1S_2;                       // ACLK from VLO - XIN/XOUT used as DRDY/ALERT
 
+#if defined (ENABLE_ADDRESS_FLASH)
+    ADDR_Load();                // slave address and general call from flash
+#endif
+#if defined (ENABLE_PEC)
+    pecFlags = i2cCtrl & (SD16_I2C_PEC|SD16_I2C_PEC_WORD);     // framing of the first transaction
+#endif
     Setup_USI_Slave();
 
     /******************************************************************************
      * SD16 default configuration
      * - SD16 clock to 1MHz - SMCLK
      * - 2's format, OSR 1024x, single conversion, differential mode
+     * - result always read inside SD16 ISR (single and continuous)
      * - Channel 1, gain 1x, 4 conversion delay
      ******************************************************************************/
     /* 1.2V ref, SMCLK, div 1x, xdiv 16x */
     SD16CTL = SD16REFON | SD16SSEL_1 | SD16DIV_0 | SD16XDIV_2;
     /* 2's format, 1024 OSR, single conv, differential */
-    SD16CCTL0 =  SD16DF | SD16OSR_1024 | SD16SNGL;
+    SD16CCTL0 =  SD16DF | SD16OSR_1024 | SD16SNGL | SD16IE;
     /* A1 +, gain 1x, interrupt after fourth sample */
     SD16INCTL0 = SD16INCH_1 | SD16GAIN_1 | SD16INTDLY_0;
     /* A1+ = P1.2, A1- = P1.3 */
@@ -111,11 +449,54 @@ int main(void)
 
     P2SEL = 0x00;               // pins 6-7 as in/out - primary function
     P2DIR = 0x00;               // configure as input
+    P2OUT = 0x00;               // DRDY low level when pin is output
+
+#if defined (ENABLE_CALIBRATION)
+    CAL_Load();                 // coefficients from flash - correction off until enabled
+#endif
+
+    /*
+     * sleep until an ISR requests work that can not run in interrupt context
+     * - requests checked with interrupts disabled, GIE set with the LPM bits
+     * - LPM3 while SMCLK is not used - ISRs starting a conversion clear SCG1
+     */
+    while (1)
+    {
+        __disable_interrupt();
+#if defined (ENABLE_PACED_SAMPLING)
+        _BIC_SR(SCG1);                  // may be set on exit of SD16 ISR while awake
+#endif
+        if ( !mainRequest )
+        {
+            if ( SMCLK_NEEDED() )
+            {
+                _BIS_SR(LPM1_bits + GIE);   // enable LPM and General Interruption
+            }
+            else
+            {
+                _BIS_SR(LPM3_bits + GIE);
+            }
+            __no_operation();
+        }
+        __enable_interrupt();
 
-    transmittedValue = (int16_t *)&ADC_Read;     // point to ADC_Read variable
+#if defined (ENABLE_CALIBRATION)
+        if (mainRequest & MAIN_REQ_CAL_SAVE)
+        {
+            FLASH_Write((uint16_t *)CAL_FLASH_SEGMENT, (const uint16_t *)&cal, sizeof(cal) / 2);
+            mainRequest &= ~MAIN_REQ_CAL_SAVE;
+            sd16Status &= ~SD16_STATUS_CAL;
+        }
+#endif
 
-    _BIS_SR(LPM1_bits + GIE);           // enable LPM and General Interruption
-    __no_operation();
+#if defined (ENABLE_ADDRESS_FLASH)
+        if (mainRequest & MAIN_REQ_ADDR_SAVE)
+        {
+            ADDR_Save();
+            mainRequest &= ~MAIN_REQ_ADDR_SAVE;
+        }
+#endif
+    }
 }
 
 
@@ -131,14 +512,282 @@ void __attribute__ ((interrupt(SD16_VECTOR))) SD16_ISR (void)
 #error Compiler not supported!
 #endif
 {
-    ADC_Read = SD16MEM0;
+    int16_t sample;
+
+    DIAG_COUNT(sd16Isr);
+
+#if defined (ENABLE_CALIBRATION)
+    /*
+     * offset measurement - results are not published
+     */
+    if (calStep != CAL_IDLE)
+    {
+        if ( CAL_Measure(SD16MEM0) && mainRequest )
+        {
+            __bic_SR_register_on_exit(LPM3_bits);   // wake main loop - store block
+        }
+        return;
+    }
+#endif
+
+#if defined (ENABLE_DRIFT_COMPENSATION)
+    /*
+     * temperature / supply conversion - not published, main channel restarted
+     */
+    if (driftCtrl & DRIFT_AUX_RUNNING)
+    {
+        DRIFT_Update(SD16MEM0);
+        return;
+    }
+#endif
+
+#if defined (ENABLE_PACED_SAMPLING)
+    if ( (paceCtrl & SD16_PACE_ENABLE) && !(paceCtrl & SD16_PACE_SMCLK) )
+    {
+        __bis_SR_register_on_exit(SCG1);    // conversion done - back to LPM3
+    }
+#endif
+
+#if defined (ENABLE_SCAN_SEQUENCER)
+    /*
+     * scan sequencer - store slot result and start next slot
+     */
+    if (seqCtrl & SD16_SEQ_ENABLE)
+    {
+#if defined (ENABLE_CALIBRATION)
+        seqResult[seqIndex] = CAL_Apply(SD16MEM0);      // slot configuration still loaded
+#else
+        seqResult[seqIndex] = SD16MEM0;     // reading SD16MEM0 clears SD16IFG
+#endif
+        seqIndex++;
+
+        if (seqIndex >= SEQ_Length())       // pass complete - all slots updated
+        {
+            seqIndex = 0;
+
+            if (sd16Status & SD16_STATUS_DRDY)
+            {
+                DIAG_COUNT(resultOverrun);
+            }
+            sampleCounter++;
+            sd16Status |= SD16_STATUS_DRDY;
+            DRDY_ASSERT();
+
+            if ( !(seqCtrl & SD16_SEQ_LOOP) )   // single pass - stop
+            {
+                seqCtrl &= ~SD16_SEQ_ENABLE;
+                return;
+            }
+#if defined (ENABLE_PACED_SAMPLING)
+            if (paceCtrl & SD16_PACE_ENABLE)    // next pass on next tick
+            {
+                if (paceCtrl & PACE_REF_OFF)
+                {
+                    SD16CTL &= ~SD16_REF_BITS;
+                }
+                return;
+            }
+#endif
+        }
+
+        SEQ_LoadSlot(seqIndex);
+        SD16CCTL0 |= SD16SC;                // start next slot
+#if defined (ENABLE_PACED_SAMPLING)
+        __bic_SR_register_on_exit(SCG1);    // SMCLK for the next slot
+#endif
+        return;
+    }
+#endif
+
+    sample = SD16MEM0;                      // reading SD16MEM0 clears SD16IFG
+
+#if defined (ENABLE_LATENCY_CONTROL)
+    if (discardCount)                       // input or filter not settled - drop
+    {
+        discardCount--;
+        if (SD16CCTL0 & SD16SNGL)
+        {
+            SD16CCTL0 |= SD16SC;            // single conversion - convert again
+#if defined (ENABLE_PACED_SAMPLING)
+            __bic_SR_register_on_exit(SCG1);
+#endif
+        }
+        return;
+    }
+#endif
+
+#if defined (ENABLE_PACED_SAMPLING)
+    if (paceCtrl & PACE_REF_OFF)
+    {
+        SD16CTL &= ~SD16_REF_BITS;          // until warm-up before next tick
+    }
+#endif
+
+#if defined (ENABLE_CALIBRATION)
+    sample = CAL_Apply(sample);
+#endif
+
+#if defined (ENABLE_DRIFT_COMPENSATION)
+    if ( (driftCtrl & SD16_DRIFT_ENABLE) && (SD16CCTL0 & SD16SNGL) )
+    {
+        driftCtrl &= ~(SD16_DRIFT_ENABLE|SD16_DRIFT_APPLY|SD16_DRIFT_CAPTURE);     // single mode - off
+    }
+    sample = DRIFT_Apply(sample);
+    if ( (driftCtrl & SD16_DRIFT_ENABLE) && (--driftCountdown == 0) )
+    {
+        DRIFT_StartAux();                   // next conversion - SD16INCTL0 not used below
+    }
+#endif
+
+#if defined (ENABLE_SD16_FILTER)
+    /*
+     * averaging filter - accumulate, publish one result per block
+     * - offset binary converted to 2's complement to sum (MSB flipped)
+     * - result = sum * 256 / N: 16-bit mean + 8 fraction bits
+     */
+    if (filterShift)
+    {
+        uint8_t shift;
+
+        if ( !(SD16CCTL0 & SD16DF) )
+        {
+            sample ^= 0x8000;
+        }
+        filterSum += sample;
+
+        if (--filterCount)                  // block not complete
+        {
+            return;
+        }
+
+        for (shift = filterShift; shift < FILTER_MAX_SHIFT; shift++)
+        {
+            filterSum += filterSum;         // scale to 2^8 samples
+        }
+
+        sample = (int16_t)(filterSum >> 8);
+        resultFraction = filterSum & 0xFF;
+        if ( !(SD16CCTL0 & SD16DF) )
+        {
+            sample ^= 0x8000;
+        }
+
+        FILTER_Reset();
+    }
+    else
+    {
+        resultFraction = 0;
+    }
+#endif
+
+    ADC_Read = sample;
+    FIFO_Push(ADC_Read);
+    sampleCounter++;
+
+#if defined (ENABLE_STATISTICS)
+    STATS_Update(sample);
+#endif
+#if defined (ENABLE_COMPARATOR)
+    COMP_Update(sample);
+#endif
+
+    if (sd16Status & SD16_STATUS_DRDY)      // previous result not read
+    {
+        DIAG_COUNT(resultOverrun);
+    }
+    sd16Status |= SD16_STATUS_DRDY;         // new result available
+    DRDY_ASSERT();
+}
+
+
+#if defined (ENABLE_PACED_SAMPLING)
+/******************************************************************************
+ * Timer_A CCR0 - paced sampling tick
+ * - one single conversion (or sequencer pass) per period, tick skipped if
+ *   the previous one is still running
+ ******************************************************************************/
+#if defined(__TI_COMPILER_VERSION__) || defined(__IAR_SYSTEMS_ICC__)
+#pragma vector = TIMERA0_VECTOR
+__interrupt void TIMERA0_ISR (void)
+#elif defined(__GNUC__)
+void __attribute__ ((interrupt(TIMERA0_VECTOR))) TIMERA0_ISR (void)
+#else
+#error Compiler not supported!
+#endif
+{
+    if ( !(SD16CCTL0 & SD16SC) )
+    {
+        SD16CTL |= SD16_REF_BITS;           // already on after warm-up (CCR1)
+#if defined (ENABLE_SCAN_SEQUENCER)
+        if (seqCtrl & SD16_SEQ_ENABLE)      // pass from slot 0
+        {
+            seqIndex = 0;
+            SEQ_LoadSlot(0);
+        }
+#endif
+        SD16CCTL0 |= SD16SC;
+        __bic_SR_register_on_exit(SCG1);    // SMCLK for the SD16 - LPM3 to LPM1
+    }
+}
+
+
+/******************************************************************************
+ * Timer_A CCR1 - reference and buffer on, PACE_WARMUP_xx ticks before CCR0
+ ******************************************************************************/
+#if defined(__TI_COMPILER_VERSION__) || defined(__IAR_SYSTEMS_ICC__)
+#pragma vector = TIMERA1_VECTOR
+__interrupt void TIMERA1_ISR (void)
+#elif defined(__GNUC__)
+void __attribute__ ((interrupt(TIMERA1_VECTOR))) TIMERA1_ISR (void)
+#else
+#error Compiler not supported!
+#endif
+{
+    if (TAIV == TAIV_TACCR1)                // reading TAIV clears the flag
+    {
+        SD16CTL |= SD16_REF_BITS;
+    }
 }
+#endif
 
 
 /******************************************************************************
  * USI interrupt service routine
  * - Rx bytes from master: State 2->4->6->8
  * - Tx bytes to Master: State 2->4->10->12->14
+ * - write: [pointer] [data] [data] ... - data written from pointer, auto-increment
+ * - read: data read from last pointer, auto-increment
+ * - legacy command (pointer >= 0x80, if enabled): [command] [value], read
+ *   pointer back to result
+ * - general call (address 0x00, if enabled): [command] - see GCALL_Command
+ * - with PEC (ENABLE_PEC, SD16_I2C_PEC): a PEC byte after each data byte
+ *   written and after each byte / word read - see sd16_header.h. The CRC
+ *   is one table lookup per byte (about 6 cycles), a stop is seen at the
+ *   next start (USISTP)
+ *
+ * SCL is held low from the end of each byte/(N)Ack phase until USICNT is
+ * reloaded (USIIFG cleared by the reload - USIIFGCC = 0), so every state
+ * reloads the counter first and does its bookkeeping while the bus runs.
+ * Tx bytes are read one byte ahead (REG_Read, no side effects) while the
+ * previous byte is shifted out, side effects applied once sent (REG_Commit).
+ *
+ * Estimated cycles at 16 MHz, from the interrupt request. Entry is 31
+ * cycles: accept 6 + push R12-R15 12 + start check 6 + dispatch 7.
+ *
+ *   state                   SCL released    total
+ *   2   start, rx address        42           52
+ *   4   address (N)Ack           59           75 write / ~300 read (first byte)
+ *   6   rx byte                  43           49
+ *   8   data (N)Ack              -            ~90 pointer / ~250 register write
+ *   10  tx byte                  49           ~230 (commit + next byte)
+ *   12  rx (N)Ack                43           49
+ *   14  Ack -> tx byte           55           as state 10
+ *
+ * At 400 kHz SCL is low for 1.3 us (21 cycles), so each phase stretches SCL
+ * by about 2 us - 9 bits take about 27 us instead of 22.5 us. There is no
+ * stretching up to about 150 kHz. Work after the release that is longer
+ * than the next phase (1 bit after state 4, 8 bits after state 10) delays
+ * the next state. See Host/usi_sim for the count per transaction.
  ******************************************************************************/
 #if defined(__TI_COMPILER_VERSION__) || defined(__IAR_SYSTEMS_ICC__)
 #pragma vector = USI_VECTOR
@@ -149,8 +798,8 @@ void __attribute__ ((interrupt(USI_VECTOR))) USI_TXRX_ISR (void)
 #error Compiler not supported!
 #endif
 {
-    uint16_t I2C_RW_Bit = 0;                // store i2c direction - read/write
-    int16_t txData;                         // temporary save tx value
+    uint8_t data;                           // received address / byte
+    uint8_t ackData;                        // received byte accepted?
 
     /******************************************************************************
      * start condition received?
@@ -161,7 +810,31 @@ void __attribute__ ((interrupt(USI_VECTOR))) USI_TXRX_ISR (void)
         i2c_State = 2;                      // Enter 1st state on start
 
         rxByteCounter = 0;
-        txByteCounter = 0;
+
+        regCursor = regPointer;             // auto-increment restarts from pointer
+#if defined (ENABLE_LEGACY_COMMANDS)
+        legacyCommand = false;
+#endif
+#if defined (ENABLE_GENERAL_CALL)
+        generalCall = false;
+#endif
+        statusRead = false;
+        fifoHighByte = false;
+#if defined (ENABLE_FIFO_DELTA)
+        fifoDeltaPhase = DELTA_COUNT;       // delta stream restarts with count and key sample
+#endif
+#if defined (ENABLE_STATISTICS)
+        statsHold = false;                  // previous read of statistics finished
+#endif
+#if defined (ENABLE_PEC)
+        pecFlags &= ~PEC_RX_HELD;           // byte without PEC - dropped
+        if (USICTL1 & USISTP)               // stop since last start - new transaction
+        {
+            USICTL1 &= ~USISTP;
+            pecCrc = 0;
+            pecFlags = i2cCtrl & (SD16_I2C_PEC|SD16_I2C_PEC_WORD);
+        }
+#endif
     }
 
     /******************************************************************************
@@ -170,6 +843,7 @@ void __attribute__ ((interrupt(USI_VECTOR))) USI_TXRX_ISR (void)
     switch( __even_in_range(i2c_State, 16) )
     {
     case 0:                                 // Idle, should not get here
+        USICTL1 &= ~USIIFG;
         break;
 
     case 2:
@@ -179,233 +853,250 @@ void __attribute__ ((interrupt(USI_VECTOR))) USI_TXRX_ISR (void)
         break;
 
     case 4:
-        I2C_RW_Bit = (USISRL & 0x01);       // save i2c direction - rx/tx
-
-        if (I2C_RW_Bit == I2C_READ_STATUS)
-        {
-            i2c_Direction = I2C_READ_STATUS;
-        }
-        else
-        {
-            i2c_Direction = I2C_WRITE_STATUS;
-        }
-
+        data = USISRL;
         USICTL0 |= USIOE;                   // SDA = output
+        PEC_UPDATE(data);                   // used only if the address matches
 
         /* check if slave address match */
-        if ( USISRL == (SLV_Addr|I2C_RW_Bit) )
+        if ( (data & 0xFE) == SLV_Addr )
         {
             USISRL = I2C_ACK;               // load Ack on shift register
+            USICNT |= 0x01;                 // send Ack bit - SCL released
 
-            /*
-             * Select next state based on i2c direction (rx/tx)
-             */
-            if (i2c_Direction == I2C_WRITE_STATUS)
+            if (data & I2C_READ_STATUS)     // master reads
             {
-                i2c_State = 6;
+                i2c_State = 10;
+
+                txResult = ADC_Read;        // snapshot - result, counter and status match
+                txFraction = resultFraction;
+                txCounter = sampleCounter;
+                txStatus = sd16Status;
+#if defined (ENABLE_PEC)
+                pecFlags &= ~(PEC_TX_HALF|PEC_TX_CRC);
+#endif
+
+                txNext = REG_Read(regCursor);   // first byte, while Ack is clocked
             }
-            if (i2c_Direction == I2C_READ_STATUS)
+            else
             {
-                i2c_State = 10;
+                i2c_State = 6;
             }
         }
+#if defined (ENABLE_GENERAL_CALL)
+        else if ( (data == GENERAL_CALL_ADDR) && (i2cCtrl & SD16_I2C_GCALL) )
+        {
+            USISRL = I2C_ACK;               // general call - receive command byte
+            USICNT |= 0x01;
+            i2c_State = 6;
+            generalCall = true;
+        }
+#endif
         else                                // if address not match
         {
             USISRL = I2C_NACK;              // load Nack on shift register
+            USICNT |= 0x01;                 // send Nack bit
 
             i2c_State = 16;                 // next state: prep for next Start
+            DIAG_COUNT(addrNack);
         }
-
-        USICNT |= 0x01;                     // update USI counter - send (N)Ack bit
         break;
 
     case 6:
-        Data_RX();                          // Receive data byte
+        USICTL0 &= ~USIOE;                  // SDA = input
+        USICNT |= 0x08;                     // receive byte - SCL released
         i2c_State = 8;                      // next state: Test data and (N)Ack
         break;
 
     case 8:
+        data = USISRL;
         USICTL0 |= USIOE;                   // SDA = output
 
+#if defined (ENABLE_PEC)
         /*
-         * receive data and save on buffer
-         */
-        if (rxByteCounter < RX_MAX_BYTES)   // check rx counter limit
-        {
-            receivedData[rxByteCounter] = USISRL;   // save byte on buffer
-        }
-        else;
-
-        rxByteCounter++;
-
-        /*
-         * if all bytes were received, process data
+         * data / command byte held until the next one, its PEC: the CRC of
+         * the transaction including a correct PEC is 0
          */
-        if (rxByteCounter >= RX_MAX_BYTES)
+        if ( PEC_ACTIVE() )
         {
-            uint8_t configuration_changed = false;
+            PEC_UPDATE(data);
 
-            /*
-             * compare first byte - function identifier
-             */
-            if (receivedData[0] == SD16_CHCTRL_LOW)         // 0xA0 -> SD16CCTL0 Low byte - 0 to 7
+            if ( (rxByteCounter != 0) || GCALL_ACTIVE() )
             {
-                if ( (SD16CCTL0 & BIT4) != (receivedData[1] & BIT4) )
+                if ( !(pecFlags & PEC_RX_HELD) )
                 {
-                    SD16CCTL0 &= ~BIT4;                         // clear data format bit - BIT4
-                    SD16CCTL0 |= (receivedData[1] & BIT4);      // save data format value
-                    configuration_changed = true;
-                }
-                else;
-            }
-            else if (receivedData[0] == SD16_CHCTRL_HIGH)   // 0xA1 -> SD16CCTL0 High byte - 8 to 15
-            {
-                if ( ((SD16CCTL0>>8) & (BIT0+BIT1+BIT2+BIT3+BIT4)) != (receivedData[1] & (BIT0+BIT1+BIT2+BIT3+BIT4)) )
-                {
-                    SD16CCTL0 &= ~((BIT0+BIT1+BIT2+BIT3+BIT4) << 8);    // clear bits 8-12
-                    SD16CCTL0 |= (receivedData[1] & (BIT0+BIT1+BIT2+BIT3+BIT4)) << 8;     // save received values
-                    configuration_changed = true;
-
-                    if ( (SD16CCTL0 & SD16SNGL) )       // if single conversion
-                    {
-                        SD16CCTL0 &= ~SD16IE;           // disable interruption
-                    }
-                    else                                // if continuous conversion
-                    {
-                        SD16CCTL0 |= SD16IE;            // enable interruption
-                    }
+                    pecFlags |= PEC_RX_HELD;
+                    pecData = data;
+
+                    USISRL = I2C_ACK;
+                    USICNT |= 0x01;                 // send Ack bit
+                    i2c_State = 6;                  // receive its PEC
+                    break;
                 }
-            }
-            else if (receivedData[0] == SD16_IN_CTRL)       // 0xB0 -> SD16INCTL0
-            {
-                if ( SD16INCTL0 != receivedData[1])
+
+                pecFlags &= ~PEC_RX_HELD;
+                if (pecCrc != 0)                    // rejected - rest of the transaction ignored
                 {
-                    SD16INCTL0 = 0x00;
-                    SD16INCTL0 = (receivedData[1] & 0xFF);
-                    configuration_changed = true;
+                    USISRL = I2C_NACK;
+                    USICTL0 &= ~USIOE;              // SDA = input
+                    USICTL1 &= ~USIIFG;             // release SCL - SDA left high (Nack)
+                    i2c_State = 0;
+
+                    DIAG_COUNT(pecError);
+                    DIAG_COUNT(rxNack);
+                    break;
                 }
+                data = pecData;                     // checked - written as without PEC
             }
-            else if (receivedData[0] == SD16_CONVERSION)        // 0xFF -> SD16CCTL0 Low byte
+        }
+#endif
+
+#if defined (ENABLE_GENERAL_CALL)
+        if (generalCall)                    // general call - [command], pointer not changed
+        {
+            ackData = (rxByteCounter == 0) && GCALL_Command(data);
+        }
+        else
+#endif
+        if (rxByteCounter == 0)             // first byte - register pointer or legacy command
+        {
+            ackData = true;
+
+#if defined (ENABLE_LEGACY_COMMANDS)
+            if ( (data & SD16_LEGACY_CMD) && !PEC_ACTIVE() )    // legacy command: 0xA0, 0xA1, 0xB0, 0xFF
             {
-                if (receivedData[1] & SD16_START_CONVERSION)    // if start conversion received
+                legacyCommand = true;
+                regPointer = SD16_REG_RESULT_L;     // next read returns the result
+
+                if (data == SD16_CHCTRL_LOW)
                 {
-                    if ( (SD16CCTL0 & SD16SNGL) )               // if single conversion mode
-                    {
-                        SD16CCTL0 |= SD16SC;                    // set bit to start the conversion
-                        while ( (SD16CCTL0 & SD16IFG) != SD16IFG ); // pooling the flag
-
-                        ADC_Read = SD16MEM0;                    // store conversion
-                        transmittedValue = (int16_t *)&ADC_Read;
-                    }
-                    else                                        // if continuous mode
-                    {
-                        SD16CCTL0 |= SD16SC;                    // set bit to start the conversion
-
-                        /* reading process inside SD16 ISR */
-
-                        transmittedValue = (int16_t *)&ADC_Read;
-                    }
+                    regCursor = SD16_REG_CHCTRL_L;
                 }
-                else                                            // if stop condition
+                else if (data == SD16_CHCTRL_HIGH)
                 {
-                    SD16CCTL0 &= ~SD16SC;                       // clear bit to stop conversion
+                    regCursor = SD16_REG_CHCTRL_H;
                 }
-            }
-            else;
-
-            /*
-             * configure SD16AE based on the last changes
-             */
-            if (configuration_changed)
-            {
-                /*
-                 * check the selected channel and connect to external pins
-                 */
-                if ( (SD16INCTL0 & 0x07) == SD16INCH_0 )        // mask and compare - channel 0
+                else if (data == SD16_IN_CTRL)
                 {
-                    if ( SD16CCTL0 & SD16UNI )                  // if single-ended input
-                    {
-                        SD16AE = SD16AE0;                       // connect + input to pin
-                    }
-                    else                                        // if differential input
-                    {
-                        SD16AE = SD16AE0|SD16AE1;               // connect + and - to pin
-                    }
+                    regCursor = SD16_REG_IN_CTRL;
                 }
-                else if ( (SD16INCTL0 & 0x07) == SD16INCH_1 )
+                else if (data == SD16_CONVERSION)
                 {
-                    if ( SD16CCTL0 & SD16UNI )
-                    {
-                        SD16AE = SD16AE2;
-                    }
-                    else
-                    {
-                        SD16AE = SD16AE2|SD16AE3;
-                    }
+                    regCursor = SD16_REG_CONVERSION;
                 }
-                else if ( (SD16INCTL0 & 0x07) == SD16INCH_2 )
+                else                                // unknown command
                 {
-                    if ( SD16CCTL0 & SD16UNI )
-                    {
-                        SD16AE = SD16AE4;
-                    }
-                    else
-                    {
-                        SD16AE = SD16AE4|SD16AE5;
-                    }
+                    ackData = false;
                 }
-                else
-                {
-                    SD16AE = 0x00;
-                }
-
             }
+            else
+#endif
+            if (data <= SD16_REG_LAST)
+            {
+                regPointer = data;
+                regCursor = data;
+            }
+            else                                    // pointer out of register map
+            {
+                ackData = false;
+            }
+        }
+        else                                /* data byte - write and move to next register */
+        {
+            ackData = REG_Write(regCursor, data);
+            regCursor++;
+        }
+
+        rxByteCounter++;
 
-            /* clear buffer */
-            receivedData[0] = 0;
-            receivedData[1] = 0;
+        if ( !ackData )
+        {
+            DIAG_COUNT(rxNack);                     // refused - not the end of a legacy command
+        }
+#if defined (ENABLE_LEGACY_COMMANDS)
+        if (legacyCommand && (rxByteCounter >= LEGACY_MAX_BYTES))
+        {
+            ackData = false;                        // legacy command complete
         }
+#endif
 
         /*
-         * check number of received bytes
-         * - return Ack or Nack
+         * return Ack or Nack
          */
-        if (rxByteCounter < (RX_MAX_BYTES))         // If inside the limit
+        if (ackData)                                // byte accepted
         {
             USISRL = I2C_ACK;                       // load Ack on shift register
             USICNT |= 0x01;                         // load USI counter - send (N)Ack bit
 
             i2c_State = 6;                          // Rcv another byte
         }
-        else                                        // if all bytes received
+        else                                        // end of command or invalid register
         {
             USISRL = I2C_NACK;                      // load NAck on shift register
             USICTL0 &= ~USIOE;                      // SDA = input
+            USICTL1 &= ~USIIFG;                     // release SCL - SDA left high (Nack)
 
             i2c_State = 0;                          // Reset state machine
         }
 
+        if ( SMCLK_NEEDED() )                       // conversion or SMCLK timer started
+        {
+            __bic_SR_register_on_exit(SCG1);        // LPM3 to LPM1
+        }
         break;
 
+    case 14:                                    // Process (N)Ack
+        if ( USISRL & 0x01 )                    // If Nack received from master - stop transmission
+        {
+            USICTL0 &= ~USIOE;                  // SDA = input
+            USICTL1 &= ~USIIFG;
+
+            i2c_State = 0;                      // Reset state machine
+            break;
+        }
+        /* fall through - Ack received, tx next byte */
+
     case 10:
-        /* goto label - return point after send a byte */
-        i2cTxLabel:
+        USICTL0 |= USIOE;                       // SDA = output
+        USISRL = txNext;                        // byte read in previous state
+        USICNT |= 0x08;                         // send byte - SCL released
+        i2c_State = 12;                         // Go to next state: receive (N)Ack from master
 
-        if (txByteCounter < TX_MAX_BYTES)       // verify if tx counter is within the limits
+#if defined (ENABLE_PEC)
+        if ( PEC_ACTIVE() )
         {
-            txData = *transmittedValue;
-            txData = (txData >> (8 * txByteCounter)) & 0xFF;
-            TX_Data(txData);
-
-            txByteCounter++;
+            PEC_UPDATE(txNext);
+            if (pecFlags & PEC_TX_CRC)          // PEC sent (CRC now 0) - next group
+            {
+                pecFlags &= ~PEC_TX_CRC;
+                txNext = REG_Read(regCursor);
+                break;
+            }
         }
-        else                                    // if all bytes have been sent
+#endif
+
+        REG_Commit(regCursor);                  // byte sent - FIFO pop, DRDY clear ...
+        if ( (regCursor != SD16_REG_FIFO_DATA) && (regCursor != SD16_REG_FIFO_DELTA) )  // FIFO ports do not increment
         {
-            TX_Data( I2C_DUMMY_BYTE);           // send dummy data "0xFF"
+            regCursor++;
         }
 
-    i2c_State = 12;                         // Go to next state: receive (N)Ack from master
-    break;
+#if defined (ENABLE_PEC)
+        if ( PEC_ACTIVE() )
+        {
+            if (pecFlags & SD16_I2C_PEC_WORD)
+            {
+                pecFlags ^= PEC_TX_HALF;
+            }
+            if ( !(pecFlags & PEC_TX_HALF) )    // group complete - PEC next
+            {
+                pecFlags |= PEC_TX_CRC;
+                txNext = pecCrc;
+                break;
+            }
+        }
+#endif
+        txNext = REG_Read(regCursor);           // next byte, while this one is shifted out
+        break;
 
     case 12:                                    // check (N)Ack from master
         USICTL0 &= ~USIOE;                      // SDA = input
@@ -413,46 +1104,22 @@ void __attribute__ ((interrupt(USI_VECTOR))) USI_TXRX_ISR (void)
         i2c_State = 14;                         // Go to next state: check (N)Ack
         break;
 
-    case 14:                                    // Process (N)Ack
-        if ( USISRL & (I2C_NACK & 0x01) )       // If Nack received from master - stop transmission
-        {
-            USICTL0 &= ~USIOE;                  // SDA = input
-
-            i2c_State = 0;                      // Reset state machine
-        }
-        else                                    // Ack received
-        {
-            goto    i2cTxLabel;                 // tx another byte
-        }
-
-        break;
-
     case 16:                                    // Prep for Start condition
         USICTL0 &= ~USIOE;                      // SDA = input
+        USICTL1 &= ~USIIFG;
         i2c_State = 0;                          // Reset state machine
 
         rxByteCounter = 0;
-        txByteCounter = 0;
         break;
 
     }
 
-    USICTL1 &= ~USIIFG;                         // Clear pending flags
-}
-
-
-void Data_RX(void)
-{
-    USICTL0 &= ~USIOE;                      // SDA = input
-    USICNT |=  0x08;                        // load USI counter, RX byte
-}
+    DIAG_COUNT(usiIsr);                         // after SCL release
 
-
-void TX_Data(uint8_t data)
-{
-    USICTL0 |= USIOE;                       // SDA = output
-    USISRL = data;                          // put data on buffer;
-    USICNT |=  0x08;                        // load USI counter, TX byte
+    if (mainRequest)
+    {
+        __bic_SR_register_on_exit(LPM3_bits);   // wake main loop
+    }
 }
 
 
@@ -464,9 +1131,1495 @@ void Setup_USI_Slave(void)
     USICTL0 = USIPE6|USIPE7|USISWRST;       // Port & USI mode setup - SCL/SDA enabled
     USICTL1 = USII2C|USIIE|USISTTIE;        // Enable I2C mode & USI interrupts - i2c enabled / interrupt enabled / start condition interrupt enable
     USICKCTL = USICKPL;                     // Setup clock polarity - inactive in High
-    USICNT |= USIIFGCC;                     // Disable automatic clear control
+    USICNT &= ~USIIFGCC;                    // USIIFG cleared (SCL released) when the counter is loaded
     USICTL0 &= ~USISWRST;                   // Enable USI
     USICTL1 &= ~USIIFG;                     // Clear pending flag
+}
+
+
+/******************************************************************************
+ * Register file
+ * - REG_Read: value of the next byte to transmit - read one byte ahead, the
+ *   master may Nack before it is sent: only internal latches change
+ * - REG_Commit: side effects of a byte loaded in the shift register
+ * - REG_Write: returns false if the register is not writable (Nack)
+ ******************************************************************************/
+uint8_t REG_Read(uint8_t address)
+{
+    uint8_t value;
+
+#if defined (ENABLE_DIAGNOSTICS)
+    txDummy = false;
+
+    /*
+     * counters - latched when the low byte is read, each one consistent
+     * - a read starting on a high byte (address == regPointer) latches too
+     */
+    if ( (uint8_t)(address - SD16_REG_DIAG) < sizeof(diag) )
+    {
+        if (address == regPointer)
+        {
+            txSample = ((uint16_t *)&diag)[(address - SD16_REG_DIAG) >> 1];
+        }
+        address -= SD16_REG_DIAG;
+        if ( (address & 0x01) == 0 )
+        {
+            txSample = ((uint16_t *)&diag)[address >> 1];
+            return txSample & 0xFF;
+        }
+        return (txSample >> 8) & 0xFF;
+    }
+#endif
+
+#if defined (ENABLE_DRIFT_COMPENSATION)
+    /*
+     * drift block - values latched when the low byte is read (updated by
+     * SD16 ISR), or on the high byte a read starts with
+     */
+    if ( (uint8_t)(address - SD16_REG_DRIFT) < sizeof(drift) )
+    {
+        if (address == regPointer)
+        {
+            txSample = ((int16_t *)&drift)[(address - SD16_REG_DRIFT) >> 1];
+        }
+        address -= SD16_REG_DRIFT;
+        if ( (address & 0x01) == 0 )
+        {
+            txSample = ((int16_t *)&drift)[address >> 1];
+            return txSample & 0xFF;
+        }
+        return (txSample >> 8) & 0xFF;
+    }
+#endif
+
+#if defined (ENABLE_SCAN_SEQUENCER)
+    /*
+     * sequencer tables - byte access, results LSB first
+     */
+    if ( (uint8_t)(address - SD16_REG_SEQ_CONFIG) < (2 * SD16_SEQ_SLOTS) )
+    {
+        return seqConfig[address - SD16_REG_SEQ_CONFIG];
+    }
+    if ( (uint8_t)(address - SD16_REG_SEQ_RESULT) < (2 * SD16_SEQ_SLOTS) )
+    {
+        if (address == regPointer)              // read starts on a high byte - latch too
+        {
+            txSample = seqResult[(address - SD16_REG_SEQ_RESULT) >> 1];
+        }
+        address -= SD16_REG_SEQ_RESULT;
+        if ( (address & 0x01) == 0 )            // low byte - latch whole slot result
+        {
+            txSample = seqResult[address >> 1];
+            return txSample & 0xFF;
+        }
+        return (txSample >> 8) & 0xFF;
+    }
+#endif
+
+#if defined (ENABLE_STATISTICS)
+    /*
+     * statistics block - frozen while read, restarted after last byte if clear-on-read
+     */
+    if ( (uint8_t)(address - SD16_REG_STATS) < sizeof(stats) )
+    {
+        statsHold = true;                       // until next start condition
+        return ((uint8_t *)&stats)[address - SD16_REG_STATS];
+    }
+#endif
+
+#if defined (ENABLE_CALIBRATION)
+    if ( (uint8_t)(address - SD16_REG_CAL) < sizeof(cal) )
+    {
+        return ((uint8_t *)&cal)[address - SD16_REG_CAL];
+    }
+#endif
+
+    switch (address)
+    {
+    case SD16_REG_STATUS:
+        value = txStatus;
+        if (SD16CCTL0 & SD16SC)                 // conversion in progress / running
+        {
+            value |= SD16_STATUS_BUSY;
+        }
+#if defined (ENABLE_SCAN_SEQUENCER)
+        if (seqCtrl & SD16_SEQ_ENABLE)          // sequencer scanning
+        {
+            value |= SD16_STATUS_SEQ;
+        }
+#endif
+        break;
+
+    case SD16_REG_RESULT_L:
+        value = txResult & 0xFF;
+        break;
+
+    case SD16_REG_RESULT_H:
+        value = (txResult >> 8) & 0xFF;
+        break;
+
+    case SD16_REG_SAMPLE_CNT:
+        value = txCounter;
+        break;
+
+    case SD16_REG_RESULT_EXT:                   // 24-bit result - fraction, RESULT_L, RESULT_H
+        value = txFraction;
+        break;
+
+    case SD16_REG_RESULT_EXT + 1:
+        value = txResult & 0xFF;
+        break;
+
+    case SD16_REG_RESULT_EXT + 2:
+        value = (txResult >> 8) & 0xFF;
+        break;
+
+    case SD16_REG_FIFO_COUNT:
+        value = fifoCount;                      // count (bits 0-6) + overflow flag (bit 7)
+        break;
+
+    case SD16_REG_FIFO_DATA:                    // 2 bytes per sample, removed when high byte is sent
+        if (fifoHighByte == true)
+        {
+            value = (txSample >> 8) & 0xFF;
+            fifoHighByte = FIFO_HIGH_READ;
+        }
+        else if (fifoCount & FIFO_COUNT_MASK)
+        {
+            txSample = fifoBuffer[fifoTail];    // latch - slot not reused until removed
+            value = txSample & 0xFF;
+            fifoHighByte = true;
+        }
+        else                                    // FIFO empty
+        {
+            value = I2C_DUMMY_BYTE;
+            DIAG_DUMMY();
+        }
+        break;
+
+#if defined (ENABLE_FIFO_DELTA)
+    case SD16_REG_FIFO_DELTA:
+        value = FIFO_DeltaRead();
+        break;
+#endif
+
+    case SD16_REG_CHCTRL_L:
+        value = SD16CCTL0 & SD16DF;
+        break;
+
+    case SD16_REG_CHCTRL_H:
+        value = (SD16CCTL0 >> 8) & (BIT0+BIT1+BIT2+BIT3+BIT4);
+        break;
+
+    case SD16_REG_IN_CTRL:
+        value = SD16_MAIN_INCTL();
+        break;
+
+    case SD16_REG_CONVERSION:
+        value = (SD16CCTL0 & SD16SC) ? SD16_START_CONVERSION : SD16_STOP_CONVERSION;
+        break;
+
+#if defined (ENABLE_ADDRESS_FLASH)
+    case SD16_REG_I2C_ADDR:
+        value = SLV_Addr >> 1;
+        break;
+#endif
+
+#if defined (ENABLE_LATENCY_CONTROL)
+    case SD16_REG_PRELOAD:
+        value = SD16PRE0;
+        break;
+
+    case SD16_REG_DISCARD:
+        value = discardCtrl;
+        break;
+
+    case SD16_REG_LATENCY:
+        value = SD16_Latency() & 0xFF;
+        break;
+
+    case SD16_REG_LATENCY + 1:
+        value = (SD16_Latency() >> 8) & 0xFF;
+        break;
+#endif
+
+#if defined (ENABLE_PACED_SAMPLING)
+    case SD16_REG_PACE_PERIOD:
+        value = pacePeriod & 0xFF;
+        break;
+
+    case SD16_REG_PACE_PERIOD + 1:
+        value = (pacePeriod >> 8) & 0xFF;
+        break;
+
+    case SD16_REG_PACE_CTRL:
+        value = paceCtrl & ~(PACE_REF_OFF|PACE_CONTINUOUS);
+        break;
+#endif
+
+    case SD16_REG_I2C_CTRL:
+        value = i2cCtrl;
+#if defined (ENABLE_ADDRESS_FLASH)
+        if (mainRequest & MAIN_REQ_ADDR_SAVE)
+        {
+            value |= SD16_I2C_SAVE;
+        }
+#endif
+        break;
+
+#if defined (ENABLE_SCAN_SEQUENCER)
+    case SD16_REG_SEQ_CTRL:
+        value = seqCtrl;
+        break;
+#endif
+
+#if defined (ENABLE_SD16_FILTER)
+    case SD16_REG_FILTER_CTRL:
+        value = filterShift;
+        break;
+#endif
+
+#if defined (ENABLE_DRIFT_COMPENSATION)
+    case SD16_REG_DRIFT_CTRL:
+        value = driftCtrl & ~DRIFT_AUX_RUNNING;
+        break;
+
+    case SD16_REG_DRIFT_INTERVAL:
+        value = driftInterval;
+        break;
+#endif
+
+#if defined (ENABLE_STATISTICS)
+    case SD16_REG_STATS_WINDOW:
+        value = statsWindow & 0xFF;
+        break;
+
+    case SD16_REG_STATS_WINDOW + 1:
+        value = (statsWindow >> 8) & 0xFF;
+        break;
+
+    case SD16_REG_STATS_CTRL:
+        value = statsCtrl;
+        break;
+#endif
+
+#if defined (ENABLE_COMPARATOR)
+    case SD16_REG_COMP_LOW:
+        value = compLow & 0xFF;
+        break;
+
+    case SD16_REG_COMP_LOW + 1:
+        value = (compLow >> 8) & 0xFF;
+        break;
+
+    case SD16_REG_COMP_HIGH:
+        value = compHigh & 0xFF;
+        break;
+
+    case SD16_REG_COMP_HIGH + 1:
+        value = (compHigh >> 8) & 0xFF;
+        break;
+
+    case SD16_REG_COMP_CTRL:
+        value = compCtrl;
+        break;
+#endif
+
+#if defined (ENABLE_CALIBRATION)
+    case SD16_REG_CAL_CTRL:
+        value = calCtrl & SD16_CAL_ENABLE;
+        if (calStep != CAL_IDLE)
+        {
+            value |= SD16_CAL_MEASURE;
+        }
+        if ( (calCtrl & CAL_SAVE_PENDING) || (mainRequest & MAIN_REQ_CAL_SAVE) )
+        {
+            value |= SD16_CAL_SAVE;
+        }
+        break;
+#endif
+
+    default:                                    // write only or unmapped
+        value = I2C_DUMMY_BYTE;
+        DIAG_DUMMY();
+        break;
+    }
+
+    return value;
+}
+
+
+void REG_Commit(uint8_t address)
+{
+#if defined (ENABLE_DIAGNOSTICS)
+    if (txDummy)
+    {
+        DIAG_COUNT(dummyBytes);
+    }
+#endif
+
+#if defined (ENABLE_STATISTICS)
+    if ( (address == (SD16_REG_STATS + sizeof(stats) - 1)) && (statsCtrl & SD16_STATS_CLEAR_ON_READ) )
+    {
+        STATS_Reset();                          // last byte of block sent - new window
+        return;
+    }
+#endif
+
+    switch (address)
+    {
+    case SD16_REG_STATUS:
+        /*
+         * clear on read - only if no result arrived after the snapshot
+         */
+        if ( (txStatus & SD16_STATUS_DRDY) && (txCounter == sampleCounter) )
+        {
+            sd16Status &= ~SD16_STATUS_DRDY;
+            DRDY_RELEASE();
+        }
+#if defined (ENABLE_COMPARATOR)
+        if ( (txStatus & SD16_STATUS_ALERT) && (compCtrl & SD16_COMP_LATCH) )
+        {
+            COMP_SetAlert(false);               // latched alert - cleared when reported
+        }
+#endif
+        statusRead = true;
+        break;
+
+    case SD16_REG_RESULT_L:
+        if ( !statusRead && (txCounter == sampleCounter) )  // result read without status
+        {
+            sd16Status &= ~SD16_STATUS_DRDY;
+            DRDY_RELEASE();
+        }
+        break;
+
+    case SD16_REG_FIFO_DATA:
+        if (fifoHighByte == FIFO_HIGH_READ)     // high byte sent - remove latched sample
+        {
+            fifoHighByte = false;               // Nack after the low byte: sample sent again next read
+            fifoTail = (fifoTail + 1) & FIFO_MASK;
+            fifoCount--;                        // keep overflow flag until flush
+        }
+        break;
 
-    i2c_Direction = 0;
+#if defined (ENABLE_FIFO_DELTA)
+    case SD16_REG_FIFO_DELTA:
+        fifoDeltaPhase = fifoDeltaNext & ~DELTA_POP;
+        if (fifoDeltaNext & DELTA_POP)          // last byte of a sample sent - remove it
+        {
+            fifoDeltaRef = txSample;
+            fifoTail = (fifoTail + 1) & FIFO_MASK;
+            fifoCount--;
+        }
+        break;
+#endif
+    }
 }
+
+
+uint8_t REG_Write(uint8_t address, uint8_t value)
+{
+    uint8_t configuration_changed = false;
+
+#if defined (ENABLE_CALIBRATION)
+    if (sd16Status & SD16_STATUS_CAL)           // measuring or writing flash - configuration locked
+    {
+        return false;
+    }
+    /*
+     * block - a word is stored when its high byte arrives, the SD16 ISR
+     * never sees half of a new gain or offset
+     */
+    if ( (uint8_t)(address - SD16_REG_CAL) < sizeof(cal) )
+    {
+        address -= SD16_REG_CAL;
+        if ( (address & 0x01) == 0 )
+        {
+            calWriteLow = value;
+        }
+        else
+        {
+            ((uint16_t *)&cal)[address >> 1] = ((uint16_t)value << 8) | calWriteLow;
+        }
+        return true;
+    }
+#endif
+
+#if defined (ENABLE_DRIFT_COMPENSATION)
+    /*
+     * main channel back before its configuration, conversion, pacing,
+     * sequencer or calibration is changed
+     */
+    if ( ((uint8_t)(address - SD16_REG_PACE_CTRL) <= (SD16_REG_SEQ_CTRL - SD16_REG_PACE_CTRL))
+         || (address == SD16_REG_CAL_CTRL) )
+    {
+        DRIFT_Restore();
+    }
+    if ( (uint8_t)(address - SD16_REG_DRIFT) < sizeof(drift) )
+    {
+        address -= SD16_REG_DRIFT;
+        if ( (address < SD16_DRIFT_REFERENCE) || (address >= SD16_DRIFT_GAIN) )
+        {
+            return false;                       // aux, gain and offset are read only
+        }
+        if ( (address & 0x01) == 0 )            // word stored with its high byte - as calibration
+        {
+            driftWriteLow = value;
+        }
+        else
+        {
+            ((int16_t *)&drift)[address >> 1] = ((uint16_t)value << 8) | driftWriteLow;    // used from the next aux result
+        }
+        return true;
+    }
+#endif
+
+#if defined (ENABLE_DIAGNOSTICS)
+    if ( (uint8_t)(address - SD16_REG_DIAG) < sizeof(diag) )
+    {
+        uint8_t i;
+
+        for (i = 0; i < sizeof(diag); i++)      // any write clears all counters
+        {
+            ((uint8_t *)&diag)[i] = 0;
+        }
+        return true;
+    }
+#endif
+
+#if defined (ENABLE_SCAN_SEQUENCER)
+    if ( (uint8_t)(address - SD16_REG_SEQ_CONFIG) < (2 * SD16_SEQ_SLOTS) )
+    {
+        seqConfig[address - SD16_REG_SEQ_CONFIG] = value;     // used on next slot load
+        return true;
+    }
+#endif
+
+    switch (address)
+    {
+    case SD16_REG_CHCTRL_L:                     // SD16CCTL0 Low byte - 0 to 7
+        if ( (SD16CCTL0 & BIT4) != (value & BIT4) )
+        {
+            SD16CCTL0 &= ~BIT4;                         // clear data format bit - BIT4
+            SD16CCTL0 |= (value & BIT4);                // save data format value
+            configuration_changed = true;
+        }
+        break;
+
+    case SD16_REG_CHCTRL_H:                     // SD16CCTL0 High byte - 8 to 15
+        if ( ((SD16CCTL0>>8) & (BIT0+BIT1+BIT2+BIT3+BIT4)) != (value & (BIT0+BIT1+BIT2+BIT3+BIT4)) )
+        {
+            SD16CCTL0 &= ~((BIT0+BIT1+BIT2+BIT3+BIT4) << 8);    // clear bits 8-12
+            SD16CCTL0 |= (value & (BIT0+BIT1+BIT2+BIT3+BIT4)) << 8;     // save received values
+            configuration_changed = true;
+        }
+        break;
+
+    case SD16_REG_IN_CTRL:                      // SD16INCTL0
+        if ( SD16INCTL0 != value )
+        {
+            SD16INCTL0 = value;
+            configuration_changed = true;
+        }
+        break;
+
+    case SD16_REG_CONVERSION:
+        if (value & SD16_START_CONVERSION)      // if start conversion received
+        {
+            /*
+             * single or continuous mode - return without waiting
+             * - result read inside SD16 ISR, signaled by DRDY
+             */
+            sd16Status &= ~SD16_STATUS_DRDY;
+            DRDY_RELEASE();
+            FILTER_Reset();                     // first block starts with this conversion
+            DISCARD_RESTART();
+
+            SD16CCTL0 |= SD16SC;                // set bit to start the conversion
+        }
+        else                                    // if stop condition
+        {
+            SD16CCTL0 &= ~SD16SC;               // clear bit to stop conversion
+        }
+        break;
+
+    case SD16_REG_FIFO_CTRL:
+        if (value & SD16_FIFO_FLUSH)
+        {
+            FIFO_Flush();
+        }
+        break;
+
+#if defined (ENABLE_PACED_SAMPLING)
+    case SD16_REG_PACE_PERIOD:
+        pacePeriod = (pacePeriod & 0xFF00) | value;
+        break;
+
+    case SD16_REG_PACE_PERIOD + 1:
+        pacePeriod = (pacePeriod & 0x00FF) | ((uint16_t)value << 8);
+        break;
+
+    case SD16_REG_PACE_CTRL:                    // period applied here - write it first
+        paceCtrl = (paceCtrl & PACE_CONTINUOUS) | (value & (SD16_PACE_ENABLE|SD16_PACE_SMCLK|SD16_PACE_POWER_DOWN));
+        PACE_Setup();
+        break;
+#endif
+
+#if defined (ENABLE_LATENCY_CONTROL)
+    case SD16_REG_PRELOAD:                      // used by next start
+        SD16PRE0 = value;
+        break;
+
+    case SD16_REG_DISCARD:
+        if (value > SD16_DISCARD_MAX)
+        {
+            return false;
+        }
+        discardCtrl = value;
+        break;
+#endif
+
+#if defined (ENABLE_ADDRESS_FLASH)
+    case SD16_REG_I2C_ADDR:                     // used from next start condition
+        if ( (value < SD16_I2C_ADDR_MIN) || (value > SD16_I2C_ADDR_MAX) )
+        {
+            return false;                       // reserved address
+        }
+        SLV_Addr = value << 1;
+        break;
+
+    case SD16_REG_I2C_CTRL:
+        i2cCtrl = value & I2C_CTRL_BITS;        // PEC framing from next transaction
+        if (value & SD16_I2C_SAVE)
+        {
+            mainRequest |= MAIN_REQ_ADDR_SAVE;  // flash written from main loop
+        }
+        break;
+#else
+    case SD16_REG_I2C_CTRL:
+        if (value & SD16_I2C_SAVE)
+        {
+            return false;                       // no address block in flash
+        }
+        i2cCtrl = value & I2C_CTRL_BITS;        // PEC framing from next transaction
+        break;
+#endif
+
+#if defined (ENABLE_SCAN_SEQUENCER)
+    case SD16_REG_SEQ_CTRL:
+        SD16CCTL0 &= ~SD16SC;                   // stop current conversion
+        seqCtrl = value;
+        seqIndex = 0;
+
+        if (value & SD16_SEQ_ENABLE)            // start scan from slot 0
+        {
+            sd16Status &= ~SD16_STATUS_DRDY;
+            DRDY_RELEASE();
+
+            SEQ_LoadSlot(0);
+            SD16CCTL0 |= SD16SC;
+        }
+        break;
+#endif
+
+#if defined (ENABLE_SD16_FILTER)
+    case SD16_REG_FILTER_CTRL:
+        filterShift = (value > FILTER_MAX_SHIFT) ? FILTER_MAX_SHIFT : value;
+        FILTER_Reset();
+        break;
+#endif
+
+#if defined (ENABLE_DRIFT_COMPENSATION)
+    case SD16_REG_DRIFT_CTRL:
+        if ( (value & SD16_DRIFT_ENABLE) && (SD16CCTL0 & SD16SNGL) )
+        {
+            return false;                       // continuous mode only
+        }
+        if ( !(value & SD16_DRIFT_ENABLE) )
+        {
+            DRIFT_Restore();
+        }
+        driftCtrl = (driftCtrl & DRIFT_AUX_RUNNING)
+                  | (value & (SD16_DRIFT_ENABLE|SD16_DRIFT_SUPPLY|SD16_DRIFT_APPLY|SD16_DRIFT_CAPTURE));
+        driftCountdown = (uint16_t)1 << driftInterval;
+        break;
+
+    case SD16_REG_DRIFT_INTERVAL:
+        if (value > SD16_DRIFT_INTERVAL_MAX)
+        {
+            return false;
+        }
+        driftInterval = value;
+        driftCountdown = (uint16_t)1 << driftInterval;
+        break;
+#endif
+
+#if defined (ENABLE_STATISTICS)
+    case SD16_REG_STATS_WINDOW:
+        statsWindow = (statsWindow & 0xFF00) | value;
+        break;
+
+    case SD16_REG_STATS_WINDOW + 1:
+        statsWindow = (statsWindow & 0x00FF) | ((uint16_t)value << 8);
+        break;
+
+    case SD16_REG_STATS_CTRL:                   // any write restarts the window
+        statsCtrl = value;
+        STATS_Reset();
+        break;
+#endif
+
+#if defined (ENABLE_COMPARATOR)
+    case SD16_REG_COMP_LOW:                     // threshold stored with its high byte - SD16 ISR
+    case SD16_REG_COMP_HIGH:                    // never compares with half of a new word
+        compWriteLow = value;
+        break;
+
+    case SD16_REG_COMP_LOW + 1:
+        compLow = ((uint16_t)value << 8) | compWriteLow;
+        break;
+
+    case SD16_REG_COMP_HIGH + 1:
+        compHigh = ((uint16_t)value << 8) | compWriteLow;
+        break;
+
+    case SD16_REG_COMP_CTRL:                    // any write clears alert and consecutive count
+        compCtrl = value;
+        compCount = 0;
+        COMP_SetAlert(false);
+        break;
+#endif
+
+#if defined (ENABLE_CALIBRATION)
+    case SD16_REG_CAL_CTRL:
+        calCtrl = value & SD16_CAL_ENABLE;
+        if (value & SD16_CAL_RESTORE)
+        {
+            CAL_Load();
+        }
+        if (value & SD16_CAL_SAVE)
+        {
+            calCtrl |= CAL_SAVE_PENDING;        // after measurement, or now
+            sd16Status |= SD16_STATUS_CAL;
+        }
+        if (value & SD16_CAL_MEASURE)
+        {
+            CAL_StartMeasure();
+        }
+        else if (value & SD16_CAL_SAVE)
+        {
+            calCtrl &= ~CAL_SAVE_PENDING;
+            mainRequest |= MAIN_REQ_CAL_SAVE;   // flash written from main loop
+        }
+        break;
+#endif
+
+    default:                                    // read only or unmapped
+        return false;
+    }
+
+    if (configuration_changed)
+    {
+        SD16_SelectInputs();
+        FILTER_Reset();                         // do not mix samples of two configurations
+        DISCARD_RESTART();
+    }
+
+    return true;
+}
+
+
+/******************************************************************************
+ * configure SD16AE based on the selected channel and polarity
+ * - connect external pins of channels 0-2, internal channels use no pins
+ * - single-ended: + input only (SD16AE0/2/4)
+ ******************************************************************************/
+void SD16_SelectInputs(void)
+{
+    uint8_t pins = sd16InputPins[SD16INCTL0 & 0x07];
+
+    if ( SD16CCTL0 & SD16UNI )                      // if single-ended input
+    {
+        pins &= (SD16AE0|SD16AE2|SD16AE4);
+    }
+    SD16AE = pins;
+}
+
+
+#if defined (ENABLE_LATENCY_CONTROL)
+/******************************************************************************
+ * expected time from start (or configuration change) to the first result
+ * - continuous: (interrupt sample + discarded results) * OSR + preload
+ * - single: each discarded result restarts the conversion, so
+ *   (1 + discarded results) * (interrupt sample * OSR + preload)
+ * - in fM cycles - us at fM = 1 MHz, saturated at 0xFFFF
+ * - OSR is a power of 2: shift, no multiply
+ ******************************************************************************/
+uint16_t SD16_Latency(void)
+{
+    uint8_t osr = (SD16CCTL0 >> 8) & (BIT0+BIT1+BIT3);
+    uint8_t shift;
+    uint8_t samples;
+    uint8_t n;
+    uint16_t conversion;
+    uint16_t latency;
+
+    if (osr & BIT3)                                 // SD16XOSR - 512 / 1024
+    {
+        shift = 9 + (osr & BIT0);
+    }
+    else                                            // 256 / 128 / 64 / 32
+    {
+        shift = 8 - (osr & (BIT0+BIT1));
+    }
+    samples = 4 - (SD16_MAIN_INCTL() >> 6);         // SD16INTDLY: 4th to 1st sample
+
+    if ( !(SD16CCTL0 & SD16SNGL) )                  // one conversion running
+    {
+        return ((uint16_t)(samples + discardCtrl) << shift) + SD16PRE0;
+    }
+
+    conversion = ((uint16_t)samples << shift) + SD16PRE0;
+    latency = conversion;
+    for (n = discardCtrl; n; n--)
+    {
+        if (latency > (0xFFFF - conversion))
+        {
+            return 0xFFFF;
+        }
+        latency += conversion;
+    }
+    return latency;
+}
+#endif
+
+
+#if defined (ENABLE_SCAN_SEQUENCER)
+/******************************************************************************
+ * Scan sequencer
+ * - each slot is a single conversion with its own input, gain, OSR and polarity
+ * - data format (SD16DF) and interrupt delay are shared by all slots
+ * - the last slot configuration is kept in SD16CCTL0/SD16INCTL0 after a stop
+ ******************************************************************************/
+void SEQ_LoadSlot(uint8_t slot)
+{
+    uint8_t *config = &seqConfig[2 * slot];
+
+    SD16INCTL0 = config[0];
+    SD16CCTL0 = (SD16CCTL0 & ~((BIT0+BIT1+BIT2+BIT3+BIT4) << 8))
+              | ((config[1] & (BIT0+BIT1+BIT3+BIT4)) << 8)         // OSR + polarity
+              | SD16SNGL;                                           // always single conversion
+    SD16_SelectInputs();
+}
+
+
+uint8_t SEQ_Length(void)
+{
+    uint8_t length = (seqCtrl & SD16_SEQ_LENGTH_MASK) >> 4;
+
+    if ( (length == 0) || (length > SD16_SEQ_SLOTS) )
+    {
+        length = SD16_SEQ_SLOTS;
+    }
+
+    return length;
+}
+#endif
+
+
+/******************************************************************************
+ * Averaging filter
+ * - restart accumulation - called on start and on configuration change
+ ******************************************************************************/
+void FILTER_Reset(void)
+{
+#if defined (ENABLE_SD16_FILTER)
+    filterSum = 0;
+    filterCount = (uint16_t)1 << filterShift;
+#endif
+}
+
+
+#if defined (ENABLE_STATISTICS)
+/******************************************************************************
+ * Windowed statistics
+ * - published results only, in 2's complement (offset binary has MSB flipped)
+ * - window complete: accumulation stops and SD16_STATUS_STATS is set
+ * - count saturates at 65535 if no window is set
+ ******************************************************************************/
+void STATS_Update(int16_t sample)
+{
+    uint32_t square;
+
+    if ( !(statsCtrl & SD16_STATS_ENABLE) || statsHold || (sd16Status & SD16_STATUS_STATS) )
+    {
+        return;
+    }
+
+    if ( !(SD16CCTL0 & SD16DF) )
+    {
+        sample ^= 0x8000;
+    }
+
+    if (stats.count == 0)
+    {
+        stats.min = sample;
+        stats.max = sample;
+    }
+    else if (sample < stats.min)
+    {
+        stats.min = sample;
+    }
+    else if (sample > stats.max)
+    {
+        stats.max = sample;
+    }
+
+    stats.count++;
+    stats.sum += sample;
+
+    square = (int32_t)sample * sample;          // up to 2^30
+    stats.sumSquaresLow += square;
+    if (stats.sumSquaresLow < square)           // carry to high word
+    {
+        stats.sumSquaresHigh++;
+    }
+
+    if ( (stats.count == statsWindow) || (stats.count == 0xFFFF) )
+    {
+        sd16Status |= SD16_STATUS_STATS;
+    }
+}
+
+
+void STATS_Reset(void)
+{
+    stats.count = 0;
+    stats.min = 0;
+    stats.max = 0;
+    stats.sum = 0;
+    stats.sumSquaresLow = 0;
+    stats.sumSquaresHigh = 0;
+
+    sd16Status &= ~SD16_STATUS_STATS;
+    statsHold = false;
+}
+#endif
+
+
+#if defined (ENABLE_COMPARATOR)
+/******************************************************************************
+ * Threshold comparator - evaluated on each published result
+ * - traditional: alert above HIGH, released below LOW (hysteresis)
+ * - window: alert outside LOW..HIGH, released inside
+ * - alert only after 1/2/4/8 consecutive results beyond threshold
+ * - latched: alert kept until STATUS is read
+ ******************************************************************************/
+void COMP_Update(int16_t sample)
+{
+    int16_t low = compLow;
+    int16_t high = compHigh;
+    uint8_t trip;
+    uint8_t release;
+
+    if ( !(compCtrl & SD16_COMP_ENABLE) )
+    {
+        return;
+    }
+
+    if ( !(SD16CCTL0 & SD16DF) )                // offset binary - compare as unsigned
+    {
+        sample ^= 0x8000;
+        low ^= 0x8000;
+        high ^= 0x8000;
+    }
+
+    if (compCtrl & SD16_COMP_WINDOW)
+    {
+        trip = (sample > high) || (sample < low);
+        release = !trip;
+    }
+    else
+    {
+        trip = (sample > high);
+        release = (sample < low);
+    }
+
+    if (trip)
+    {
+        if (compCount < 0xFF)
+        {
+            compCount++;
+        }
+        if ( compCount >= ((uint8_t)1 << ((compCtrl & SD16_COMP_QUEUE_MASK) >> 4)) )
+        {
+            COMP_SetAlert(true);
+        }
+    }
+    else
+    {
+        compCount = 0;
+        if ( release && !(compCtrl & SD16_COMP_LATCH) )
+        {
+            COMP_SetAlert(false);
+        }
+    }
+}
+
+
+/*
+ * update status flag and ALERT pin - pin released (high-Z) if comparator disabled
+ */
+void COMP_SetAlert(uint8_t alert)
+{
+    if (alert)
+    {
+        sd16Status |= SD16_STATUS_ALERT;
+    }
+    else
+    {
+        sd16Status &= ~SD16_STATUS_ALERT;
+    }
+
+    if ( (compCtrl & SD16_COMP_ENABLE) && ( !alert != !(compCtrl & SD16_COMP_ACTIVE_HIGH) ) )
+    {
+        P2DIR |= ALERT_PIN;                     // drive low
+    }
+    else
+    {
+        P2DIR &= ~ALERT_PIN;                    // high-Z - pulled up by master
+    }
+}
+#endif
+
+
+#if defined (ENABLE_CALIBRATION)
+/******************************************************************************
+ * Offset / gain calibration
+ * - correction in 2's complement: (sample - offset[gain]) * gain >> 15
+ * - gain 6 and 7 (reserved) use the 32x offset
+ ******************************************************************************/
+int16_t CAL_Apply(int16_t sample)
+{
+    int32_t value;
+    uint8_t gain;
+
+    if ( !(calCtrl & SD16_CAL_ENABLE) )
+    {
+        return sample;
+    }
+
+    if ( !(SD16CCTL0 & SD16DF) )
+    {
+        sample ^= 0x8000;
+    }
+
+    gain = (SD16INCTL0 >> 3) & 0x07;
+    if (gain >= CAL_GAINS)
+    {
+        gain = CAL_GAINS - 1;
+    }
+
+    value = (int32_t)sample - cal.offset[gain];
+    if (value > INT16_MAX)                      // saturate before product - fits in 32 bits
+    {
+        value = INT16_MAX;
+    }
+    else if (value < INT16_MIN)
+    {
+        value = INT16_MIN;
+    }
+
+    value = (value * cal.gain) >> 15;
+    if (value > INT16_MAX)
+    {
+        value = INT16_MAX;
+    }
+    else if (value < INT16_MIN)
+    {
+        value = INT16_MIN;
+    }
+
+    sample = (int16_t)value;
+    if ( !(SD16CCTL0 & SD16DF) )
+    {
+        sample ^= 0x8000;
+    }
+
+    return sample;
+}
+
+
+/*
+ * offset measurement - single conversions on CH7, gain 1x to 32x
+ * - data format, OSR and interrupt delay of the current configuration -
+ *   one offset per gain, used at every OSR (sequencer slots included):
+ *   measure at the OSR the results are taken with
+ */
+void CAL_StartMeasure(void)
+{
+    SD16CCTL0 &= ~SD16SC;                       // stop current conversion
+#if defined (ENABLE_SCAN_SEQUENCER)
+    seqCtrl &= ~SD16_SEQ_ENABLE;
+#endif
+
+    if ( !(SD16CCTL0 & SD16SNGL) )
+    {
+        calCtrl |= CAL_CONTINUOUS;
+    }
+    calInCtrl = SD16INCTL0;
+
+    SD16CCTL0 |= SD16SNGL;
+    SD16INCTL0 = (calInCtrl & (SD16INTDLY0|SD16INTDLY1)) | SD16INCH_7 | SD16GAIN_1;
+    SD16AE = 0x00;
+
+    calSum = 0;
+    calStep = 0;
+    sd16Status |= SD16_STATUS_CAL;
+
+    SD16CCTL0 |= SD16SC;
+}
+
+
+/*
+ * called from SD16 ISR for each conversion - returns true when complete
+ * - previous configuration restored, conversion left stopped
+ */
+uint8_t CAL_Measure(int16_t sample)
+{
+    if ( !(SD16CCTL0 & SD16DF) )
+    {
+        sample ^= 0x8000;
+    }
+    calSum += sample;
+    calStep++;
+
+    if ( (calStep & ((1 << CAL_SAMPLES_SHIFT) - 1)) == 0 )     // gain complete
+    {
+        cal.offset[(calStep >> CAL_SAMPLES_SHIFT) - 1] = (int16_t)(calSum >> CAL_SAMPLES_SHIFT);
+        calSum = 0;
+
+        if ( (calStep >> CAL_SAMPLES_SHIFT) == CAL_GAINS )
+        {
+            SD16INCTL0 = calInCtrl;
+            if (calCtrl & CAL_CONTINUOUS)
+            {
+                SD16CCTL0 &= ~SD16SNGL;
+            }
+            SD16_SelectInputs();
+            FILTER_Reset();
+
+            calStep = CAL_IDLE;
+            calCtrl &= ~CAL_CONTINUOUS;
+
+            if (calCtrl & CAL_SAVE_PENDING)
+            {
+                calCtrl &= ~CAL_SAVE_PENDING;
+                mainRequest |= MAIN_REQ_CAL_SAVE;   // SD16_STATUS_CAL kept until stored
+            }
+            else
+            {
+                sd16Status &= ~SD16_STATUS_CAL;
+            }
+            return true;
+        }
+
+        SD16INCTL0 = (SD16INCTL0 & ~(0x07 << 3)) | ((calStep >> CAL_SAMPLES_SHIFT) << 3);  // next gain
+    }
+
+    SD16CCTL0 |= SD16SC;
+    return false;
+}
+
+
+/*
+ * flash block: [gain] [offset x 6] [key] - defaults if the key is missing
+ */
+void CAL_Load(void)
+{
+    const uint16_t *flash = (const uint16_t *)CAL_FLASH_SEGMENT;
+    uint16_t *data = (uint16_t *)&cal;
+    uint8_t i;
+
+    if (flash[sizeof(cal) / 2] == FLASH_BLOCK_KEY)
+    {
+        for (i = 0; i < (sizeof(cal) / 2); i++)
+        {
+            data[i] = flash[i];
+        }
+    }
+    else                                        // never stored - no correction
+    {
+        cal.gain = SD16_CAL_GAIN_UNITY;
+        for (i = 0; i < CAL_GAINS; i++)
+        {
+            cal.offset[i] = 0;
+        }
+    }
+}
+#endif
+
+
+#if defined (ENABLE_DRIFT_COMPENSATION)
+/******************************************************************************
+ * Drift compensation - one temperature (or supply) conversion every
+ * 2^driftInterval results, continuous mode only
+ * - enable Nacked in single mode; a result in single mode (pacing, new
+ *   CHCTRL) clears ENABLE, APPLY and CAPTURE, the reference is not kept
+ * - the aux result is not published: the main channel restarts with the
+ *   discard count, its result rate drops only during the pause
+ * - delta = aux - reference (2's complement codes)
+ *   gain   = 0x8000 + (delta * gainCoef >> 16)  (Q15)
+ *   offset = delta * offsetCoef >> 16            (codes)
+ * - correction (2's complement): (sample * gain >> 15) + offset, after CAL_Apply()
+ ******************************************************************************/
+int16_t DRIFT_Apply(int16_t sample)
+{
+    int32_t value;
+
+    if ( !(driftCtrl & SD16_DRIFT_APPLY) )
+    {
+        return sample;
+    }
+
+    if ( !(SD16CCTL0 & SD16DF) )
+    {
+        sample ^= 0x8000;
+    }
+
+    value = (((int32_t)sample * drift.gain) >> 15) + drift.offset;
+    if (value > INT16_MAX)
+    {
+        value = INT16_MAX;
+    }
+    else if (value < INT16_MIN)
+    {
+        value = INT16_MIN;
+    }
+
+    sample = (int16_t)value;
+    if ( !(SD16CCTL0 & SD16DF) )
+    {
+        sample ^= 0x8000;
+    }
+
+    return sample;
+}
+
+
+/*
+ * called from SD16 ISR - next conversion on the temperature / supply input
+ * - gain 1, 3rd sample interrupt (first settled), SD16AE not changed
+ */
+void DRIFT_StartAux(void)
+{
+    SD16CCTL0 &= ~SD16SC;
+    driftInCtrl = SD16INCTL0;
+    SD16INCTL0 = SD16INTDLY_1 | SD16GAIN_1 | ((driftCtrl & SD16_DRIFT_SUPPLY) ? SD16INCH_5 : SD16INCH_6);
+    driftCtrl |= DRIFT_AUX_RUNNING;
+    SD16CCTL0 |= SD16SC;
+}
+
+
+/*
+ * back to the main channel - from the SD16 ISR, or before the master
+ * changes the configuration while the aux conversion is running
+ */
+void DRIFT_Restore(void)
+{
+    if ( !(driftCtrl & DRIFT_AUX_RUNNING) )
+    {
+        return;
+    }
+
+    SD16CCTL0 &= ~SD16SC;
+    SD16INCTL0 = driftInCtrl;
+    driftCtrl &= ~DRIFT_AUX_RUNNING;
+    driftCountdown = (uint16_t)1 << driftInterval;
+    DISCARD_RESTART();
+    SD16CCTL0 |= SD16SC;
+}
+
+
+/*
+ * called from SD16 ISR with the aux result - new gain / offset
+ */
+void DRIFT_Update(int16_t aux)
+{
+    int32_t delta;
+    int32_t gain;
+
+    DRIFT_Restore();                            // main channel converting while we compute
+
+    if ( !(SD16CCTL0 & SD16DF) )
+    {
+        aux ^= 0x8000;
+    }
+    drift.aux = aux;
+
+    if (driftCtrl & SD16_DRIFT_CAPTURE)         // this result is the reference
+    {
+        drift.reference = aux;
+        driftCtrl &= ~SD16_DRIFT_CAPTURE;
+    }
+
+    delta = (int32_t)aux - drift.reference;
+    if (delta > INT16_MAX)                      // product fits in 32 bits
+    {
+        delta = INT16_MAX;
+    }
+    else if (delta < INT16_MIN)
+    {
+        delta = INT16_MIN;
+    }
+
+    gain = SD16_CAL_GAIN_UNITY + ((delta * drift.gainCoef) >> 16);
+    if (gain > UINT16_MAX)
+    {
+        gain = UINT16_MAX;
+    }
+    else if (gain < 0)
+    {
+        gain = 0;
+    }
+    drift.gain = (uint16_t)gain;
+    drift.offset = (int16_t)((delta * drift.offsetCoef) >> 16);
+}
+#endif
+
+
+#if defined (ENABLE_PACED_SAMPLING)
+/******************************************************************************
+ * Paced sampling - Timer_A up mode, period = pacePeriod ticks
+ * - ACLK (VLO, about 12 kHz, +-50 %): LPM3 between samples
+ * - SMCLK / 8 (2 MHz, DCO accuracy): LPM1
+ * - reference and buffer off between samples if the period is at least
+ *   twice the warm-up - CCR1 turns them on before the tick
+ * - single conversion forced, results queued in the FIFO as usual - a
+ *   continuous mode set before is restored when pacing stops, conversion
+ *   left stopped
+ ******************************************************************************/
+void PACE_Setup(void)
+{
+    uint16_t warmup;
+
+    TACTL = TACLR;                              // stop
+    TACCTL0 = 0;
+    TACCTL1 = 0;
+    SD16CTL |= SD16_REF_BITS;                   // on while not paced
+
+    if ( !(paceCtrl & SD16_PACE_ENABLE) || (pacePeriod == 0) )
+    {
+        if (paceCtrl & PACE_CONTINUOUS)
+        {
+            SD16CCTL0 &= ~(SD16SC | SD16SNGL);
+            paceCtrl &= ~PACE_CONTINUOUS;
+        }
+        return;
+    }
+
+    warmup = (paceCtrl & SD16_PACE_SMCLK) ? PACE_WARMUP_SMCLK : PACE_WARMUP_ACLK;
+    if ( (paceCtrl & SD16_PACE_POWER_DOWN) && ((pacePeriod >> 1) >= warmup) )
+    {
+        TACCR1 = pacePeriod - 1 - warmup;
+        TACCTL1 = CCIE;
+        paceCtrl |= PACE_REF_OFF;
+        SD16CTL &= ~SD16_REF_BITS;
+    }
+
+    if ( !(SD16CCTL0 & SD16SNGL) )
+    {
+        paceCtrl |= PACE_CONTINUOUS;
+    }
+    SD16CCTL0 |= SD16SNGL;
+    TACCR0 = pacePeriod - 1;
+    TACCTL0 = CCIE;
+    if (paceCtrl & SD16_PACE_SMCLK)
+    {
+        TACTL = TASSEL_2 + ID_3 + MC_1 + TACLR;
+    }
+    else
+    {
+        TACTL = TASSEL_1 + MC_1 + TACLR;
+    }
+}
+#endif
+
+
+#if defined (ENABLE_GENERAL_CALL)
+/******************************************************************************
+ * General call - same SCL edge on every node, conversions start together
+ * - a running conversion is stopped first, so the digital filters restart
+ *   aligned - SAMPLE_CNT and FIFO restart, sample n is the same instant on
+ *   every node (continuous mode drifts with the DCO of each node)
+ * - returns false if the command is unknown or refused (Nack)
+ ******************************************************************************/
+uint8_t GCALL_Command(uint8_t command)
+{
+    switch (command)
+    {
+    case SD16_GCALL_START:
+        REG_Write(SD16_REG_CONVERSION, SD16_STOP_CONVERSION);
+        if ( !REG_Write(SD16_REG_CONVERSION, SD16_START_CONVERSION) )
+        {
+            return false;                   // calibration in progress
+        }
+        sampleCounter = 0;
+        FIFO_Flush();
+        return true;
+
+    case SD16_GCALL_STOP:
+        return REG_Write(SD16_REG_CONVERSION, SD16_STOP_CONVERSION);
+
+    default:
+        return false;
+    }
+}
+#endif
+
+
+#if defined (ENABLE_ADDRESS_FLASH)
+/******************************************************************************
+ * Slave address in flash - [address + I2C_CTRL << 8] [FLASH_BLOCK_KEY]
+ ******************************************************************************/
+void ADDR_Load(void)
+{
+    const uint16_t *flash = (const uint16_t *)ADDR_FLASH_SEGMENT;
+    uint8_t address = flash[0] & 0xFF;
+
+    if ( (flash[1] == FLASH_BLOCK_KEY) && (address >= SD16_I2C_ADDR_MIN) && (address <= SD16_I2C_ADDR_MAX) )
+    {
+        SLV_Addr = address << 1;
+        i2cCtrl = (flash[0] >> 8) & I2C_CTRL_BITS;
+    }
+}
+
+
+void ADDR_Save(void)
+{
+    uint16_t block = (SLV_Addr >> 1) | ((uint16_t)i2cCtrl << 8);
+
+    FLASH_Write((uint16_t *)ADDR_FLASH_SEGMENT, &block, 1);
+}
+#endif
+
+
+#if defined (ENABLE_ADDRESS_FLASH) || defined (ENABLE_CALIBRATION)
+/******************************************************************************
+ * Information flash - erase and write one segment, key after the block
+ * - main loop only: CPU held for about 13 ms (segment erase), i2c clock
+ *   stretched meanwhile
+ ******************************************************************************/
+void FLASH_Write(uint16_t *segment, const uint16_t *data, uint8_t words)
+{
+    uint8_t i;
+
+    __disable_interrupt();
+
+    FCTL2 = FWKEY + FSSEL_1 + FN5 + FN2 + FN1 + FN0;    // MCLK / 40 = 400 kHz flash clock
+    FCTL3 = FWKEY;                                      // unlock - INFOA kept locked (LOCKA)
+    FCTL1 = FWKEY + ERASE;
+    *segment = 0;                                       // dummy write - erase segment
+
+    FCTL1 = FWKEY + WRT;
+    for (i = 0; i < words; i++)
+    {
+        segment[i] = data[i];
+    }
+    segment[i] = FLASH_BLOCK_KEY;                       // block valid
+
+    FCTL1 = FWKEY;
+    FCTL3 = FWKEY + LOCK;
+
+    __enable_interrupt();
+}
+#endif
+
+
+/******************************************************************************
+ * Sample FIFO
+ * - called from interrupt context only (SD16 and USI ISRs do not nest)
+ * - when full, new samples are dropped and the overflow flag is set
+ ******************************************************************************/
+void FIFO_Push(int16_t sample)
+{
+    if ((fifoCount & FIFO_COUNT_MASK) < SD16_FIFO_DEPTH)
+    {
+        fifoBuffer[fifoHead] = sample;
+        fifoHead = (fifoHead + 1) & FIFO_MASK;
+        fifoCount++;
+    }
+    else                                    // FIFO full
+    {
+        fifoCount |= SD16_FIFO_OVERFLOW;    // flag lost samples
+        DIAG_COUNT(fifoOverflow);
+    }
+}
+
+
+void FIFO_Flush(void)
+{
+    fifoHead = 0;
+    fifoTail = 0;
+    fifoCount = 0;                          // also clear overflow flag
+}
+
+
+#if defined (ENABLE_FIFO_DELTA)
+/******************************************************************************
+ * Delta coded FIFO read - [count] [key L] [key H] [token] [token] ...
+ * - token: difference to the previous sample (SD16_DELTA_MIN..MAX), or
+ *   SD16_DELTA_ESCAPE + full sample, or SD16_DELTA_EMPTY
+ * - read one byte ahead like REG_Read: only latches change here, the sample
+ *   is removed by REG_Commit when its last byte is sent
+ ******************************************************************************/
+uint8_t FIFO_DeltaRead(void)
+{
+    uint16_t delta;
+
+    fifoDeltaNext = fifoDeltaPhase + 1;     // next byte of the same sample
+
+    switch (fifoDeltaPhase)
+    {
+    case DELTA_COUNT:
+        if ( !(fifoCount & FIFO_COUNT_MASK) )
+        {
+            fifoDeltaNext = DELTA_END;      // no key sample - master sees count 0
+        }
+        return fifoCount;
+
+    case DELTA_KEY_L:
+        txSample = fifoBuffer[fifoTail];    // count > 0 - only this read removes samples
+        return txSample & 0xFF;
+
+    case DELTA_TOKEN:
+        if ( !(fifoCount & FIFO_COUNT_MASK) )
+        {
+            fifoDeltaNext = DELTA_TOKEN;
+            return SD16_DELTA_EMPTY;
+        }
+        txSample = fifoBuffer[fifoTail];
+        delta = (uint16_t)txSample - (uint16_t)fifoDeltaRef;    // modulo 2^16 - also offset binary
+        if ( (uint16_t)(delta - SD16_DELTA_MIN) <= (SD16_DELTA_MAX - SD16_DELTA_MIN) )
+        {
+            fifoDeltaNext = DELTA_TOKEN | DELTA_POP;
+            return delta & 0xFF;
+        }
+        return SD16_DELTA_ESCAPE;           // full sample follows
+
+    case DELTA_ESC_L:
+        return txSample & 0xFF;             // latched with the escape
+
+    case DELTA_KEY_H:
+    case DELTA_ESC_H:
+        fifoDeltaNext = DELTA_TOKEN | DELTA_POP;
+        return (txSample >> 8) & 0xFF;
+
+    default:                                // DELTA_END
+        fifoDeltaNext = DELTA_END;
+        DIAG_DUMMY();
+        return I2C_DUMMY_BYTE;
+    }
+}
+#endif